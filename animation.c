@@ -0,0 +1,169 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "animation.h"
+
+static const char *op_names[] = {NULL,      "left",       "right",
+                                 "up",      "down",       "zoom_in",
+                                 "zoom_out", "rotate_acw", "rotate_cw"};
+
+#define is_separator(c) \
+	((c) == ',' || (c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+int animation_parse(const char *script, AnimationStep *steps, int max) {
+	const char *s     = script;
+	int         count = 0;
+	while(1) {
+		while(is_separator(*s)) s++;
+		if(*s == '\0')
+			return count;
+		const char *e = s;
+		while(*e && *e != '*' && !is_separator(*e)) e++;
+		int op = 0;
+		for(int i = TRANSFORM_LEFT; i <= TRANSFORM_ROTATE_CW; i++) {
+			if(strlen(op_names[i]) == (siz)(e - s) &&
+			   strncmp(op_names[i], s, e - s) == 0)
+				op = i;
+		}
+		if(op == 0 || count == max)
+			return -1;
+		long times = 1;
+		if(*e == '*') {
+			char *end;
+			times = strtol(e + 1, &end, 10);
+			if(end == e + 1 || times < 1 || times > 1000000 ||
+			   (*end && !is_separator(*end)))
+				return -1;
+			e = end;
+		}
+		steps[count].op    = (TransformOp)op;
+		steps[count].count = (int)times;
+		count++;
+		s = e;
+	}
+}
+
+long animation_frames(const AnimationStep *steps, int count) {
+	long frames = 1;
+	for(int i = 0; i < count; i++) frames += steps[i].count;
+	return frames;
+}
+
+// The frames handed over to the writer. The encoder fills the slot at head
+// while the writer drains the filled slots from tail, so a slot is only ever
+// touched by one of them at a time.
+typedef struct {
+	u8 *            data[ANIMATION_QUEUE];
+	int             head, tail, filled;
+	u8              done, failed;
+	pthread_mutex_t lock;
+	pthread_cond_t  more, less;
+	int             fd;
+	char            header[64];
+	siz             header_size, data_size;
+} FrameQueue;
+
+static void *frame_writer(void *arg) {
+	FrameQueue *q = (FrameQueue *)arg;
+	pthread_mutex_lock(&q->lock);
+	while(1) {
+		while(q->filled == 0 && !q->done) pthread_cond_wait(&q->more, &q->lock);
+		if(q->filled == 0)
+			break;
+		u8 *data = q->data[q->tail];
+		pthread_mutex_unlock(&q->lock);
+		int res = q->failed ? 0
+		                    : export_write_encoded(q->fd, q->header,
+		                                           q->header_size, data,
+		                                           q->data_size);
+		pthread_mutex_lock(&q->lock);
+		// After a failure, the frames are only drained so that the
+		// encoder does not block
+		if(res != 0)
+			q->failed = 1;
+		q->tail = (q->tail + 1) % ANIMATION_QUEUE;
+		q->filled--;
+		pthread_cond_signal(&q->less);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return NULL;
+}
+
+// Encodes the current frame into the next free slot, and queues it
+static int frame_push(FrameQueue *q, const Canvas *c, ExportFormat fmt) {
+	pthread_mutex_lock(&q->lock);
+	while(q->filled == ANIMATION_QUEUE) pthread_cond_wait(&q->less, &q->lock);
+	int failed = q->failed;
+	pthread_mutex_unlock(&q->lock);
+	if(failed)
+		return -1;
+	export_encode(c, fmt, q->data[q->head]);
+	pthread_mutex_lock(&q->lock);
+	q->head = (q->head + 1) % ANIMATION_QUEUE;
+	q->filled++;
+	pthread_cond_signal(&q->more);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+
+static long run_serial(Canvas *c, const AnimationStep *steps, int count,
+                       ExportFormat fmt, int fd, ThreadPool *pool) {
+	long frames = 0;
+	if(export_write(c, fmt, fd) != 0)
+		return -1;
+	frames++;
+	for(int s = 0; s < count; s++) {
+		for(int i = 0; i < steps[s].count; i++) {
+			canvas_transform(c, steps[s].op, pool);
+			if(export_write(c, fmt, fd) != 0)
+				return -1;
+			frames++;
+		}
+	}
+	return frames;
+}
+
+long animation_run(Canvas *c, const AnimationStep *steps, int count,
+                   ExportFormat fmt, int fd, ThreadPool *pool, u8 pipelined) {
+	if(!pipelined)
+		return run_serial(c, steps, count, fmt, fd, pool);
+
+	FrameQueue q;
+	memset(&q, 0, sizeof(q));
+	q.fd          = fd;
+	q.header_size = export_header(c, fmt, q.header);
+	q.data_size   = export_data_size(c, fmt);
+	for(int i = 0; i < ANIMATION_QUEUE; i++)
+		q.data[i] = (u8 *)malloc(q.data_size);
+	pthread_mutex_init(&q.lock, NULL);
+	pthread_cond_init(&q.more, NULL);
+	pthread_cond_init(&q.less, NULL);
+
+	pthread_t writer;
+	long      frames = 0;
+	if(pthread_create(&writer, NULL, frame_writer, &q) != 0) {
+		frames = -1;
+		goto cleanup;
+	}
+	int failed = frame_push(&q, c, fmt);
+	for(int s = 0; s < count && !failed; s++) {
+		for(int i = 0; i < steps[s].count && !failed; i++) {
+			canvas_transform(c, steps[s].op, pool);
+			failed = frame_push(&q, c, fmt);
+		}
+	}
+	pthread_mutex_lock(&q.lock);
+	q.done = 1;
+	pthread_cond_signal(&q.more);
+	pthread_mutex_unlock(&q.lock);
+	pthread_join(writer, NULL);
+	frames = q.failed ? -1 : animation_frames(steps, count);
+
+cleanup:
+	pthread_cond_destroy(&q.less);
+	pthread_cond_destroy(&q.more);
+	pthread_mutex_destroy(&q.lock);
+	for(int i = 0; i < ANIMATION_QUEUE; i++) free(q.data[i]);
+	return frames;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+#include "export.h"
+#include "threadpool.h"
+
+// Non interactive animations. A script is a sequence of transformations,
+// separated by commas or blanks, each of which may be repeated :
+//   <left|right|up|down|zoom_in|zoom_out|rotate_acw|rotate_cw>[*count]
+// Every application of a transformation produces one frame, after the
+// initial frame of the untransformed canvas. The frames are written back to
+// back in the same image format, so that a sequence of netpbm images can be
+// piped directly to an encoder.
+
+typedef struct {
+	TransformOp op;
+	int         count; // Number of frames, the op is applied once per frame
+} AnimationStep;
+
+// Number of frames which may be queued for the writer at once
+#define ANIMATION_QUEUE 2
+
+// Parse the script into at most max steps. Returns the number of steps, or
+// -1 if the script is malformed or has more than max steps.
+int animation_parse(const char *script, AnimationStep *steps, int max);
+// Number of frames the steps produce, including the initial frame
+long animation_frames(const AnimationStep *steps, int count);
+// Apply the steps to the canvas, writing every frame to the file descriptor.
+// If pipelined is set, the frames are written by a separate thread, so that
+// the transformation of a frame overlaps the writing of the frames before
+// it. Returns the number of frames written, or -1 if they could not be
+// written.
+long animation_run(Canvas *c, const AnimationStep *steps, int count,
+                   ExportFormat fmt, int fd, ThreadPool *pool, u8 pipelined);
@@ -0,0 +1,15 @@
+#include "batch.h"
+
+static void render_scene(void *arg, int worker) {
+	(void)worker;
+	BatchScene *scene = (BatchScene *)arg;
+	for(siz i = 0; i < scene->count; i++) {
+		canvas_set_id(scene->canvas, i);
+		primitive_draw(scene->canvas, &scene->prims[i]);
+	}
+}
+
+void render_batch(BatchScene *scenes, siz count, Scheduler *s) {
+	for(siz i = 0; i < count; i++) sched_spawn(s, render_scene, &scenes[i]);
+	sched_run(s);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+#include "scheduler.h"
+
+// An independent scene, drawn on its own canvas
+typedef struct {
+	const Primitive *prims;
+	siz              count;
+	Canvas *         canvas;
+} BatchScene;
+
+// Draw every scene on its canvas, one task of the scheduler per scene, and
+// return once all of them are drawn. The canvases must be distinct and not
+// displayed on the terminal.
+void render_batch(BatchScene *scenes, siz count, Scheduler *s);
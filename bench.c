@@ -1,58 +1,241 @@
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "animation.h"
+#include "batch.h"
 #include "bench.h"
+#include "circle_drawing.h"
+#include "clipping.h"
+#include "curve_drawing.h"
 #include "common.h"
 #include "display.h"
 #include "driver.h"
+#include "ellipse_drawing.h"
+#include "export.h"
+#include "glyph.h"
+#include "line_drawing.h"
 #include "matrix.h"
+#include "perfcount.h"
+#include "primitive.h"
+#include "raster.h"
+#include "retained.h"
+#include "scene.h"
+#include "scene_binary.h"
+#include "scheduler.h"
+#include "server.h"
+#include "spatial.h"
+#include "stroke.h"
+#include "term.h"
+#include "threadpool.h"
+#include "tile.h"
 
-#ifndef BENCH_DRAW_CALL_COUNT
-#define BENCH_DRAW_CALL_COUNT 500000
-#endif
-#ifndef BENCH_MAT_CREATE_COUNT
-#define BENCH_MAT_CREATE_COUNT 200000
-#endif
-#define BENCH_RESULT_COUNT BENCH_MAT_CREATE_COUNT - 1
-#define pbench(...)                       \
-	phylw("\n[Benchmark] ", __VA_ARGS__); \
-	fflush(stdout);
+#define BENCH_DEFAULT_DRAW_COUNT 500000
+#define BENCH_DEFAULT_MAT_COUNT 200000
+#define BENCH_DEFAULT_PRIM_COUNT 5000
+#define BENCH_CANVAS_ROWS 512
+#define BENCH_CANVAS_COLS 1024
+#define BENCH_LARGE_CANVAS_ROWS 2048
+#define BENCH_LARGE_CANVAS_COLS 4096
+#define BENCH_DEFAULT_THUMB_COUNT 2000
+#define BENCH_THUMB_ROWS 64
+#define BENCH_THUMB_COLS 128
+// Primitives of the largest thumbnail, the rest have uniformly less
+#define BENCH_THUMB_MAX_PRIMS 64
+#define BENCH_DEFAULT_WARMUP 1
+#define BENCH_DEFAULT_REPETITIONS 5
+#define BENCH_DEFAULT_THRESHOLD 5.0
+// Inputs are randomized with a fixed seed, so that the results of different
+// runs stay comparable
+#define BENCH_SEED 0x5eed
+// Requests sent to the render server, and processes started to compare
+#define BENCH_DEFAULT_SERVER_REQUESTS 2000
+#define BENCH_SPAWN_REQUESTS 20
+// Primitives of the map the viewport is culled from, and its size in
+// canvases along each axis
+#define BENCH_DEFAULT_CULL_COUNT 1000000
+#define BENCH_CULL_WORLD 64
+// Primitives around the origin the culling is checked with
+#define BENCH_CULL_STRAYS 300
+// Points looked up on the rendered scene
+#define BENCH_PICK_QUERIES 10000
+// Primitives of the scene replaced on every tick of a live update
+#define BENCH_TICK_UPDATES 10
+// Primitives around the origin the ID buffer of the updates is checked with
+#define BENCH_TICK_STRAYS 300
+// Length of the lines a curve is approximated with, to compare with the
+// curve rasterizers, short enough for the curve to look smooth
+#define BENCH_CURVE_SEGMENT_LENGTH 2
+// Width of the thick lines
+#define BENCH_STROKE_WIDTH 9
+// Human readable progress is suppressed for the machine readable formats
+#define pbench(...)                               \
+	do {                                          \
+		if(config.format == BENCH_FORMAT_TEXT) {  \
+			phylw("\n[Benchmark] ", __VA_ARGS__); \
+			fflush(stdout);                       \
+		}                                         \
+	} while(0)
+
+typedef struct {
+	char   name[64];
+	char   unit[16];
+	long   items, pixels;
+	double min, median, p99;         // seconds per run
+	double baseline_rate;            // items/sec in the baseline, 0 if none
+	double change;                   // percentage change from the baseline
+	u8     regression;
+	PerfSample counters;             // Average hardware counters per run
+} BenchResult;
 
-static clock_t start, end;
-static Matrix  matrices[BENCH_MAT_CREATE_COUNT], result[BENCH_RESULT_COUNT];
-static double  values[BENCH_MAT_CREATE_COUNT * 9];
-static int     pixels[BENCH_DRAW_CALL_COUNT][2];
+static BenchConfig config;
+static int mat_count, result_count, draw_count, prim_count, thumb_count;
+static int cull_count;
+static Matrix *    matrices = NULL, *result = NULL;
+static double *    values = NULL;
+static int (*pixels)[2]   = NULL;
+static double *    samples = NULL;
+static BenchResult *results = NULL;
+static int          result_size = 0, result_capacity = 0;
+static PerfSample   counter_sum;
+static Primitive *  scene     = NULL;
+static ThreadPool * bench_pool = NULL;
+// Canvas of the headless driver the rasterizers draw on
+static Canvas *bench_canvas = NULL;
+static int (*prims)[8]      = NULL;
 
-static void tstart() {
-	start = clock();
+// Monotonic wall clock time in nanoseconds. Unlike clock(), this does not
+// depend on the scheduler accounting of the process, and has a far better
+// resolution.
+static inline u64 now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
 }
 
-static inline double telapsed() {
-	end = clock();
-	return (double)(end - start) / CLOCKS_PER_SEC;
+static int compare_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
 }
 
-static long rate(long itemcount) {
-	return (long)(itemcount / telapsed());
+// Nearest rank percentile of a sorted sample set
+static double percentile(const double *sorted, int count, double p) {
+	int rank = (int)(p * count + 0.999999);
+	if(rank < 1)
+		rank = 1;
+	if(rank > count)
+		rank = count;
+	return sorted[rank - 1];
 }
 
-static long mat_rate() {
-	return rate(BENCH_MAT_CREATE_COUNT);
+// Sorts the collected samples of a benchmark and records the min, median and
+// 99th percentile of the timed runs as 'name', along with the number of
+// 'items' and 'pixels' (0 if not applicable) processed per run. The rates
+// at the median are reported in the text format.
+static void bench_report(const char *name, const char *unit, long items,
+                         long pixels) {
+	int reps = config.repetitions;
+	qsort(samples, reps, sizeof(double), compare_double);
+	if(result_size == result_capacity) {
+		result_capacity = result_capacity ? result_capacity * 2 : 16;
+		results         = (BenchResult *)realloc(
+            results, sizeof(BenchResult) * result_capacity);
+	}
+	BenchResult *r = &results[result_size++];
+	memset(r, 0, sizeof(BenchResult));
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	snprintf(r->unit, sizeof(r->unit), "%s", unit);
+	r->items  = items;
+	r->pixels = pixels;
+	r->min    = samples[0];
+	r->median = percentile(samples, reps, 0.5);
+	r->p99    = percentile(samples, reps, 0.99);
+	for(int i = 0; config.counters && i < PERF_COUNTER_COUNT; i++) {
+		r->counters.valid[i]  = counter_sum.valid[i];
+		r->counters.values[i] = counter_sum.values[i] / reps;
+	}
+	if(config.format != BENCH_FORMAT_TEXT)
+		return;
+	printf("\n\tmin %10.3f ms  median %10.3f ms  p99 %10.3f ms  (%ld %s/sec)",
+	       r->min * 1e3, r->median * 1e3, r->p99 * 1e3,
+	       (long)(items / r->median), unit);
+	if(pixels)
+		printf(" (%ld pixels/sec)", (long)(pixels / r->median));
+	if(config.counters) {
+		PerfSample *c = &r->counters;
+		printf("\n\t");
+		for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+			if(!c->valid[i])
+				continue;
+			printf("%s %.2f/item ", perf_counter_name(i),
+			       c->values[i] / items);
+			if(pixels)
+				printf("%.2f/pixel ", c->values[i] / pixels);
+		}
+		if(c->valid[PERF_CYCLES] && c->valid[PERF_INSTRUCTIONS])
+			printf("(%.2f IPC)", c->values[PERF_INSTRUCTIONS] /
+			                         c->values[PERF_CYCLES]);
+	}
+	fflush(stdout);
 }
 
-static inline void matrix_create() {
-	for(int i = 0; i < BENCH_MAT_CREATE_COUNT; i++) {
+// Executes 'run' config.warmup times untimed, then config.repetitions times
+// timed, calling 'reset' (untimed, may be NULL) after each of the runs.
+// The hardware counters, if enabled, are summed over the timed runs.
+static void bench_collect(void (*run)(), void (*reset)()) {
+	memset(&counter_sum, 0, sizeof(counter_sum));
+	for(int i = 0; i < config.warmup + config.repetitions; i++) {
+		u8 timed = i >= config.warmup;
+		if(timed && config.counters)
+			perf_start();
+		u64 start = now_ns();
+		run();
+		u64 end = now_ns();
+		if(timed) {
+			samples[i - config.warmup] = (end - start) / 1e9;
+			if(config.counters) {
+				PerfSample s;
+				perf_stop(&s);
+				for(int j = 0; j < PERF_COUNTER_COUNT; j++) {
+					counter_sum.values[j] += s.values[j];
+					counter_sum.valid[j] = s.valid[j];
+				}
+			}
+		}
+		if(reset)
+			reset();
+	}
+}
+
+static void bench_run(const char *name, const char *unit, long items,
+                      void (*run)(), void (*reset)()) {
+	bench_collect(run, reset);
+	bench_report(name, unit, items, 0);
+}
+
+static void matrix_create() {
+	for(int i = 0; i < mat_count; i++) {
 		matrices[i] = mat_new(3, 3);
 		mat_set(matrices[i], 1, 2, 4.5782783);
 	}
 }
 
+static void free_mat() {
+	for(int i = 0; i < mat_count; i++) mat_free(matrices[i]);
+}
+
 static void bench_matrix_create() {
 	pbench("Testing 3x3 matrix creation");
-	tstart();
-	matrix_create();
-	printf("\t\t(%ld matrices/sec)", mat_rate());
+	bench_run("matrix/create", "matrices", mat_count, matrix_create, free_mat);
 }
 
 static inline double randf(double a) {
@@ -60,57 +243,59 @@ static inline double randf(double a) {
 	return x;
 }
 
-static void bench_matrix_fill() {
-	pbench("Testing 3x3 matrix fill");
-	srand(time(NULL));
-	for(size_t i = 0; i < BENCH_MAT_CREATE_COUNT; i++) {
-		values[i] = randf(100000.0);
-	}
-	tstart();
-	for(size_t i = 0; i < BENCH_MAT_CREATE_COUNT * 9; i += 9) {
+static void matrix_fill() {
+	for(size_t i = 0; i < (size_t)mat_count * 9; i += 9) {
 		mat_fill(matrices[i / 9], values[i], values[i + 1], values[i + 2],
 		         values[i + 3], values[i + 4], values[i + 5], values[i + 6],
 		         values[i + 7], values[i + 8]);
 	}
-	printf("\t\t(%ld mat_fill/sec)", mat_rate());
+}
+
+static void bench_matrix_fill() {
+	pbench("Testing 3x3 matrix fill");
+	srand(BENCH_SEED);
+	for(size_t i = 0; i < (size_t)mat_count * 9; i++) {
+		values[i] = randf(100000.0);
+	}
+	bench_run("matrix/fill", "mat_fill", mat_count, matrix_fill, NULL);
 }
 
 static void free_result() {
-	for(int i = 0; i < BENCH_RESULT_COUNT; i++) mat_free(result[i]);
+	for(int i = 0; i < result_count; i++) mat_free(result[i]);
+}
+
+static void matrix_mult() {
+	for(int i = 0; i < result_count; i++) {
+		result[i] = mat_mult(matrices[i], matrices[i + 1]);
+	}
 }
 
 static void bench_matrix_mult() {
 	pbench("Testing 3x3 matrix multiplication");
-	tstart();
-	for(int i = 0; i < BENCH_RESULT_COUNT; i++) {
-		result[i] = mat_mult(matrices[i], matrices[i + 1]);
+	bench_run("matrix/mult", "mat_mult", result_count, matrix_mult,
+	          free_result);
+}
+
+static void matrix_add() {
+	for(int i = 0; i < result_count; i++) {
+		result[i] = mat_add(matrices[i], matrices[i + 1]);
 	}
-	printf("\t(%ld mat_mult/sec)", mat_rate());
-	free_result();
 }
 
 static void bench_matrix_add() {
 	pbench("Testing 3x3 matrix addition");
-	tstart();
-	for(int i = 0; i < BENCH_RESULT_COUNT; i++) {
-		result[i] = mat_add(matrices[i], matrices[i + 1]);
-	}
-	printf("\t\t(%ld mat_add/sec)", mat_rate());
-	free_result();
+	bench_run("matrix/add", "mat_add", result_count, matrix_add, free_result);
 }
 
-static void bench_matrix_sub() {
-	pbench("Testing 3x3 matrix subtraction");
-	tstart();
-	for(int i = 0; i < BENCH_RESULT_COUNT; i++) {
+static void matrix_sub() {
+	for(int i = 0; i < result_count; i++) {
 		result[i] = mat_sub(matrices[i], matrices[i + 1]);
 	}
-	printf("\t(%ld mat_sub/sec)", mat_rate());
-	free_result();
 }
 
-static void free_mat() {
-	for(int i = 0; i < BENCH_MAT_CREATE_COUNT; i++) mat_free(matrices[i]);
+static void bench_matrix_sub() {
+	pbench("Testing 3x3 matrix subtraction");
+	bench_run("matrix/sub", "mat_sub", result_count, matrix_sub, free_result);
 }
 
 // Assumes 0 <= max <= RAND_MAX
@@ -133,26 +318,1766 @@ i64 random_at_most(i64 max) {
 	return x / bin_size;
 }
 
+static void draw() {
+	for(int i = 0; i < draw_count; i++) {
+		put_pixel(pixels[i][0], pixels[i][1]);
+	}
+}
+
 static void bench_draw() {
 	init_driver();
-	srand(time(NULL));
+	srand(BENCH_SEED);
 	int row = get_rows(), cols = get_columns();
-	for(int i = 0; i < BENCH_DRAW_CALL_COUNT; i++) {
+	for(int i = 0; i < draw_count; i++) {
 		pixels[i][1] = random_at_most(row - 1);
 		pixels[i][0] = random_at_most(cols - 1);
 	}
-	tstart();
-	for(int i = 0; i < BENCH_DRAW_CALL_COUNT; i++) {
-		put_pixel(pixels[i][0], pixels[i][1]);
+	// The driver owns the terminal until it is terminated, so the results
+	// can only be shown afterwards
+	bench_collect(draw, NULL);
+	terminate_driver();
+	pbench("Testing put_pixel calls");
+	bench_report("driver/put_pixel", "put_pixel", draw_count,
+	             0);
+}
+
+// Rasterizer benchmarks. Each primitive is described by up to 8 integer
+// arguments in 'prims', which are generated once per input set, so that
+// every run draws exactly the same primitives on the headless framebuffer.
+// The coordinates are logical, i.e. half of the columns are addressable.
+
+#define canvas_width() (BENCH_CANVAS_COLS / 2)
+#define canvas_height() BENCH_CANVAS_ROWS
+#define rand_in(a, b) ((a) + (int)random_at_most((b) - (a)))
+
+static void (*raster_fn)(const int *args) = NULL;
+
+static void raster_run() {
+	for(int i = 0; i < prim_count; i++) raster_fn(prims[i]);
+}
+
+// The line algorithms only step from left to right, so the random lines
+// are always generated with x1 <= x2.
+static void gen_lines_random() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = rand_in(0, canvas_width() - 1);
+		prims[i][1] = rand_in(0, canvas_height() - 1);
+		prims[i][2] = rand_in(prims[i][0], canvas_width() - 1);
+		prims[i][3] = rand_in(0, canvas_height() - 1);
+	}
+}
+
+// Diagonals spanning the whole canvas, alternatingly rising and falling
+static void gen_lines_worst() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = 0;
+		prims[i][1] = i & 1 ? canvas_height() - 1 : 0;
+		prims[i][2] = canvas_width() - 1;
+		prims[i][3] = i & 1 ? 0 : canvas_height() - 1;
+	}
+}
+
+static int min_dimension() {
+	return canvas_width() < canvas_height() ? canvas_width() : canvas_height();
+}
+
+static void gen_circles_random() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = rand_in(0, canvas_width() - 1);
+		prims[i][1] = rand_in(0, canvas_height() - 1);
+		prims[i][2] = rand_in(1, min_dimension() / 2);
+	}
+}
+
+// The largest circle that fits on the canvas
+static void gen_circles_worst() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = canvas_width() / 2;
+		prims[i][1] = canvas_height() / 2;
+		prims[i][2] = min_dimension() / 2 - 1;
+	}
+}
+
+static void gen_ellipses_random() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = rand_in(0, canvas_width() - 1);
+		prims[i][1] = rand_in(0, canvas_height() - 1);
+		prims[i][2] = rand_in(1, canvas_width() / 2);
+		prims[i][3] = rand_in(1, canvas_height() / 2);
+	}
+}
+
+// The largest ellipse that fits on the canvas
+static void gen_ellipses_worst() {
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][0] = canvas_width() / 2;
+		prims[i][1] = canvas_height() / 2;
+		prims[i][2] = canvas_width() / 2 - 1;
+		prims[i][3] = canvas_height() / 2 - 1;
+	}
+}
+
+static void gen_clips_random() {
+	gen_lines_random();
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][4] = rand_in(0, canvas_width() - 2);
+		prims[i][5] = rand_in(0, canvas_height() - 2);
+		prims[i][6] = rand_in(prims[i][4] + 1, canvas_width() - 1);
+		prims[i][7] = rand_in(prims[i][5] + 1, canvas_height() - 1);
+	}
+}
+
+// Diagonals with both of the endpoints outside of a centered window, so
+// that both of them need to be clipped
+static void gen_clips_worst() {
+	gen_lines_worst();
+	for(int i = 0; i < prim_count; i++) {
+		prims[i][4] = canvas_width() / 4;
+		prims[i][5] = canvas_height() / 4;
+		prims[i][6] = (canvas_width() * 3) / 4;
+		prims[i][7] = (canvas_height() * 3) / 4;
+	}
+}
+
+static void gen_curves_random() {
+	for(int i = 0; i < prim_count; i++) {
+		for(int j = 0; j < 8; j += 2) {
+			prims[i][j]     = rand_in(0, canvas_width() - 1);
+			prims[i][j + 1] = rand_in(0, canvas_height() - 1);
+		}
+	}
+}
+
+// Curves which cross the whole canvas and loop back, with the control
+// points at the opposite corners
+static void gen_curves_worst() {
+	int w = canvas_width() - 1, h = canvas_height() - 1;
+	for(int i = 0; i < prim_count; i++) {
+		int corners[8] = {0, 0, w, h, 0, h, w, 0};
+		memcpy(prims[i], corners, sizeof(corners));
+	}
+}
+
+static void line_dda(const int *p) {
+	draw_line_dda(bench_canvas, p[0], p[1], p[2], p[3]);
+}
+
+static void line_bresenham(const int *p) {
+	draw_line_bresenham(bench_canvas, p[0], p[1], p[2], p[3]);
+}
+
+static void line_midpoint(const int *p) {
+	draw_line_midpoint(bench_canvas, p[0], p[1], p[2], p[3]);
+}
+
+static void circle_bresenham(const int *p) {
+	draw_circle_bresenham(bench_canvas, p[0], p[1], p[2]);
+}
+
+static void circle_bresenham_n_point(const int *p) {
+	draw_circle_bresenham_n_point(bench_canvas, p[0], p[1], p[2], 8);
+}
+
+static void circle_midpoint(const int *p) {
+	draw_circle_midpoint(bench_canvas, p[0], p[1], p[2], 8);
+}
+
+static void ellipse_midpoint(const int *p) {
+	draw_ellipse_midpoint(bench_canvas, p[0], p[1], p[2], p[3]);
+}
+
+static void clip_cohen(const int *p) {
+	clipping_cohen_sutherland(bench_canvas, p[0], p[1], p[2], p[3], p[4], p[5],
+	                          p[6], p[7]);
+}
+
+static void clip_midpoint(const int *p) {
+	clipping_midpoint_subdivision(bench_canvas, p[0], p[1], p[2], p[3], p[4],
+	                              p[5], p[6], p[7]);
+}
+
+static void curve_quadratic(const int *p) {
+	draw_bezier_quadratic(bench_canvas, p);
+}
+
+static void curve_cubic(const int *p) {
+	draw_bezier_cubic(bench_canvas, p);
+}
+
+static void curve_catmull_rom(const int *p) {
+	draw_catmull_rom(bench_canvas, p, 4);
+}
+
+// The cubic curve drawn as lines between points at uniform steps of t, as
+// many as the length of the control polygon needs
+static void curve_segments(const int *p) {
+	int length = 0;
+	for(int i = 0; i < 6; i += 2) {
+		int dx = abs(p[i + 2] - p[i]), dy = abs(p[i + 3] - p[i + 1]);
+		length += dx > dy ? dx : dy;
+	}
+	int x = p[0], y = p[1], segments = length / BENCH_CURVE_SEGMENT_LENGTH + 1;
+	for(int i = 1; i <= segments; i++) {
+		double t = (double)i / segments, u = 1 - t;
+		double a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t;
+		double d  = t * t * t;
+		int    nx = round(a * p[0] + b * p[2] + c * p[4] + d * p[6]);
+		int    ny = round(a * p[1] + b * p[3] + c * p[5] + d * p[7]);
+		draw_line_bresenham(bench_canvas, x, y, nx, ny);
+		x = nx;
+		y = ny;
+	}
+}
+
+static void stroke_butt(const int *p) {
+	draw_line_thick(bench_canvas, p[0], p[1], p[2], p[3], BENCH_STROKE_WIDTH,
+	                STROKE_CAP_BUTT);
+}
+
+static void stroke_round(const int *p) {
+	draw_line_thick(bench_canvas, p[0], p[1], p[2], p[3], BENCH_STROKE_WIDTH,
+	                STROKE_CAP_ROUND);
+}
+
+static void stroke_miter(const int *p) {
+	draw_polyline(bench_canvas, p, 4, BENCH_STROKE_WIDTH, STROKE_JOIN_MITER,
+	              STROKE_CAP_BUTT);
+}
+
+static void stroke_round_joins(const int *p) {
+	draw_polyline(bench_canvas, p, 4, BENCH_STROKE_WIDTH, STROKE_JOIN_ROUND,
+	              STROKE_CAP_ROUND);
+}
+
+// The thick line drawn by overdrawing as many parallel lines as its width.
+// draw_line_bresenham only steps along x, so a steep line plots a pixel per
+// column and leaves gaps between the lines. The baseline thus plots fewer
+// pixels than the stroke covers, and its rate is flattered accordingly.
+static void stroke_parallel(const int *p) {
+	double dx = p[2] - p[0], dy = p[3] - p[1], len = hypot(dx, dy);
+	if(len == 0)
+		len = 1;
+	for(int k = -BENCH_STROKE_WIDTH / 2; k <= BENCH_STROKE_WIDTH / 2; k++) {
+		int ox = round(-dy / len * k), oy = round(dx / len * k);
+		draw_line_bresenham(bench_canvas, p[0] + ox, p[1] + oy, p[2] + ox,
+		                    p[3] + oy);
+	}
+}
+
+typedef struct {
+	const char *name;
+	void (*draw)(const int *args);
+} RasterAlgo;
+
+// Benchmarks all the given algorithms, first on random and then on worst
+// case inputs of the respective generators.
+static void bench_raster(const char *object, const RasterAlgo *algos,
+                         int count, void (*gen_random)(),
+                         void (*gen_worst)()) {
+	init_driver_headless(BENCH_CANVAS_ROWS, BENCH_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	void (*gens[])()    = {gen_random, gen_worst};
+	const char *input[] = {"random", "worst case"};
+	for(int g = 0; g < 2; g++) {
+		gens[g]();
+		for(int i = 0; i < count; i++) {
+			pbench("Testing %s %s (%s input)", algos[i].name, object,
+			       input[g]);
+			raster_fn  = algos[i].draw;
+			u64 before = get_pixel_count();
+			bench_collect(raster_run, screen_clear);
+			long pixels = (get_pixel_count() - before) /
+			              (config.warmup + config.repetitions);
+			char name[64];
+			snprintf(name, sizeof(name), "%s/%s/%s", object, algos[i].name,
+			         input[g]);
+			for(char *c = name; *c; c++)
+				if(*c == ' ')
+					*c = '_';
+			bench_report(name, "primitives", prim_count, pixels);
+		}
 	}
-	long rt = rate(BENCH_DRAW_CALL_COUNT);
 	terminate_driver();
-	pbench("Testing put_pixel calls\t\t(%ld put_pixel/sec)", rt);
 }
 
-void bench(BenchType type) {
-	if(type != BENCH_CREATE && type != BENCH_ALL && type != BENCH_PUT) {
-		pbench("Creating %ld 3x3 matrices..", BENCH_MAT_CREATE_COUNT);
+static void bench_line() {
+	RasterAlgo algos[] = {{"dda", line_dda},
+	                      {"bresenham", line_bresenham},
+	                      {"midpoint", line_midpoint}};
+	bench_raster("line", algos, 3, gen_lines_random, gen_lines_worst);
+}
+
+static void bench_circle() {
+	RasterAlgo algos[] = {{"bresenham", circle_bresenham},
+	                      {"bresenham 8 point", circle_bresenham_n_point},
+	                      {"midpoint 8 point", circle_midpoint}};
+	bench_raster("circle", algos, 3, gen_circles_random, gen_circles_worst);
+}
+
+static void bench_ellipse() {
+	RasterAlgo algos[] = {{"midpoint", ellipse_midpoint}};
+	bench_raster("ellipse", algos, 1, gen_ellipses_random,
+	             gen_ellipses_worst);
+}
+
+static void bench_clip() {
+	RasterAlgo algos[] = {{"cohen sutherland", clip_cohen},
+	                      {"midpoint subdivision", clip_midpoint}};
+	bench_raster("clip", algos, 2, gen_clips_random, gen_clips_worst);
+}
+
+static void bench_curve() {
+	RasterAlgo algos[] = {{"quadratic bezier", curve_quadratic},
+	                      {"cubic bezier", curve_cubic},
+	                      {"catmull rom", curve_catmull_rom},
+	                      {"cubic bezier as lines", curve_segments}};
+	bench_raster("curve", algos, 4, gen_curves_random, gen_curves_worst);
+}
+
+static void bench_stroke() {
+	RasterAlgo algos[] = {{"butt caps", stroke_butt},
+	                      {"round caps", stroke_round},
+	                      {"miter joins", stroke_miter},
+	                      {"round joins", stroke_round_joins},
+	                      {"parallel lines", stroke_parallel}};
+	bench_raster("stroke", algos, 5, gen_curves_random, gen_curves_worst);
+
+	// Only the rows of the canvas are scanned, so a stroke far longer than
+	// the canvas draws the same cells as one just past its edges
+	init_driver_headless(BENCH_CANVAS_ROWS, BENCH_CANVAS_COLS);
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	draw_line_thick(canvas_default(), 10, -10, 10, get_rows() + 10,
+	                BENCH_STROKE_WIDTH, STROKE_CAP_BUTT);
+	memcpy(copy, get_framebuffer(), size);
+	screen_clear();
+	draw_line_thick(canvas_default(), 10, -100000000, 10, 300000000,
+	                BENCH_STROKE_WIDTH, STROKE_CAP_BUTT);
+	if(memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("A stroke longer than the canvas is drawn differently!");
+	free(copy);
+	terminate_driver();
+}
+
+static void bench_init(const BenchConfig *c) {
+	config = *c;
+	if(config.warmup < 0)
+		config.warmup = BENCH_DEFAULT_WARMUP;
+	if(config.repetitions <= 0)
+		config.repetitions = BENCH_DEFAULT_REPETITIONS;
+	if(config.threshold <= 0)
+		config.threshold = BENCH_DEFAULT_THRESHOLD;
+	mat_count  = config.iterations > 1 ? config.iterations
+	                                   : BENCH_DEFAULT_MAT_COUNT;
+	draw_count = config.iterations > 0 ? config.iterations
+	                                   : BENCH_DEFAULT_DRAW_COUNT;
+	prim_count = config.iterations > 0 ? config.iterations
+	                                   : BENCH_DEFAULT_PRIM_COUNT;
+	thumb_count = config.iterations > 0 ? config.iterations
+	                                    : BENCH_DEFAULT_THUMB_COUNT;
+	cull_count  = config.iterations > 0 ? config.iterations
+	                                    : BENCH_DEFAULT_CULL_COUNT;
+	result_count = mat_count - 1;
+
+	matrices = (Matrix *)malloc(sizeof(Matrix) * mat_count);
+	result   = (Matrix *)malloc(sizeof(Matrix) * result_count);
+	values   = (double *)malloc(sizeof(double) * mat_count * 9);
+	pixels   = malloc(sizeof(*pixels) * draw_count);
+	samples  = (double *)malloc(sizeof(double) * config.repetitions);
+	prims    = malloc(sizeof(*prims) * prim_count);
+	scene    = (Primitive *)malloc(sizeof(Primitive) * prim_count);
+	results  = NULL;
+	result_size = result_capacity = 0;
+	if(config.counters && perf_open() == 0) {
+		pwarn("Unable to open any hardware performance counter, check "
+		      "/proc/sys/kernel/perf_event_paranoid!");
+		config.counters = 0;
+	}
+}
+
+static void bench_free() {
+	free(matrices);
+	free(result);
+	free(values);
+	free(pixels);
+	free(samples);
+	free(prims);
+	free(scene);
+	free(results);
+	if(config.counters)
+		perf_close();
+}
+
+// Splits the next comma separated field off of 'line'. Unlike strtok, empty
+// fields are preserved.
+static char *next_field(char **line) {
+	char *field = strsep(line, ",");
+	if(field)
+		field[strcspn(field, "\r\n")] = '\0';
+	return field;
+}
+
+// Loads the items/sec of every benchmark from a baseline written by a
+// previous run in the csv format, and flags the results which are slower
+// than their baseline by more than config.threshold percent. Returns the
+// number of regressions, or -1 if the baseline could not be read.
+static int bench_compare() {
+	FILE *f = fopen(config.baseline, "r");
+	if(f == NULL) {
+		perr("Unable to open baseline '%s'!", config.baseline);
+		return -1;
+	}
+	char  buf[512], *line = buf, *field;
+	int   name_col = -1, rate_col = -1, regressions = 0;
+	if(fgets(buf, sizeof(buf), f)) {
+		for(int col = 0; (field = next_field(&line)); col++) {
+			if(strcmp(field, "name") == 0)
+				name_col = col;
+			else if(strcmp(field, "items_per_sec") == 0)
+				rate_col = col;
+		}
+	}
+	if(name_col < 0 || rate_col < 0) {
+		perr("'%s' is not a csv benchmark result!", config.baseline);
+		fclose(f);
+		return -1;
+	}
+	while(fgets(buf, sizeof(buf), f)) {
+		char * name = NULL;
+		double rate = 0;
+		line        = buf;
+		for(int col = 0; (field = next_field(&line)); col++) {
+			if(col == name_col)
+				name = field;
+			else if(col == rate_col)
+				rate = strtod(field, NULL);
+		}
+		if(name == NULL || rate <= 0)
+			continue;
+		for(int i = 0; i < result_size; i++) {
+			BenchResult *r = &results[i];
+			if(strcmp(r->name, name) != 0)
+				continue;
+			r->baseline_rate = rate;
+			r->change     = (r->items / r->median - rate) * 100.0 / rate;
+			r->regression = r->change < -config.threshold;
+			regressions += r->regression;
+		}
+	}
+	fclose(f);
+	return regressions;
+}
+
+static double pixel_rate(BenchResult *r) {
+	return r->pixels / r->median;
+}
+
+static void bench_emit_text() {
+	if(config.baseline == NULL)
+		return;
+	pbench("Comparison against '%s' (threshold %.1f%%)", config.baseline,
+	       config.threshold);
+	for(int i = 0; i < result_size; i++) {
+		BenchResult *r = &results[i];
+		if(r->baseline_rate == 0) {
+			printf("\n\t%-48s (not in baseline)", r->name);
+			continue;
+		}
+		printf("\n\t%-48s %+7.2f%%", r->name, r->change);
+		if(r->regression)
+			pred("  REGRESSION");
+	}
+}
+
+static void bench_emit_json() {
+	printf("{\n\t\"warmup\": %d,\n\t\"repetitions\": %d,\n\t\"results\": [",
+	       config.warmup, config.repetitions);
+	for(int i = 0; i < result_size; i++) {
+		BenchResult *r = &results[i];
+		printf("%s\n\t\t{\"name\": \"%s\", \"unit\": \"%s\", \"items\": %ld, "
+		       "\"pixels\": %ld, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+		       "\"p99_ns\": %.0f, \"items_per_sec\": %.1f, "
+		       "\"pixels_per_sec\": %.1f",
+		       i ? "," : "", r->name, r->unit, r->items, r->pixels,
+		       r->min * 1e9, r->median * 1e9, r->p99 * 1e9,
+		       r->items / r->median, pixel_rate(r));
+		if(config.baseline && r->baseline_rate > 0)
+			printf(", \"baseline_items_per_sec\": %.1f, "
+			       "\"change_percent\": %.2f, \"regression\": %s",
+			       r->baseline_rate, r->change,
+			       r->regression ? "true" : "false");
+		else if(config.baseline)
+			printf(", \"baseline_items_per_sec\": null, "
+			       "\"change_percent\": null, \"regression\": false");
+		for(int j = 0; config.counters && j < PERF_COUNTER_COUNT; j++) {
+			const char *n = perf_counter_name(j);
+			if(!r->counters.valid[j]) {
+				printf(", \"%s_per_item\": null, \"%s_per_pixel\": null", n,
+				       n);
+				continue;
+			}
+			printf(", \"%s_per_item\": %.3f", n,
+			       r->counters.values[j] / r->items);
+			if(r->pixels)
+				printf(", \"%s_per_pixel\": %.3f", n,
+				       r->counters.values[j] / r->pixels);
+			else
+				printf(", \"%s_per_pixel\": null", n);
+		}
+		printf("}");
+	}
+	printf("\n\t]\n}");
+}
+
+static void bench_emit_csv() {
+	printf("name,unit,items,pixels,min_ns,median_ns,p99_ns,items_per_sec,"
+	       "pixels_per_sec");
+	if(config.baseline)
+		printf(",baseline_items_per_sec,change_percent,regression");
+	for(int j = 0; config.counters && j < PERF_COUNTER_COUNT; j++)
+		printf(",%s_per_item,%s_per_pixel", perf_counter_name(j),
+		       perf_counter_name(j));
+	for(int i = 0; i < result_size; i++) {
+		BenchResult *r = &results[i];
+		printf("\n%s,%s,%ld,%ld,%.0f,%.0f,%.0f,%.1f,%.1f", r->name, r->unit,
+		       r->items, r->pixels, r->min * 1e9, r->median * 1e9,
+		       r->p99 * 1e9, r->items / r->median, pixel_rate(r));
+		if(config.baseline && r->baseline_rate > 0)
+			printf(",%.1f,%.2f,%d", r->baseline_rate, r->change,
+			       r->regression);
+		else if(config.baseline)
+			printf(",,,0");
+		for(int j = 0; config.counters && j < PERF_COUNTER_COUNT; j++) {
+			if(!r->counters.valid[j]) {
+				printf(",,");
+				continue;
+			}
+			printf(",%.3f,", r->counters.values[j] / r->items);
+			if(r->pixels)
+				printf("%.3f", r->counters.values[j] / r->pixels);
+		}
+	}
+}
+
+// Random lines, circles and ellipses of every algorithm, each spanning up to
+// an eighth of the canvas
+static void gen_scene(Primitive *out, int count, int width, int height) {
+	int span = (width < height ? width : height) / 8;
+	for(int i = 0; i < count; i++) {
+		Primitive *p = &out[i];
+		p->type      = rand_in(PRIM_LINE, PRIM_ELLIPSE);
+		p->algo      = rand_in(ALGO_DDA, ALGO_MIDPOINT);
+		p->symmetry  = 0;
+		p->args[0]   = rand_in(0, width - 1);
+		p->args[1]   = rand_in(0, height - 1);
+		switch(p->type) {
+			case PRIM_LINE:
+				p->args[2] = p->args[0] + rand_in(0, span);
+				p->args[3] = p->args[1] + rand_in(-span, span);
+				break;
+			case PRIM_CIRCLE:
+				if(p->algo == ALGO_DDA)
+					p->algo = ALGO_BRESENHAM;
+				p->symmetry = p->algo == ALGO_MIDPOINT ? 8 : 0;
+				p->args[2]  = rand_in(1, span / 2);
+				break;
+			case PRIM_ELLIPSE:
+				p->args[2] = rand_in(1, span / 2);
+				p->args[3] = rand_in(1, span / 2);
+				break;
+		}
+	}
+}
+
+// Random primitives around the origin, and circles of every symmetry,
+// which the circle algorithms stray the furthest from the radius with
+static void gen_strays(Primitive *out, int count) {
+	int symmetries[] = {0, 4, 8, 16, 32, 64, 128, 256};
+	gen_scene(out, count, 128, 128);
+	for(int i = 0; i < count; i++) {
+		Primitive *p = &out[i];
+		p->args[0] -= 64;
+		p->args[1] -= 64;
+		if(p->type == PRIM_LINE) {
+			p->args[2] -= 64;
+			p->args[3] -= 64;
+		} else if(p->type == PRIM_CIRCLE) {
+			p->algo     = rand_in(ALGO_BRESENHAM, ALGO_MIDPOINT);
+			p->symmetry = symmetries[rand_in(0, 7)];
+			p->args[2]  = rand_in(1, 64);
+		}
+	}
+}
+
+static void scene_serial() {
+	for(int i = 0; i < prim_count; i++)
+		primitive_draw(bench_canvas, &scene[i]);
+}
+
+static void scene_tiled() {
+	render_tiled(bench_canvas, scene, prim_count, bench_pool);
+}
+
+static void bench_tiled() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	bench_pool = pool_new(config.threads);
+
+	pbench("Testing serial rendering of a mixed scene");
+	bench_collect(scene_serial, screen_clear);
+	bench_report("scene/serial", "primitives", prim_count, 0);
+
+	pbench("Testing tiled rendering of a mixed scene on %d threads",
+	       pool_size(bench_pool));
+	bench_collect(scene_tiled, screen_clear);
+	bench_report("scene/tiled", "primitives", prim_count, 0);
+
+	// Both of the paths must light up exactly the same cells
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	scene_serial();
+	memcpy(copy, get_framebuffer(), size);
+	screen_clear();
+	scene_tiled();
+	if(memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("Tiled rendering differs from the serial one!");
+	free(copy);
+
+	pool_free(bench_pool);
+	terminate_driver();
+}
+
+static Primitive *   cull_map   = NULL;
+static SpatialIndex *cull_index = NULL;
+
+// The primitives of a scene the size of the canvas, scattered over a map
+// of BENCH_CULL_WORLD by BENCH_CULL_WORLD canvases centered on it
+static void gen_map(Primitive *out, int count, int width, int height) {
+	gen_scene(out, count, width, height);
+	int half = BENCH_CULL_WORLD / 2;
+	for(int i = 0; i < count; i++) {
+		Primitive *p  = &out[i];
+		int        dx = rand_in(-half * width, half * width);
+		int        dy = rand_in(-half * height, half * height);
+		p->args[0] += dx;
+		p->args[1] += dy;
+		if(p->type == PRIM_LINE) {
+			p->args[2] += dx;
+			p->args[3] += dy;
+		}
+	}
+}
+
+static void cull_none() {
+	for(int i = 0; i < cull_count; i++)
+		primitive_draw(bench_canvas, &cull_map[i]);
+}
+
+// Tests the bounds of every primitive against the canvas
+static void cull_linear() {
+	int width = canvas_width(), height = canvas_height();
+	for(int i = 0; i < cull_count; i++) {
+		int xmin, ymin, xmax, ymax;
+		primitive_bounds(&cull_map[i], &xmin, &ymin, &xmax, &ymax);
+		if(xmin < width && xmax >= 0 && ymin < height && ymax >= 0)
+			primitive_draw(bench_canvas, &cull_map[i]);
+	}
+}
+
+static void cull_indexed() {
+	spatial_draw(cull_index, bench_canvas);
+}
+
+static void cull_build() {
+	spatial_free(cull_index);
+	cull_index = spatial_new(cull_map, cull_count);
+}
+
+// Checks that drawing the first count primitives of the map through the
+// spatial index on the canvas plots the same cells as drawing all of them.
+// Returns 1 if it does not.
+static int cull_check(Canvas *cv, int count) {
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	screen_clear();
+	for(int i = 0; i < count; i++) primitive_draw(cv, &cull_map[i]);
+	memcpy(copy, get_framebuffer(), size);
+	screen_clear();
+	spatial_draw(cull_index, cv);
+	int differs = memcmp(copy, get_framebuffer(), size) != 0;
+	free(copy);
+	return differs;
+}
+
+static void bench_cull() {
+	init_driver_headless(BENCH_CANVAS_ROWS, BENCH_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	cull_map     = (Primitive *)malloc(sizeof(Primitive) * cull_count);
+	srand(BENCH_SEED);
+	gen_map(cull_map, cull_count, canvas_width(), canvas_height());
+
+	pbench("Testing drawing a map of %d primitives without culling",
+	       cull_count);
+	bench_collect(cull_none, screen_clear);
+	bench_report("cull/none", "primitives", cull_count, 0);
+
+	pbench("Testing culling the map by the bounds of every primitive");
+	bench_collect(cull_linear, screen_clear);
+	bench_report("cull/linear", "primitives", cull_count, 0);
+
+	pbench("Testing building a spatial index of the map");
+	cull_index = spatial_new(cull_map, cull_count);
+	bench_collect(cull_build, NULL);
+	bench_report("cull/build", "primitives", cull_count, 0);
+
+	pbench("Testing culling the map using the spatial index");
+	bench_collect(cull_indexed, screen_clear);
+	bench_report("cull/index", "primitives", cull_count, 0);
+
+	// Culling must not change a single cell, neither of the map nor of a few
+	// circles around the origin, which stray from their radius the most,
+	// and neither on the canvas nor on a view of its corner
+	int fails  = cull_check(bench_canvas, cull_count);
+	int strays = cull_count < BENCH_CULL_STRAYS ? cull_count
+	                                            : BENCH_CULL_STRAYS;
+	gen_strays(cull_map, strays);
+	spatial_free(cull_index);
+	cull_index = spatial_new(cull_map, strays);
+	fails += cull_check(bench_canvas, strays);
+	Canvas view = canvas_view(bench_canvas, get_rows() - 40, 0, 40, 80);
+	fails += cull_check(&view, strays);
+	canvas_view_release(&view);
+	if(fails)
+		pwarn("Culling with the spatial index changes the framebuffer!");
+
+	spatial_free(cull_index);
+	free(cull_map);
+	cull_index = NULL;
+	cull_map   = NULL;
+	terminate_driver();
+}
+
+static int (*pick_points)[2] = NULL;
+static u32 pick_sum;
+
+// Finds the last primitive whose bounds contain each point, the cheapest
+// of the geometric tests
+static void pick_bounds() {
+	u32 sum = 0;
+	for(int q = 0; q < BENCH_PICK_QUERIES; q++) {
+		int x = pick_points[q][0], y = pick_points[q][1];
+		u32 hit = CANVAS_NO_ID;
+		for(int i = 0; i < prim_count; i++) {
+			int xmin, ymin, xmax, ymax;
+			primitive_bounds(&scene[i], &xmin, &ymin, &xmax, &ymax);
+			if(x >= xmin && x <= xmax && y >= ymin && y <= ymax)
+				hit = i;
+		}
+		sum += hit;
+	}
+	pick_sum = sum;
+}
+
+static void pick_ids() {
+	u32 sum = 0;
+	for(int q = 0; q < BENCH_PICK_QUERIES; q++)
+		sum += canvas_pick(bench_canvas, pick_points[q][0], pick_points[q][1]);
+	pick_sum = sum;
+}
+
+static void scene_ids() {
+	for(int i = 0; i < prim_count; i++) {
+		canvas_set_id(bench_canvas, i);
+		primitive_draw(bench_canvas, &scene[i]);
+	}
+}
+
+static void bench_pick() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	pick_points = malloc(sizeof(*pick_points) * BENCH_PICK_QUERIES);
+	for(int q = 0; q < BENCH_PICK_QUERIES; q++) {
+		pick_points[q][0] = rand_in(0, BENCH_LARGE_CANVAS_COLS / 2 - 1);
+		pick_points[q][1] = rand_in(0, BENCH_LARGE_CANVAS_ROWS - 1);
+	}
+
+	pbench("Testing rendering of a mixed scene without an ID buffer");
+	bench_collect(scene_serial, screen_clear);
+	bench_report("pick/draw", "primitives", prim_count, 0);
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	scene_serial();
+	memcpy(copy, get_framebuffer(), size);
+	screen_clear();
+
+	canvas_enable_ids(bench_canvas, 1);
+	pbench("Testing rendering of a mixed scene with an ID buffer");
+	bench_collect(scene_ids, screen_clear);
+	bench_report("pick/draw ids", "primitives", prim_count, 0);
+	scene_ids();
+	// The ID buffer must not change a single cell, and every lit cell must
+	// have been lit by the primitive it names
+	if(memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("Rendering with an ID buffer changes the framebuffer!");
+	int wrong = 0;
+	for(int y = 0; y < BENCH_LARGE_CANVAS_ROWS; y++) {
+		for(int x = 0; x < BENCH_LARGE_CANVAS_COLS / 2; x++) {
+			siz cell = (siz)(get_rows() - y - 1) * get_columns() + x * 2 + 1;
+			u32 id   = canvas_pick(bench_canvas, x, y);
+			u8  lit  = copy[cell];
+			int xmin = 0, ymin = 0, xmax = -1, ymax = -1;
+			if(id != CANVAS_NO_ID)
+				primitive_bounds(&scene[id], &xmin, &ymin, &xmax, &ymax);
+			wrong += lit != (id != CANVAS_NO_ID) ||
+			         (lit && (x < xmin || x > xmax || y < ymin || y > ymax));
+		}
+	}
+	if(wrong)
+		pwarn("%d cells of the ID buffer are wrong!", wrong);
+	free(copy);
+
+	pbench("Testing picking %d points by the bounds of every primitive",
+	       BENCH_PICK_QUERIES);
+	bench_collect(pick_bounds, NULL);
+	bench_report("pick/bounds", "points", BENCH_PICK_QUERIES, 0);
+
+	pbench("Testing picking %d points from the ID buffer", BENCH_PICK_QUERIES);
+	bench_collect(pick_ids, NULL);
+	bench_report("pick/ids", "points", BENCH_PICK_QUERIES, 0);
+
+	canvas_enable_ids(bench_canvas, 0);
+	free(pick_points);
+	pick_points = NULL;
+	terminate_driver();
+}
+
+static Retained *tick_set = NULL;
+static int       tick     = 0;
+
+// Replaces the next primitives of the scene, returning the first of them
+static int tick_change() {
+	int first = (tick * BENCH_TICK_UPDATES) % prim_count;
+	for(int k = 0; k < BENCH_TICK_UPDATES; k++)
+		gen_scene(&scene[(first + k) % prim_count], 1,
+		          BENCH_LARGE_CANVAS_COLS / 2, BENCH_LARGE_CANVAS_ROWS);
+	tick++;
+	return first;
+}
+
+static void tick_full() {
+	tick_change();
+	screen_clear();
+	scene_serial();
+}
+
+static void tick_retained() {
+	int first = tick_change();
+	for(int k = 0; k < BENCH_TICK_UPDATES; k++) {
+		int i = (first + k) % prim_count;
+		retained_update(tick_set, i, &scene[i]);
+	}
+}
+
+typedef struct {
+	u64 order;
+	int handle;
+} TickOrder;
+
+static int compare_order(const void *a, const void *b) {
+	u64 x = ((const TickOrder *)a)->order, y = ((const TickOrder *)b)->order;
+	return (x > y) - (x < y);
+}
+
+// Checks that replacing and removing primitives around the origin keeps the
+// same cells and IDs as drawing the rest of them again, in the order they
+// were last drawn. Returns 1 if it does not.
+static int incremental_check_ids(int count) {
+	Canvas *  kept = canvas_new(128, 256), *drawn = canvas_new(128, 256);
+	canvas_enable_ids(kept, 1);
+	canvas_enable_ids(drawn, 1);
+	Retained *set = retained_new(kept);
+	gen_strays(scene, count);
+	for(int i = 0; i < count; i++) retained_add(set, &scene[i]);
+	for(int i = 0; i < count; i++) {
+		int k = rand_in(0, count - 1);
+		gen_strays(&scene[k], 1);
+		retained_update(set, k, &scene[k]);
+	}
+	for(int i = 0; i < count; i += 7) retained_remove(set, i);
+
+	TickOrder *order = (TickOrder *)malloc(sizeof(TickOrder) * count);
+	for(int i = 0; i < count; i++) {
+		order[i].order  = set->order[i];
+		order[i].handle = i;
+	}
+	qsort(order, count, sizeof(TickOrder), compare_order);
+	for(int i = 0; i < count; i++) {
+		if(!order[i].order)
+			continue;
+		canvas_set_id(drawn, order[i].handle);
+		primitive_draw(drawn, &scene[order[i].handle]);
+	}
+	siz cells   = (siz)kept->rows * kept->cols;
+	int differs = memcmp(kept->pixels, drawn->pixels, cells) != 0 ||
+	              memcmp(kept->ids, drawn->ids, cells * sizeof(u32)) != 0;
+	free(order);
+	retained_free(set);
+	canvas_free(kept);
+	canvas_free(drawn);
+	return differs;
+}
+
+static void bench_incremental() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	tick = 0;
+
+	pbench("Testing replacing %d of %d primitives by drawing all of them",
+	       BENCH_TICK_UPDATES, prim_count);
+	bench_collect(tick_full, NULL);
+	bench_report("incremental/full", "updates", BENCH_TICK_UPDATES, 0);
+
+	tick_set = retained_new(bench_canvas);
+	for(int i = 0; i < prim_count; i++) retained_add(tick_set, &scene[i]);
+	pbench("Testing replacing %d of %d primitives with reference counts",
+	       BENCH_TICK_UPDATES, prim_count);
+	bench_collect(tick_retained, NULL);
+	bench_report("incremental/retained", "updates", BENCH_TICK_UPDATES, 0);
+
+	// The lit cells do not depend on the order of the primitives
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	memcpy(copy, get_framebuffer(), size);
+	retained_free(tick_set);
+	tick_set = NULL;
+	screen_clear();
+	scene_serial();
+	if(memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("Incremental updates differ from drawing the whole scene!");
+	free(copy);
+	if(incremental_check_ids(prim_count < BENCH_TICK_STRAYS
+	                             ? prim_count
+	                             : BENCH_TICK_STRAYS))
+		pwarn("Incremental updates change the ID buffer!");
+	terminate_driver();
+}
+
+static siz transform_lit;
+
+static void scene_redraw() {
+	screen_clear();
+	scene_serial();
+}
+
+static void transform_zoom() {
+	apply_transform(TRANSFORM_ZOOM_IN);
+}
+
+static void transform_zoom_out() {
+	apply_transform(TRANSFORM_ZOOM_OUT);
+}
+
+// Fills the whole canvas with a single stroke
+static void dense_redraw() {
+	screen_clear();
+	draw_line_thick(bench_canvas, 0, get_rows() / 2, get_columns() / 2,
+	                get_rows() / 2, get_rows() * 2, STROKE_CAP_BUTT);
+}
+
+// Zooms out by moving every lit pixel, and by gathering the new cells
+// through the occupancy pyramid, which must give the same framebuffer
+static void bench_zoom_out(const char *name, void (*redraw)()) {
+	siz size = (siz)get_rows() * get_columns(), lit = 0;
+	u8 *copy = (u8 *)malloc(size);
+	redraw();
+	for(siz i = 0; i < size; i++) lit += get_framebuffer()[i];
+	char report[64];
+	for(int gather = 0; gather < 2; gather++) {
+		set_transform_gather(gather);
+		pbench("Testing %s zoom out of %zu pixels of the %s",
+		       gather ? "gathered" : "scattered", lit, name);
+		bench_collect(transform_zoom_out, redraw);
+		snprintf(report, sizeof(report), "transform/%s/%s",
+		         gather ? "gather" : "scatter", name);
+		bench_report(report, "pixels", lit, 0);
+		redraw();
+		transform_zoom_out();
+		if(gather && memcmp(copy, get_framebuffer(), size) != 0)
+			pwarn("Gathered zoom out differs from the scattered one!");
+		memcpy(copy, get_framebuffer(), size);
+	}
+	free(copy);
+}
+
+static void bench_transform() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	siz size = (siz)get_rows() * get_columns();
+	scene_serial();
+	transform_lit = 0;
+	for(siz i = 0; i < size; i++) transform_lit += get_framebuffer()[i];
+	// The zooms below move every pixel, see bench_zoom_out for the gather
+	set_transform_gather(0);
+
+	pbench("Testing serial zoom of %zu pixels", transform_lit);
+	set_transform_threads(1);
+	bench_collect(transform_zoom, scene_redraw);
+	bench_report("transform/serial", "pixels", transform_lit, 0);
+
+	set_transform_threads(config.threads);
+	pbench("Testing parallel zoom of %zu pixels", transform_lit);
+	bench_collect(transform_zoom, scene_redraw);
+	bench_report("transform/parallel", "pixels", transform_lit, 0);
+
+	// Both of the paths must produce exactly the same framebuffer
+	u8 *copy = (u8 *)malloc(size);
+	set_transform_threads(1);
+	transform_zoom();
+	memcpy(copy, get_framebuffer(), size);
+	scene_redraw();
+	set_transform_threads(config.threads);
+	transform_zoom();
+	if(memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("Parallel transformation differs from the serial one!");
+
+	set_transform_threads(1);
+	set_transform_fixed(1);
+	scene_redraw();
+	pbench("Testing fixed point zoom of %zu pixels", transform_lit);
+	bench_collect(transform_zoom, scene_redraw);
+	bench_report("transform/fixed", "pixels", transform_lit, 0);
+
+	// Translations by whole pixels must be exact, while the scaling may
+	// round a few pixels to a neighbouring cell
+	siz differ = 0;
+	transform_zoom();
+	memcpy(copy, get_framebuffer(), size);
+	set_transform_fixed(0);
+	scene_redraw();
+	transform_zoom();
+	for(siz i = 0; i < size; i++) differ += copy[i] != get_framebuffer()[i];
+	pbench("Fixed point zoom differs in %zu of %zu cells", differ, size);
+	TransformOp moves[] = {TRANSFORM_LEFT,  TRANSFORM_UP,   TRANSFORM_RIGHT,
+	                       TRANSFORM_RIGHT, TRANSFORM_DOWN, TRANSFORM_DOWN,
+	                       TRANSFORM_LEFT};
+	int px = bench_canvas->pivot_x, py = bench_canvas->pivot_y;
+	for(int fixed = 0; fixed < 2; fixed++) {
+		set_transform_fixed(fixed);
+		bench_canvas->pivot_x = px;
+		bench_canvas->pivot_y = py;
+		scene_redraw();
+		for(int i = 0; i < 7; i++) apply_transform(moves[i]);
+		if(fixed && memcmp(copy, get_framebuffer(), size) != 0)
+			pwarn("Fixed point translation differs from the matrix one!");
+		memcpy(copy, get_framebuffer(), size);
+	}
+	set_transform_fixed(0);
+	free(copy);
+
+	// Both of the zooms out run on all the threads
+	set_transform_threads(config.threads);
+	bench_zoom_out("scene", scene_redraw);
+	bench_zoom_out("filled canvas", dense_redraw);
+
+	terminate_driver();
+}
+
+static BatchScene *thumbs = NULL;
+static Scheduler * bench_sched = NULL;
+
+static void thumbs_serial() {
+	for(int i = 0; i < thumb_count; i++) {
+		for(siz j = 0; j < thumbs[i].count; j++)
+			primitive_draw(thumbs[i].canvas, &thumbs[i].prims[j]);
+	}
+}
+
+static void thumbs_stealing() {
+	render_batch(thumbs, thumb_count, bench_sched);
+}
+
+static void thumbs_clear() {
+	for(int i = 0; i < thumb_count; i++) canvas_clear(thumbs[i].canvas);
+}
+
+static void bench_batch() {
+	srand(BENCH_SEED);
+	thumbs = (BatchScene *)malloc(sizeof(BatchScene) * thumb_count);
+	Primitive *prims =
+	    (Primitive *)malloc(sizeof(Primitive) * thumb_count *
+	                        BENCH_THUMB_MAX_PRIMS);
+	for(int i = 0; i < thumb_count; i++) {
+		thumbs[i].prims  = &prims[i * BENCH_THUMB_MAX_PRIMS];
+		thumbs[i].count  = rand_in(1, BENCH_THUMB_MAX_PRIMS);
+		thumbs[i].canvas = canvas_new(BENCH_THUMB_ROWS, BENCH_THUMB_COLS);
+		gen_scene(&prims[i * BENCH_THUMB_MAX_PRIMS], thumbs[i].count,
+		          BENCH_THUMB_COLS / 2, BENCH_THUMB_ROWS);
+	}
+	bench_sched = sched_new(config.threads);
+
+	pbench("Testing serial rendering of %d thumbnails", thumb_count);
+	bench_collect(thumbs_serial, thumbs_clear);
+	bench_report("batch/serial", "scenes", thumb_count, 0);
+
+	pbench("Testing work stealing rendering of %d thumbnails on %d threads",
+	       thumb_count, sched_size(bench_sched));
+	bench_collect(thumbs_stealing, thumbs_clear);
+	bench_report("batch/stealing", "scenes", thumb_count, 0);
+	pbench("%" Pu64 " scenes were stolen", sched_steals(bench_sched));
+
+	// Both of the paths must draw exactly the same thumbnails
+	siz size = (siz)BENCH_THUMB_ROWS * BENCH_THUMB_COLS;
+	u8 *copy = (u8 *)malloc(size * thumb_count);
+	thumbs_serial();
+	for(int i = 0; i < thumb_count; i++)
+		memcpy(&copy[i * size], thumbs[i].canvas->pixels, size);
+	thumbs_clear();
+	thumbs_stealing();
+	for(int i = 0; i < thumb_count; i++) {
+		if(memcmp(&copy[i * size], thumbs[i].canvas->pixels, size) != 0) {
+			pwarn("Thumbnail %d differs from the serial one!", i);
+			break;
+		}
+	}
+	free(copy);
+
+	sched_free(bench_sched);
+	for(int i = 0; i < thumb_count; i++) canvas_free(thumbs[i].canvas);
+	free(prims);
+	free(thumbs);
+}
+
+static char *scene_text      = NULL;
+static siz   scene_text_size = 0;
+static long  scene_parsed    = 0;
+
+static void scene_count(const Primitive *p, void *arg) {
+	(void)p;
+	(void)arg;
+	scene_parsed++;
+}
+
+static void scene_text_parse() {
+	FILE *f = fmemopen(scene_text, scene_text_size, "r");
+	scene_read(f, scene_count, NULL);
+	fclose(f);
+}
+
+static void scene_text_draw() {
+	FILE *f = fmemopen(scene_text, scene_text_size, "r");
+	scene_draw(f, bench_canvas);
+	fclose(f);
+}
+
+static int scene_fd = -1;
+
+static void scene_binary_load() {
+	SceneMap map;
+	scene_map_fd(scene_fd, &map);
+	scene_map_read(&map, scene_count, NULL);
+	scene_unmap(&map);
+}
+
+static void scene_binary_draw() {
+	SceneMap map;
+	scene_map_fd(scene_fd, &map);
+	scene_map_draw(&map, bench_canvas);
+	scene_unmap(&map);
+}
+
+// Overwrites the byte at the offset from the first record of the type in the
+// binary scene, and checks that mapping it fails. Returns 1 if it does not,
+// and 0 if the scene has no such byte.
+static int scene_check_corrupt(int type, u64 offset, u8 byte) {
+	SceneMap map;
+	u8       saved;
+	scene_map_fd(scene_fd, &map);
+	// No record is smaller than 16 bytes
+	int   has = map.counts[type] > 0 && offset < map.counts[type] * 16;
+	off_t at  = has ? (off_t)(map.records[type] - (const u8 *)map.base) : 0;
+	scene_unmap(&map);
+	if(!has)
+		return 0;
+	at += (off_t)offset;
+	if(pread(scene_fd, &saved, 1, at) != 1 ||
+	   pwrite(scene_fd, &byte, 1, at) != 1)
+		return 1;
+	int res = scene_map_fd(scene_fd, &map);
+	if(res == 1)
+		scene_unmap(&map);
+	return pwrite(scene_fd, &saved, 1, at) != 1 || res != -1;
+}
+
+static void bench_scene() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	FILE *f = open_memstream(&scene_text, &scene_text_size);
+	for(int i = 0; i < prim_count; i++) scene_write(f, &scene[i]);
+	fclose(f);
+
+	pbench("Testing parsing of a text scene of %" Psiz " bytes",
+	       scene_text_size);
+	bench_collect(scene_text_parse, NULL);
+	bench_report("scene_text/parse", "primitives", prim_count, 0);
+
+	pbench("Testing parsing and rendering of a text scene");
+	bench_collect(scene_text_draw, screen_clear);
+	bench_report("scene_text/parse_render", "primitives", prim_count, 0);
+
+	FILE *binary = tmpfile();
+	scene_binary_write(binary, scene, prim_count);
+	fflush(binary);
+	scene_fd = fileno(binary);
+	pbench("Testing loading of a mapped binary scene of %ld bytes",
+	       ftell(binary));
+	bench_collect(scene_binary_load, NULL);
+	bench_report("scene_binary/load", "primitives", prim_count, 0);
+
+	pbench("Testing loading and rendering of a mapped binary scene");
+	bench_collect(scene_binary_draw, screen_clear);
+	bench_report("scene_binary/load_render", "primitives", prim_count, 0);
+
+	// The scene read back must draw exactly the same cells
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	scene_serial();
+	memcpy(copy, get_framebuffer(), size);
+	screen_clear();
+	scene_parsed = 0;
+	scene_text_parse();
+	scene_text_draw();
+	if(scene_parsed != prim_count ||
+	   memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("The parsed scene differs from the generated one!");
+	screen_clear();
+	scene_parsed = 0;
+	scene_binary_load();
+	scene_binary_draw();
+	if(scene_parsed != prim_count ||
+	   memcmp(copy, get_framebuffer(), size) != 0)
+		pwarn("The binary scene differs from the generated one!");
+	free(copy);
+	// Records the text parser would reject must not be mapped, the last of
+	// which are circles of 1, 2 and more than 256 points, the first two of
+	// which would never be drawn
+	if(scene_check_corrupt(PRIM_LINE, 0, 0) ||
+	   scene_check_corrupt(PRIM_LINE, 20, ALGO_MIDPOINT + 1) ||
+	   scene_check_corrupt(PRIM_CIRCLE, 0, ALGO_DDA) ||
+	   scene_check_corrupt(PRIM_CIRCLE, 2, 1) ||
+	   scene_check_corrupt(PRIM_CIRCLE, 2, 2) ||
+	   scene_check_corrupt(PRIM_CIRCLE, 3, 1000 >> 8))
+		pwarn("A binary scene with corrupted records is mapped!");
+	fclose(binary);
+
+	free(scene_text);
+	scene_text = NULL;
+	terminate_driver();
+}
+
+static FILE *       export_out = NULL;
+static ExportFormat export_fmt;
+
+static void export_run() {
+	export_write(bench_canvas, export_fmt, fileno(export_out));
+}
+
+static void export_reset() {
+	if(ftruncate(fileno(export_out), 0) != 0 ||
+	   lseek(fileno(export_out), 0, SEEK_SET) != 0)
+		pwarn("Unable to rewind the export file!");
+}
+
+// Whether the export file holds exactly the image encoded in memory
+static int export_check() {
+	char header[64];
+	siz  header_size = export_header(bench_canvas, export_fmt, header);
+	siz  data_size   = export_data_size(bench_canvas, export_fmt);
+	siz  size        = lseek(fileno(export_out), 0, SEEK_END);
+	u8 * expected    = (u8 *)malloc(header_size + data_size);
+	u8 * written     = (u8 *)malloc(size + 1);
+	memcpy(expected, header, header_size);
+	export_encode(bench_canvas, export_fmt, expected + header_size);
+	int same = size == header_size + data_size &&
+	           pread(fileno(export_out), written, size, 0) == (ssize_t)size &&
+	           memcmp(written, expected, size) == 0;
+	free(expected);
+	free(written);
+	return same;
+}
+
+static void bench_export() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	scene_serial();
+	// The images go through the page cache of a real file, as /dev/null
+	// takes any write without copying it
+	export_out = tmpfile();
+
+	const char *names[] = {"pbm", "pgm", "ppm", "raw"};
+	for(int i = 0; i < 4; i++) {
+		export_fmt = (ExportFormat)(i + 1);
+		pbench("Testing writing of %s images of %" Psiz " bytes", names[i],
+		       export_data_size(bench_canvas, export_fmt));
+		bench_collect(export_run, export_reset);
+		char name[32];
+		snprintf(name, sizeof(name), "export/%s", names[i]);
+		bench_report(name, "images", 1,
+		             (long)export_data_size(bench_canvas, EXPORT_PGM));
+		export_reset();
+		export_run();
+		if(!export_check())
+			pwarn("The %s image written differs from the encoded one!",
+			      names[i]);
+	}
+
+	fclose(export_out);
+	export_out = NULL;
+	terminate_driver();
+}
+
+// Pans and zooms around the scene, and back again
+#define BENCH_ANIMATION_SCRIPT \
+	"zoom_out*2 right*8 up*8 zoom_in*2 left*8 down*8"
+
+static AnimationStep anim_steps[16];
+static int           anim_count     = 0;
+static u8            anim_pipelined = 0;
+static FILE *        anim_file      = NULL;
+
+static void anim_run() {
+	animation_run(bench_canvas, anim_steps, anim_count, EXPORT_PPM,
+	              fileno(anim_file), get_transform_pool(), anim_pipelined);
+}
+
+static void anim_reset() {
+	scene_redraw();
+	fflush(anim_file);
+	if(ftruncate(fileno(anim_file), 0) != 0 ||
+	   lseek(fileno(anim_file), 0, SEEK_SET) != 0)
+		pwarn("Unable to rewind the animation file!");
+}
+
+// Reads the whole animation file back
+static u8 *anim_contents(siz *size) {
+	*size   = lseek(fileno(anim_file), 0, SEEK_END);
+	u8 *buf = (u8 *)malloc(*size);
+	if(pread(fileno(anim_file), buf, *size, 0) != (ssize_t)*size)
+		*size = 0;
+	return buf;
+}
+
+static void bench_animation() {
+	init_driver_headless(BENCH_CANVAS_ROWS, BENCH_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	set_pivot(BENCH_CANVAS_COLS / 4, BENCH_CANVAS_ROWS / 2);
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_CANVAS_COLS / 2, BENCH_CANVAS_ROWS);
+	anim_count = animation_parse(BENCH_ANIMATION_SCRIPT, anim_steps, 16);
+	long frames = animation_frames(anim_steps, anim_count);
+	// The frames go through the page cache of a real file, unlike
+	// /dev/null, so that writing them takes time the pipeline can hide
+	anim_file = tmpfile();
+	set_transform_threads(1);
+
+	pbench("Testing serial writing of %ld ppm frames", frames);
+	anim_pipelined = 0;
+	bench_collect(anim_run, anim_reset);
+	bench_report("animation/serial", "frames", frames,
+	             (long)export_data_size(bench_canvas, EXPORT_PGM));
+	anim_reset();
+	anim_run();
+	siz serial_size;
+	u8 *serial = anim_contents(&serial_size);
+
+	pbench("Testing pipelined writing of %ld ppm frames", frames);
+	anim_pipelined = 1;
+	bench_collect(anim_run, anim_reset);
+	bench_report("animation/pipelined", "frames", frames,
+	             (long)export_data_size(bench_canvas, EXPORT_PGM));
+
+	// Both of the paths must write exactly the same frames
+	anim_reset();
+	anim_run();
+	siz pipelined_size;
+	u8 *pipelined = anim_contents(&pipelined_size);
+	if(serial_size == 0 || serial_size != pipelined_size ||
+	   memcmp(serial, pipelined, serial_size) != 0)
+		pwarn("Pipelined animation differs from the serial one!");
+	free(serial);
+	free(pipelined);
+
+	fclose(anim_file);
+	anim_file = NULL;
+	terminate_driver();
+}
+
+// Size of the terminal the frames are sent to
+#define BENCH_TERM_ROWS 60
+#define BENCH_TERM_COLS 200
+// Pans around the scene, one frame per logical pixel
+#define BENCH_TERM_SCRIPT "right*16 up*16 left*16 down*16"
+
+static Term *bench_term   = NULL;
+static u8    term_repaint = 0;
+static u64   term_bytes   = 0;
+static long  term_frames  = 0;
+
+static void term_run() {
+	term_invalidate(bench_term);
+	for(int s = 0; s < anim_count; s++) {
+		for(int i = 0; i < anim_steps[s].count; i++) {
+			canvas_transform(bench_canvas, anim_steps[s].op, NULL);
+			term_clear(bench_term);
+			const u8 *pixels = bench_canvas->pixels;
+			for(int r = 0; r < BENCH_TERM_ROWS; r++) {
+				for(int c = 0; c < BENCH_TERM_COLS; c++) {
+					if(pixels[r * BENCH_TERM_COLS + c])
+						term_put(bench_term, r, c, "\u25a0");
+				}
+			}
+			// Like the clear() of ncurses, which repaints the whole screen
+			if(term_repaint)
+				term_invalidate(bench_term);
+			term_bytes += term_flush(bench_term);
+			term_frames++;
+		}
+	}
+}
+
+static void term_reset() {
+	scene_redraw();
+	term_bytes  = 0;
+	term_frames = 0;
+}
+
+static void bench_terminal() {
+	init_driver_headless(BENCH_TERM_ROWS, BENCH_TERM_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	int count = prim_count / 20;
+	gen_scene(scene, count, BENCH_TERM_COLS / 2, BENCH_TERM_ROWS);
+	anim_count  = animation_parse(BENCH_TERM_SCRIPT, anim_steps, 16);
+	long frames = animation_frames(anim_steps, anim_count) - 1;
+	int  fd     = open("/dev/null", O_WRONLY);
+	bench_term  = term_new(fd, BENCH_TERM_ROWS, BENCH_TERM_COLS);
+	int saved   = prim_count;
+	prim_count  = count;
+
+	const char *names[] = {"terminal/repaint", "terminal/diff"};
+	for(int i = 0; i < 2; i++) {
+		term_repaint = i == 0;
+		pbench("Testing %s output of %ld frames of %dx%d cells",
+		       term_repaint ? "repainted" : "diffed", frames,
+		       BENCH_TERM_ROWS, BENCH_TERM_COLS);
+		bench_collect(term_run, term_reset);
+		bench_report(names[i], "frames", frames,
+		             BENCH_TERM_ROWS * BENCH_TERM_COLS);
+		term_reset();
+		term_run();
+		pbench("%.1f bytes per frame", (double)term_bytes / term_frames);
+	}
+
+	prim_count = saved;
+	term_free(bench_term);
+	bench_term = NULL;
+	close(fd);
+	terminate_driver();
+}
+
+static GlyphMode glyph_bench_mode;
+static u8 *      glyph_bits = NULL;
+static char *    glyph_line = NULL;
+
+// Sends a whole frame of the scene to the terminal in the glyph mode
+static void glyph_frame() {
+	Canvas *c = bench_canvas;
+	term_clear(bench_term);
+	if(glyph_bench_mode == GLYPH_CELLS) {
+		for(int r = 0; r < c->rows; r++) {
+			for(int col = 0; col < c->cols; col++) {
+				if(c->pixels[(siz)r * c->cols + col])
+					term_put(bench_term, r, col, "\u25a0");
+			}
+		}
+	} else {
+		int width = c->cols / 2;
+		siz stride = (width + 7) / 8;
+		export_encode(c, EXPORT_PBM, glyph_bits);
+		for(int r = 0; r * glyph_height(glyph_bench_mode) < c->rows; r++) {
+			glyph_encode_row(glyph_bits, stride, width, c->rows, r,
+			                 glyph_bench_mode, glyph_line);
+			term_put(bench_term, r, 0, glyph_line);
+		}
+	}
+	term_invalidate(bench_term);
+	term_bytes = term_flush(bench_term);
+}
+
+static void bench_glyphs() {
+	init_driver_headless(BENCH_CANVAS_ROWS, BENCH_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_CANVAS_COLS / 2, BENCH_CANVAS_ROWS);
+	scene_serial();
+	int width  = BENCH_CANVAS_COLS / 2;
+	glyph_bits = (u8 *)malloc((siz)BENCH_CANVAS_ROWS * ((width + 7) / 8));
+	glyph_line = (char *)malloc(GLYPH_MAX_BYTES * width + 1);
+	int fd     = open("/dev/null", O_WRONLY);
+
+	const char *names[] = {"glyphs/cells", "glyphs/quadrant", "glyphs/braille"};
+	for(int i = GLYPH_CELLS; i <= GLYPH_BRAILLE; i++) {
+		glyph_bench_mode = (GlyphMode)i;
+		int rows = BENCH_CANVAS_ROWS / glyph_height(glyph_bench_mode);
+		int cols = i == GLYPH_CELLS ? BENCH_CANVAS_COLS : width / 2;
+		bench_term = term_new(fd, rows, cols);
+		pbench("Testing repainting of %d logical pixels on %dx%d characters",
+		       width * BENCH_CANVAS_ROWS, rows, cols);
+		bench_collect(glyph_frame, NULL);
+		bench_report(names[i], "frames", 1, width * BENCH_CANVAS_ROWS);
+		pbench("%" Pu64 " bytes per frame", term_bytes);
+		term_free(bench_term);
+	}
+
+	bench_term = NULL;
+	close(fd);
+	free(glyph_line);
+	free(glyph_bits);
+	terminate_driver();
+}
+
+extern char **environ;
+
+static int  server_fd = -1, server_requests = 0;
+static char server_path[64], spawn_output[64];
+
+static void *server_thread(void *arg) {
+	(void)arg;
+	server_run(server_path);
+	return NULL;
+}
+
+// Sends the command, and waits for the reply of the server
+static int server_request(const char *cmd) {
+	char reply[256];
+	if(write(server_fd, cmd, strlen(cmd)) != (ssize_t)strlen(cmd))
+		return -1;
+	siz size = 0;
+	while(size == 0 || reply[size - 1] != '\n') {
+		ssize_t n = read(server_fd, reply + size, sizeof(reply) - size);
+		if(n <= 0)
+			return -1;
+		size += n;
+	}
+	return strncmp(reply, "ok", 2) == 0 ? 0 : -1;
+}
+
+// Draws a line and writes the image, one request after another
+static void server_draw() {
+	char cmd[64];
+	for(int i = 0; i < server_requests; i++) {
+		snprintf(cmd, sizeof(cmd), "draw c line bresenham 0 %d 255 %d\n",
+		         i % 256, 255 - i % 256);
+		if(server_request(cmd) != 0)
+			pwarn("The server failed to draw!");
+	}
+}
+
+// Does the same as a fresh process per request
+static void spawn_draw() {
+	char *argv[] = {"cug",      "-o=line", "-a=bresenham", "-x=0,0",
+	                "-y=255,0", NULL,      NULL};
+	char output[80];
+	snprintf(output, sizeof(output), "-O=%s", spawn_output);
+	argv[5] = output;
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+	                                 O_WRONLY, 0);
+	for(int i = 0; i < BENCH_SPAWN_REQUESTS; i++) {
+		pid_t pid;
+		int   status;
+		if(posix_spawn(&pid, "/proc/self/exe", &actions, NULL, argv,
+		               environ) != 0 ||
+		   waitpid(pid, &status, 0) != pid || status != 0)
+			pwarn("Unable to run the drawing process!");
+	}
+	posix_spawn_file_actions_destroy(&actions);
+}
+
+static void bench_server() {
+	snprintf(server_path, sizeof(server_path), "/tmp/cug-bench-%d.sock",
+	         (int)getpid());
+	snprintf(spawn_output, sizeof(spawn_output), "/tmp/cug-bench-%d.pbm",
+	         (int)getpid());
+	server_requests = config.iterations > 0 ? config.iterations
+	                                        : BENCH_DEFAULT_SERVER_REQUESTS;
+	pthread_t thread;
+	pthread_create(&thread, NULL, server_thread, NULL);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, server_path);
+	server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	// The server may not be listening yet
+	for(int i = 0; i < 1000; i++) {
+		if(connect(server_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+			break;
+		usleep(1000);
+	}
+	if(server_request("canvas c 256 256\n") != 0)
+		pwarn("Unable to create a canvas on the server!");
+
+	pbench("Testing %d drawing requests to a render server", server_requests);
+	bench_collect(server_draw, NULL);
+	bench_report("server/request", "requests", server_requests, 0);
+
+	pbench("Testing %d drawing processes", BENCH_SPAWN_REQUESTS);
+	bench_collect(spawn_draw, NULL);
+	bench_report("server/process", "requests", BENCH_SPAWN_REQUESTS, 0);
+
+	server_request("shutdown\n");
+	close(server_fd);
+	pthread_join(thread, NULL);
+	unlink(spawn_output);
+}
+
+static RasterCount sink_count;
+static RasterBits  sink_bits;
+
+// The pixels go through canvas_put_pixel, like before the sinks
+static void sinks_put_pixel() {
+	for(int i = 0; i < prim_count; i++)
+		raster_primitive_terminal(bench_canvas, &scene[i]);
+}
+
+static void sinks_bytes() {
+	for(int i = 0; i < prim_count; i++)
+		raster_primitive_bytes(bench_canvas, &scene[i]);
+}
+
+static void sinks_bits() {
+	for(int i = 0; i < prim_count; i++)
+		raster_primitive_bits(&sink_bits, &scene[i]);
+}
+
+static void sinks_count() {
+	for(int i = 0; i < prim_count; i++)
+		raster_primitive_count(&sink_count, &scene[i]);
+}
+
+// Checks that every pixel of the primitives is within their bounds. All of
+// the sinks plot the same pixels, which is checked by bench_sinks.
+static void sinks_check_bounds() {
+	int outside = 0;
+	for(int i = 0; i < prim_count; i++) {
+		RasterExtent e = raster_extent_empty();
+		int          xmin, ymin, xmax, ymax;
+		raster_primitive_extent(&e, &scene[i]);
+		primitive_bounds(&scene[i], &xmin, &ymin, &xmax, &ymax);
+		outside += e.pixel_count && (e.xmin < xmin || e.xmax > xmax ||
+		                             e.ymin < ymin || e.ymax > ymax);
+	}
+	if(outside)
+		pwarn("%d primitives plot outside of their bounds!", outside);
+}
+
+static void sinks_clear() {
+	screen_clear();
+	memset(sink_bits.bits, 0,
+	       raster_bits_words(sink_bits.width, sink_bits.height) * sizeof(u64));
+	sink_bits.pixel_count  = 0;
+	sink_count.pixel_count = 0;
+}
+
+static void bench_sinks() {
+	init_driver_headless(BENCH_LARGE_CANVAS_ROWS, BENCH_LARGE_CANVAS_COLS);
+	bench_canvas = canvas_default();
+	srand(BENCH_SEED);
+	gen_scene(scene, prim_count, BENCH_LARGE_CANVAS_COLS / 2,
+	          BENCH_LARGE_CANVAS_ROWS);
+	sink_bits.width  = BENCH_LARGE_CANVAS_COLS / 2;
+	sink_bits.height = BENCH_LARGE_CANVAS_ROWS;
+	sink_bits.bits   = (u64 *)calloc(
+	    raster_bits_words(sink_bits.width, sink_bits.height), sizeof(u64));
+	sinks_clear();
+	sinks_count();
+	long pixels = sink_count.pixel_count;
+
+	pbench("Testing rasterization of a scene through put_pixel");
+	bench_collect(sinks_put_pixel, sinks_clear);
+	bench_report("sinks/put_pixel", "primitives", prim_count, pixels);
+
+	pbench("Testing rasterization of a scene into the framebuffer");
+	bench_collect(sinks_bytes, sinks_clear);
+	bench_report("sinks/bytes", "primitives", prim_count, pixels);
+
+	pbench("Testing rasterization of a scene into a bitset");
+	bench_collect(sinks_bits, sinks_clear);
+	bench_report("sinks/bits", "primitives", prim_count, pixels);
+
+	pbench("Testing counting of the pixels of a scene");
+	bench_collect(sinks_count, sinks_clear);
+	bench_report("sinks/count", "primitives", prim_count, pixels);
+
+	// Every sink must plot exactly the same pixels
+	siz size = (siz)get_rows() * get_columns();
+	u8 *copy = (u8 *)malloc(size);
+	sinks_clear();
+	u64 before = get_pixel_count();
+	sinks_put_pixel();
+	memcpy(copy, get_framebuffer(), size);
+	u64 plotted = get_pixel_count() - before;
+	sinks_clear();
+	before = get_pixel_count();
+	sinks_bytes();
+	sinks_bits();
+	sinks_count();
+	if(memcmp(copy, get_framebuffer(), size) != 0 ||
+	   get_pixel_count() - before != plotted)
+		pwarn("The framebuffer sink differs from put_pixel!");
+	int mismatch = sink_count.pixel_count != plotted ||
+	               sink_bits.pixel_count != plotted;
+	for(int y = 0; y < sink_bits.height; y++)
+		for(int x = 0; x < sink_bits.width; x++)
+			mismatch |= raster_bits_get(&sink_bits, x, y) !=
+			            copy[(siz)(get_rows() - y - 1) * get_columns() +
+			                 x * 2 + 1];
+	if(mismatch)
+		pwarn("The bitset and counting sinks differ from put_pixel!");
+	free(copy);
+	free(sink_bits.bits);
+	sinks_check_bounds();
+	gen_strays(scene, prim_count);
+	sinks_check_bounds();
+	terminate_driver();
+}
+
+int bench(BenchType type, const BenchConfig *c) {
+	bench_init(c);
+	pbench("%d warmup run(s), %d timed repetition(s) per benchmark",
+	       config.warmup, config.repetitions);
+	int needs_matrices = type >= BENCH_FILL && type <= BENCH_MULT;
+	if(needs_matrices) {
+		pbench("Creating %d 3x3 matrices..", mat_count);
 		matrix_create();
 	}
 	switch(type) {
@@ -162,16 +2087,69 @@ void bench(BenchType type) {
 		case BENCH_MULT: bench_matrix_mult(); break;
 		case BENCH_SUB: bench_matrix_sub(); break;
 		case BENCH_PUT: bench_draw(); break;
+		case BENCH_LINE: bench_line(); break;
+		case BENCH_CIRCLE: bench_circle(); break;
+		case BENCH_ELLIPSE: bench_ellipse(); break;
+		case BENCH_CLIP: bench_clip(); break;
+		case BENCH_TILED: bench_tiled(); break;
+		case BENCH_TRANSFORM: bench_transform(); break;
+		case BENCH_BATCH: bench_batch(); break;
+		case BENCH_SCENE: bench_scene(); break;
+		case BENCH_EXPORT: bench_export(); break;
+		case BENCH_ANIMATION: bench_animation(); break;
+		case BENCH_TERMINAL: bench_terminal(); break;
+		case BENCH_GLYPHS: bench_glyphs(); break;
+		case BENCH_SERVER: bench_server(); break;
+		case BENCH_SINKS: bench_sinks(); break;
+		case BENCH_CURVE: bench_curve(); break;
+		case BENCH_STROKE: bench_stroke(); break;
+		case BENCH_CULL: bench_cull(); break;
+		case BENCH_PICK: bench_pick(); break;
+		case BENCH_INCREMENTAL: bench_incremental(); break;
 		case BENCH_ALL:
 			bench_matrix_create();
+			// Every creation run is released, so recreate the set the
+			// rest of the benchmarks operate on
+			matrix_create();
 			bench_matrix_fill();
 			bench_matrix_mult();
 			bench_matrix_add();
 			bench_matrix_sub();
-			bench_draw();
+			free_mat();
+			bench_line();
+			bench_circle();
+			bench_ellipse();
+			bench_clip();
+			bench_curve();
+			bench_stroke();
+			bench_tiled();
+			bench_cull();
+			bench_pick();
+			bench_incremental();
+			bench_transform();
+			bench_batch();
+			bench_scene();
+			bench_export();
+			bench_animation();
+			bench_terminal();
+			bench_glyphs();
+			bench_server();
+			bench_sinks();
+			// The terminal output of ncurses would be interleaved with
+			// the machine readable results
+			if(config.format == BENCH_FORMAT_TEXT)
+				bench_draw();
 			break;
 	}
-	if(type != BENCH_PUT)
+	if(needs_matrices)
 		free_mat();
+	int regressions = config.baseline ? bench_compare() : 0;
+	switch(config.format) {
+		case BENCH_FORMAT_TEXT: bench_emit_text(); break;
+		case BENCH_FORMAT_JSON: bench_emit_json(); break;
+		case BENCH_FORMAT_CSV: bench_emit_csv(); break;
+	}
+	bench_free();
 	printf("\n");
+	return regressions;
 }
@@ -1,12 +1,53 @@
 #pragma once
 
 typedef enum {
-	BENCH_CREATE = 1,
-	BENCH_FILL   = 2,
-	BENCH_ADD    = 3,
-	BENCH_SUB    = 4,
-	BENCH_MULT   = 5,
-	BENCH_PUT    = 6,
-	BENCH_ALL    = 7
+	BENCH_CREATE      = 1,
+	BENCH_FILL        = 2,
+	BENCH_ADD         = 3,
+	BENCH_SUB         = 4,
+	BENCH_MULT        = 5,
+	BENCH_PUT         = 6,
+	BENCH_LINE        = 7,
+	BENCH_CIRCLE      = 8,
+	BENCH_ELLIPSE     = 9,
+	BENCH_CLIP        = 10,
+	BENCH_TILED       = 11,
+	BENCH_TRANSFORM   = 12,
+	BENCH_BATCH       = 13,
+	BENCH_SCENE       = 14,
+	BENCH_EXPORT      = 15,
+	BENCH_ANIMATION   = 16,
+	BENCH_TERMINAL    = 17,
+	BENCH_GLYPHS      = 18,
+	BENCH_SERVER      = 19,
+	BENCH_SINKS       = 20,
+	BENCH_CURVE       = 21,
+	BENCH_STROKE      = 22,
+	BENCH_CULL        = 23,
+	BENCH_PICK        = 24,
+	BENCH_INCREMENTAL = 25,
+	BENCH_ALL         = 26
 } BenchType;
-void bench(BenchType type);
+
+typedef enum {
+	BENCH_FORMAT_TEXT = 1,
+	BENCH_FORMAT_JSON = 2,
+	BENCH_FORMAT_CSV = 3
+} BenchFormat;
+
+// Runtime configuration of the benchmarks
+typedef struct {
+	int         iterations;  // Items processed per run, <= 0 for defaults
+	int         warmup;      // Untimed runs before measuring, < 0 for default
+	int         repetitions; // Timed runs, <= 0 for the default
+	BenchFormat format;      // Format of the results written to stdout
+	const char *baseline;    // csv results to compare against, may be NULL
+	double      threshold;   // Slowdown in percent to flag as a regression,
+	                         // <= 0 for the default
+	int         counters;    // Whether to read the hardware counters
+	int         threads;     // Threads to render on, <= 0 for all the cores
+} BenchConfig;
+
+// Perform the benchmark(s) and write the results. Returns the number of
+// regressions against the baseline, or -1 if the baseline was unreadable.
+int bench(BenchType type, const BenchConfig *config);
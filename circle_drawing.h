@@ -1,5 +1,7 @@
 #pragma once
 
-void draw_circle_bresenham(int x, int y, int r);
-void draw_circle_bresenham_n_point(int x, int y, int r, int points);
-void draw_circle_midpoint(int x, int y, int r, int points);
+#include "driver.h"
+
+void draw_circle_bresenham(Canvas *cv, int x, int y, int r);
+void draw_circle_bresenham_n_point(Canvas *cv, int x, int y, int r, int points);
+void draw_circle_midpoint(Canvas *cv, int x, int y, int r, int points);
@@ -19,30 +19,30 @@ static int get_region_code(int x, int y, int xmin, int ymin, int xmax,
 	return code;
 }
 
-static void draw_rect(int bx, int by, int tx, int ty) {
-	set_pixel(bx, by, bottom_left);
-	set_pixel(bx, ty, top_left);
-	set_pixel(tx, by, bottom_right);
-	set_pixel(tx, ty, top_right);
+static void draw_rect(Canvas *cv, int bx, int by, int tx, int ty) {
+	canvas_set_pixel(cv, bx, by, bottom_left);
+	canvas_set_pixel(cv, bx, ty, top_left);
+	canvas_set_pixel(cv, tx, by, bottom_right);
+	canvas_set_pixel(cv, tx, ty, top_right);
 	int bak = bx;
 	while(bx < tx) {
-		set_pixel(bx, ty, horizontal);
-		set_pixel(bx, by, horizontal);
+		canvas_set_pixel(cv, bx, ty, horizontal);
+		canvas_set_pixel(cv, bx, by, horizontal);
 		bx++;
 	}
 	bx  = bak;
 	bak = by;
 	while(by < ty) {
-		set_pixel(bx, by, vertical);
-		set_pixel(tx, by, vertical);
+		canvas_set_pixel(cv, bx, by, vertical);
+		canvas_set_pixel(cv, tx, by, vertical);
 		by++;
 	}
 }
 
-static int prepare_clip(int sx, int sy, int ex, int ey, int bx, int by, int tx,
-                        int ty) {
-	draw_line_bresenham(sx, sy, ex, ey);
-	draw_rect(bx, by, tx, ty);
+static int prepare_clip(Canvas *cv, int sx, int sy, int ex, int ey, int bx,
+                        int by, int tx, int ty) {
+	draw_line_bresenham(cv, sx, sy, ex, ey);
+	draw_rect(cv, bx, by, tx, ty);
 	int rcs = get_region_code(sx, sy, bx, by, tx, ty);
 	int rce = get_region_code(ex, ey, bx, by, tx, ty);
 #ifdef NO_DRAW
@@ -70,9 +70,9 @@ static int in_range(int l, int key, int u) {
 
 #define ROUND(x) ((int)((x) + 0.5))
 
-void clipping_cohen_sutherland(int x1, int y1, int x2, int y2, int xmin,
-                               int ymin, int xmax, int ymax) {
-	if(prepare_clip(x1, y1, x2, y2, xmin, ymin, xmax, ymax)) {
+void clipping_cohen_sutherland(Canvas *cv, int x1, int y1, int x2, int y2,
+                               int xmin, int ymin, int xmax, int ymax) {
+	if(prepare_clip(cv, x1, y1, x2, y2, xmin, ymin, xmax, ymax)) {
 		double m = (double)(y2 - y1) / (x2 - x1);
 #ifdef NO_DRAW
 		pdbg("xmin : %d\tymin : %d\txmax : %d\tymax : %d", xmin, ymin, xmax,
@@ -132,20 +132,20 @@ void clipping_cohen_sutherland(int x1, int y1, int x2, int y2, int xmin,
 #ifdef NO_DRAW
 		pdbg("After\nsx : %d\tsy : %d\tex : %d\tey : %d", sx, sy, ex, ey);
 #endif
-		screen_clear();
-		draw_line_bresenham(sx, sy, ex, ey);
-		draw_rect(xmin, ymin, xmax, ymax);
+		canvas_clear(cv);
+		draw_line_bresenham(cv, sx, sy, ex, ey);
+		draw_rect(cv, xmin, ymin, xmax, ymax);
 		show_msg("\t\t\t\t\t\t\t\t\t\rClipped!");
 	}
 }
 
-static void clipping_midpoint_subdivision_impl(int x1, int y1, int x2, int y2,
-                                               int xmin, int ymin, int xmax,
-                                               int ymax) {
+static void clipping_midpoint_subdivision_impl(Canvas *cv, int x1, int y1,
+                                               int x2, int y2, int xmin,
+                                               int ymin, int xmax, int ymax) {
 	int r1 = get_region_code(x1, y1, xmin, ymin, xmax, ymax);
 	int r2 = get_region_code(x2, y2, xmin, ymin, xmax, ymax);
 	if(r1 == 0 && r2 == 0) {
-		draw_line_bresenham(x1, y1, x2, y2);
+		draw_line_bresenham(cv, x1, y1, x2, y2);
 	} else if((r1 & r2) == 0) {
 		int m1 = (x1 + x2) / 2;
 		int n1 = (y1 + y2) / 2;
@@ -154,19 +154,20 @@ static void clipping_midpoint_subdivision_impl(int x1, int y1, int x2, int y2,
 		if((m1 == x1 && n1 == y1) || (m1 == x2 && n1 == y2)) {
 			return;
 		}
-		clipping_midpoint_subdivision_impl(x1, y1, m1, n1, xmin, ymin, xmax,
+		clipping_midpoint_subdivision_impl(cv, x1, y1, m1, n1, xmin, ymin, xmax,
 		                                   ymax);
-		clipping_midpoint_subdivision_impl(m1, n1, x2, y2, xmin, ymin, xmax,
+		clipping_midpoint_subdivision_impl(cv, m1, n1, x2, y2, xmin, ymin, xmax,
 		                                   ymax);
 	}
 }
 
-void clipping_midpoint_subdivision(int x1, int y1, int x2, int y2, int xmin,
-                                   int ymin, int xmax, int ymax) {
-	if(prepare_clip(x1, y1, x2, y2, xmin, ymin, xmax, ymax)) {
-		screen_clear();
-		draw_rect(xmin, ymin, xmax, ymax);
-		clipping_midpoint_subdivision_impl(x1, y1, x2, y2, xmin, ymin, xmax,
+void clipping_midpoint_subdivision(Canvas *cv, int x1, int y1, int x2,
+                                   int y2, int xmin, int ymin, int xmax,
+                                   int ymax) {
+	if(prepare_clip(cv, x1, y1, x2, y2, xmin, ymin, xmax, ymax)) {
+		canvas_clear(cv);
+		draw_rect(cv, xmin, ymin, xmax, ymax);
+		clipping_midpoint_subdivision_impl(cv, x1, y1, x2, y2, xmin, ymin, xmax,
 		                                   ymax);
 		show_msg("\t\t\t\t\t\t\t");
 		show_msg("Clipped!");
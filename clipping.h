@@ -1,6 +1,8 @@
 #pragma once
 
-void clipping_cohen_sutherland(int sx, int sy, int ex, int ey, int bx, int by,
-                               int tx, int ty);
-void clipping_midpoint_subdivision(int sx, int sy, int ex, int ey, int bx,
-                                   int by, int tx, int ty);
+#include "driver.h"
+
+void clipping_cohen_sutherland(Canvas *cv, int sx, int sy, int ex, int ey,
+                               int bx, int by, int tx, int ty);
+void clipping_midpoint_subdivision(Canvas *cv, int sx, int sy, int ex, int ey,
+                                   int bx, int by, int tx, int ty);
@@ -0,0 +1,16 @@
+#include "curve_drawing.h"
+#include "raster.h"
+
+// The algorithms are compiled for every sink in raster_template.h
+
+void draw_bezier_quadratic(Canvas *cv, const int *points) {
+	raster_canvas(cv, bezier_quadratic, points);
+}
+
+void draw_bezier_cubic(Canvas *cv, const int *points) {
+	raster_canvas(cv, bezier_cubic, points);
+}
+
+void draw_catmull_rom(Canvas *cv, const int *points, int count) {
+	raster_canvas(cv, catmull_rom, points, count);
+}
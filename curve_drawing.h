@@ -0,0 +1,14 @@
+#pragma once
+
+#include "driver.h"
+
+// Curves, given by their control points as x, y pairs. They are stepped by
+// adaptive forward differencing on integers, so that every pixel along the
+// curve is plotted exactly once, without any gaps.
+
+// Quadratic Bezier curve of 3 control points
+void draw_bezier_quadratic(Canvas *cv, const int *points);
+// Cubic Bezier curve of 4 control points
+void draw_bezier_cubic(Canvas *cv, const int *points);
+// Catmull-Rom spline passing through all of the points, in order
+void draw_catmull_rom(Canvas *cv, const int *points, int count);
@@ -2,7 +2,9 @@
 #include <locale.h>
 #include <math.h>
 #include <memory.h>
+#ifndef NON_CURSES
 #include <ncurses.h>
+#endif
 #ifdef NO_DRAW
 #include <termios.h>
 #endif
@@ -10,52 +12,194 @@
 #include "common.h"
 #include "display.h"
 #include "driver.h"
+#include "export.h"
+#include "glyph.h"
 #include "matrix.h"
+#include "profile.h"
+#include "term.h"
+#include "threadpool.h"
 
 #ifndef NO_DRAW
 static const char *pixel_fill = "\u25a0";
+#else
+static const char *pixel_fill = "";
+#endif
+// The canvas of init_driver or init_driver_headless
+static Canvas      screen         = {0};
+static ThreadPool *transform_pool = NULL;
+static GlyphMode   glyph_mode     = GLYPH_CELLS;
+static u8          fixed_point    = 0;
+static u8          gather         = 1;
+#if defined(NON_CURSES) && !defined(NO_DRAW)
+// The terminal of init_driver. Pixels are only drawn on its back buffer, and
+// sent to the terminal in one go whenever a frame is complete.
+static Term *term = NULL;
 #endif
-static int  pivot_x = -1, pivot_y = -1;
-static u8   *pixels       = NULL;
-static int  do_transform = 1;
 
-#define mod_y(y) (LINES - y - 1)
-#define orig_y(y) (LINES - y - 1)
-#define mod_x(x) ((x * 2) + 1)
-#define orig_x(x) ((x - 1) / 2)
-#define pxy(x, y)   (((x) * COLS) + (y))
+#define mod_y(c, y) ((c)->rows - (y)-1)
+#define orig_y(c, y) ((c)->rows - (y)-1)
+#define mod_x(x) (((x)*2) + 1)
+#define orig_x(x) (((x)-1) / 2)
+#define pxy(c, x, y) (((x) * (c)->cols) + (y))
+// The first lit cell of the row of the canvas at or after col, once the
+// occupancy is up to date
+#define next_lit(c, row, col)                                               \
+	pyramid_next_lit(&(c)->occupancy, (c)->pixels, (c)->cols, row, col)
+
+static void canvas_init(Canvas *c, int rows, int cols) {
+	c->rows             = rows;
+	c->cols             = cols;
+	c->pixels           = (u8 *)calloc((siz)rows * cols, sizeof(u8));
+	c->pivot_x          = -1;
+	c->pivot_y          = -1;
+	c->do_transform     = 1;
+	c->terminal         = 0;
+	c->keypad_init_done = 0;
+	c->pixel_count      = 0;
+	c->clip_row = c->clip_col = 0;
+	c->clip_rows = c->clip_cols = -1;
+	c->parent                   = NULL;
+	c->ids                      = NULL;
+	c->id                       = 0;
+	pyramid_init(&c->occupancy, rows, cols);
+}
+
+Canvas *canvas_new(int rows, int cols) {
+	Canvas *c = (Canvas *)malloc(sizeof(Canvas));
+	canvas_init(c, rows, cols);
+	return c;
+}
+
+void canvas_free(Canvas *c) {
+	free(c->pixels);
+	free(c->ids);
+	pyramid_free(&c->occupancy);
+	free(c);
+}
+
+Canvas *canvas_default() {
+	return &screen;
+}
+
+Canvas canvas_view(Canvas *c, int row, int col, int rows, int cols) {
+	Canvas view      = *c;
+	view.terminal    = 0;
+	view.pixel_count = 0;
+	view.clip_row    = row;
+	view.clip_col    = col;
+	view.clip_rows   = rows;
+	view.clip_cols   = cols;
+	view.parent      = c;
+	return view;
+}
+
+void canvas_enable_ids(Canvas *c, int enable) {
+	if(enable && !c->ids)
+		c->ids = (u32 *)calloc((siz)c->rows * c->cols, sizeof(u32));
+	else if(!enable) {
+		free(c->ids);
+		c->ids = NULL;
+	}
+}
+
+void canvas_set_id(Canvas *c, u32 id) {
+	c->id = id + 1;
+}
+
+u32 canvas_pick(const Canvas *c, int x, int y) {
+	int row = mod_y(c, y), col = mod_x(x);
+	if(!c->ids || row < 0 || row > c->rows - 1 || col < 0 || col > c->cols - 1)
+		return CANVAS_NO_ID;
+	return c->ids[pxy(c, row, col)] - 1;
+}
+
+void canvas_view_release(Canvas *view) {
+	__atomic_fetch_add(&view->parent->pixel_count, view->pixel_count,
+	                   __ATOMIC_RELAXED);
+	view->pixel_count = 0;
+}
+
+// Builds the occupancy pyramid again if any pixel was plotted since it was
+// last built, or if the pixels were moved without it. Every plotted pixel
+// is counted, so the pixel count of the canvas serves as the version of the
+// framebuffer, and the rasterizers do not have to touch the pyramid at all.
+static void occupancy_update(Canvas *c) {
+	if(c->occupancy.valid && c->occupancy.version == c->pixel_count)
+		return;
+	pyramid_build(&c->occupancy, c->pixels, c->rows, c->cols);
+	c->occupancy.version = c->pixel_count;
+	c->occupancy.valid   = 1;
+}
+
+void init_driver_headless(int rows, int cols) {
+	canvas_init(&screen, rows, cols);
+}
 
 void init_driver() {
 	setlocale(LC_ALL, "");
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	term = term_open();
+	int lines = term_rows(term), columns = term_cols(term);
+#else
 	initscr();
 	refresh();
+	int lines = LINES, columns = COLS;
+#endif
+	if(glyph_mode == GLYPH_CELLS)
+		canvas_init(&screen, lines, columns);
+	else
+		canvas_init(&screen, lines * glyph_height(glyph_mode),
+		            columns * 2 * glyph_width(glyph_mode));
 #else
 	pdbg("Intialized screen");
-	LINES = 200, COLS = 200;
+	canvas_init(&screen, 200, 200);
 #endif
-	pixels = (u8 *)malloc(sizeof(u8 *) * LINES * COLS);
+	screen.terminal = 1;
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	term_flush(term);
+#else
 	clear();
+#endif
 #else
 	pdbg("Cleared screen");
 #endif
 }
 
 int get_rows() {
-	return LINES;
+	return screen.rows;
 }
 
 int get_columns() {
-	return COLS;
+	return screen.cols;
+}
+
+u64 get_pixel_count() {
+	return screen.pixel_count;
 }
 
 void enable_transform(int t) {
-	do_transform = t;
+	screen.do_transform = t;
 }
 
 void draw_graph() {
+	// The coordinates of the pixels do not line up with the characters when
+	// there are several pixels per character
+	if(!screen.terminal || glyph_mode != GLYPH_CELLS)
+		return;
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	char label[16];
+	for(int i = 0; i < screen.rows - 1; i++) {
+		snprintf(label, sizeof(label), "%2d", screen.rows - (i + 1));
+		term_put(term, i, 0, label);
+	}
+	for(int j = 0; j < screen.cols - 1; j += 2) {
+		snprintf(label, sizeof(label), "%2d", j / 2);
+		term_put(term, screen.rows - 1, j, label);
+	}
+#else
 	for(int i = 0; i < LINES - 1; i++) {
 		mvprintw(i, 0, "%2d", LINES - (i + 1));
 		// for(int j = 2;j < COLS - 1;j += 2){
@@ -65,82 +209,248 @@ void draw_graph() {
 	for(int j = 0; j < COLS - 1; j += 2) {
 		mvprintw(LINES - 1, j, "%2d", j / 2);
 	}
+#endif
 #else
 	pdbg("Graph drawn");
 #endif
 }
 
-void set_pixel(int x, int y, const char *fill) {
-	if(mod_x(x) > COLS - 1 || mod_y(y) < 0)
+// Plots a pixel of a view. Other threads may be plotting on the rest of the
+// canvas at the same time, so only the cells inside the rectangle of the
+// view are touched, and the screen is left to be updated by the next
+// redraw.
+static void set_pixel_clipped(Canvas *c, int row, int col) {
+	if(row < c->clip_row || row >= c->clip_row + c->clip_rows ||
+	   col < c->clip_col || col >= c->clip_col + c->clip_cols ||
+	   row > c->rows - 1 || col > c->cols - 1)
+		return;
+	c->pixel_count++;
+	prof_count(PROF_PUT_PIXEL);
+	c->pixels[pxy(c, row, col)] = 1;
+	if(c->ids)
+		c->ids[pxy(c, row, col)] = c->id;
+}
+
+void canvas_set_pixel(Canvas *c, int x, int y, const char *fill) {
+	if(c->clip_rows >= 0) {
+		set_pixel_clipped(c, mod_y(c, y), mod_x(x));
+		return;
+	}
+	c->pixel_count++;
+	prof_count(PROF_PUT_PIXEL);
+	if(mod_x(x) > c->cols - 1 || mod_x(x) < 0 || mod_y(c, y) < 0 ||
+	   mod_y(c, y) > c->rows - 1) {
+		prof_count(PROF_REJECTED);
+		return;
+	}
+	c->pixels[pxy(c, mod_y(c, y), mod_x(x))] = 1;
+	if(c->ids)
+		c->ids[pxy(c, mod_y(c, y), mod_x(x))] = c->id;
+	if(!c->terminal)
 		return;
-	pixels[pxy(mod_y(y),mod_x(x))] = 1;
 #ifndef NO_DRAW
-	mvaddstr(mod_y(y), mod_x(x), fill);
+	int row = mod_y(c, y), col = mod_x(x);
+	if(glyph_mode != GLYPH_CELLS) {
+		// The whole character the pixel is a part of is drawn again
+		row /= glyph_height(glyph_mode);
+		col = col / 2 / glyph_width(glyph_mode);
+		fill = glyph_at(c, glyph_mode, row, col);
+	}
+#ifdef NON_CURSES
+	// Sent along with the rest of the frame
+	term_put(term, row, col, fill);
+#else
+	mvaddstr(row, col, fill);
 	refresh();
+	prof_count(PROF_REFRESH);
+#endif
 #else
-	pdbg("Pixel drawn : (%d, %d) as (%d, %d)", x, y, mod_x(x), mod_y(y));
+	(void)fill;
+	pdbg("Pixel drawn : (%d, %d) as (%d, %d)", x, y, mod_x(x), mod_y(c, y));
 #endif
 }
 
-void put_pixel(int x, int y) {
+void canvas_erase_pixel(Canvas *c, int x, int y) {
+	int row = mod_y(c, y), col = mod_x(x);
+	if(col > c->cols - 1 || col < 0 || row < 0 || row > c->rows - 1)
+		return;
+	c->pixels[pxy(c, row, col)] = 0;
+	if(c->ids)
+		c->ids[pxy(c, row, col)] = 0;
+	c->occupancy.valid = 0;
+	if(!c->terminal)
+		return;
 #ifndef NO_DRAW
-	set_pixel(x, y, pixel_fill);
+	const char *fill = " ";
+	if(glyph_mode != GLYPH_CELLS) {
+		row /= glyph_height(glyph_mode);
+		col  = col / 2 / glyph_width(glyph_mode);
+		fill = glyph_at(c, glyph_mode, row, col);
+	}
+#ifdef NON_CURSES
+	term_put(term, row, col, fill);
 #else
-	set_pixel(x, y, "");
+	mvaddstr(row, col, fill);
+	refresh();
+	prof_count(PROF_REFRESH);
+#endif
+#else
+	pdbg("Pixel erased : (%d, %d) as (%d, %d)", x, y, col, row);
 #endif
 }
 
+void canvas_put_pixel(Canvas *c, int x, int y) {
+	canvas_set_pixel(c, x, y, pixel_fill);
+}
+
+void set_pixel(int x, int y, const char *fill) {
+	canvas_set_pixel(&screen, x, y, fill);
+}
+
+void put_pixel(int x, int y) {
+	canvas_set_pixel(&screen, x, y, pixel_fill);
+}
+
+void canvas_set_pivot(Canvas *c, int x, int y) {
+	c->pivot_x = mod_x(x);
+	c->pivot_y = mod_y(c, y);
+}
+
 void set_pivot(int x, int y) {
-	pivot_x = mod_x(x);
-	pivot_y = mod_y(y);
+	canvas_set_pivot(&screen, x, y);
+}
+
+const u8 *get_framebuffer() {
+	return screen.pixels;
+}
+
+#ifndef NO_DRAW
+// Draws the framebuffer on the terminal with several pixels per character,
+// after packing it one bit per pixel
+static void redraw_glyphs(Canvas *c) {
+	int   width  = c->cols / 2;
+	siz   stride = (width + 7) / 8;
+	u8 *  bits   = (u8 *)malloc(stride * c->rows);
+	char *line   = (char *)malloc(GLYPH_MAX_BYTES * ((width + 1) / 2) + 1);
+	export_encode(c, EXPORT_PBM, bits);
+	int h = glyph_height(glyph_mode);
+	for(int r = 0; r * h < c->rows; r++) {
+		glyph_encode_row(bits, stride, width, c->rows, r, glyph_mode, line);
+#ifdef NON_CURSES
+		term_put(term, r, 0, line);
+#else
+		mvaddstr(r, 0, line);
+#endif
+	}
+	free(line);
+	free(bits);
 }
+#endif
 
-static void redraw() {
+void canvas_redraw(Canvas *c) {
+	if(!c->terminal)
+		return;
+	prof_count(PROF_REDRAW);
+	prof_start(PROF_TIME_REDRAW);
 #ifndef NO_DRAW
+	occupancy_update(c);
+#ifdef NON_CURSES
+	// Only the cells which differ from the last frame are sent
+	term_clear(term);
+	if(glyph_mode != GLYPH_CELLS)
+		redraw_glyphs(c);
+	else {
+		for(int i = 0; i < c->rows; i++) {
+			for(int j = next_lit(c, i, 0); j < c->cols;
+			    j = next_lit(c, i, j + 1))
+				term_put(term, i, j, pixel_fill);
+		}
+	}
+	term_flush(term);
+#else
 	clear();
-	for(int i = 0; i < LINES; i++) {
-		for(int j = 0; j < COLS; j++) {
-			if(pixels[pxy(i, j)])
+	if(glyph_mode != GLYPH_CELLS)
+		redraw_glyphs(c);
+	else {
+		for(int i = 0; i < c->rows; i++) {
+			for(int j = next_lit(c, i, 0); j < c->cols;
+			    j = next_lit(c, i, j + 1))
 				mvaddstr(i, j, pixel_fill);
 		}
 	}
 	refresh();
+#endif
+	prof_count(PROF_REFRESH);
 #else
 	pdbg("Screen redrawn");
 #endif
+	prof_stop(PROF_TIME_REDRAW);
 }
 
-void screen_clear() {
+void screen_redraw() {
+	canvas_redraw(&screen);
+}
+
+void canvas_clear(Canvas *c) {
+	prof_count(PROF_CLEAR);
+	prof_start(PROF_TIME_CLEAR);
+	memset(c->pixels, 0, (siz)c->rows * c->cols);
+	if(c->ids)
+		memset(c->ids, 0, sizeof(u32) * c->rows * c->cols);
+	pyramid_clear(&c->occupancy);
+	c->occupancy.version = c->pixel_count;
+	c->occupancy.valid   = 1;
+	if(!c->terminal) {
+		prof_stop(PROF_TIME_CLEAR);
+		return;
+	}
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	term_clear(term);
+	term_flush(term);
+#else
 	clear();
-	for(int i = 0; i < LINES; i++) {
-		for(int j = 0; j < COLS; j++) pixels[pxy(i, j)] = 0;
-	}
 	refresh();
+#endif
+	prof_count(PROF_REFRESH);
 #else
 	pdbg("Screen cleared");
 #endif
+	prof_stop(PROF_TIME_CLEAR);
 }
 
-static void transform_mat(Matrix m, u8 use_pivot) {
-#ifdef NO_DRAW
-	pdbg("Transformation matrix : ");
-	mat_print(m);
-#endif
-	u8 new_pixels[LINES * COLS];
-	for(int i = 0; i < LINES; i++) {
-		for(int j = 0; j < COLS; j++) new_pixels[pxy(i, j)] = 0;
-	}
+void screen_clear() {
+	canvas_clear(&screen);
+}
+
+// The empty ID buffer of the transformed framebuffer, if the canvas has one
+static u32 *ids_new(const Canvas *c) {
+	if(!c->ids)
+		return NULL;
+	return (u32 *)calloc((siz)c->rows * c->cols, sizeof(u32));
+}
+
+static void ids_replace(Canvas *c, u32 *ids) {
+	if(!ids)
+		return;
+	free(c->ids);
+	c->ids = ids;
+}
+
+// Transforms the lit pixels one after another using the matrix library
+static void transform_mat_serial(Canvas *c, Matrix m, u8 use_pivot) {
+	u8 *   new_pixels = (u8 *)calloc((siz)c->rows * c->cols, sizeof(u8));
+	u32 *  new_ids    = ids_new(c);
 	Matrix point = mat_new(3, 1);
 	Matrix pivot = mat_new(3, 1);
-	mat_fill(pivot, pivot_x * 1.0, pivot_y * 1.0, 0.0);
+	mat_fill(pivot, c->pivot_x * 1.0, c->pivot_y * 1.0, 0.0);
 #ifdef NO_DRAW
 	pdbg("Pivot (F) : ");
 	mat_print(pivot);
 #endif
-	for(int i = 0; i < LINES; i++) {
-		for(int j = 0; j < COLS; j++) {
-			if(pixels[pxy(i, j)]) {
+	for(int i = 0; i < c->rows; i++) {
+		for(int j = 0; j < c->cols; j++) {
+			if(c->pixels[pxy(c, i, j)]) {
 				mat_fill(point, j * 1.0, i * 1.0, 1.0);
 #ifdef NO_DRAW
 				pdbg("Point (P) : ");
@@ -167,8 +477,8 @@ static void transform_mat(Matrix m, u8 use_pivot) {
 					mat_free(res1);
 				} else {
 					Matrix newpivot = mat_mult(m, pivot);
-					pivot_y         = mat_get(newpivot, 1, 0);
-					pivot_x         = mat_get(newpivot, 0, 0);
+					c->pivot_y      = mat_get(newpivot, 1, 0);
+					c->pivot_x      = mat_get(newpivot, 0, 0);
 #ifdef NO_DRAW
 					pdbg("Transformed pivot (F) : ");
 					mat_print(newpivot);
@@ -185,20 +495,346 @@ static void transform_mat(Matrix m, u8 use_pivot) {
 #ifdef NO_DRAW
 				pdbg("(px, py) : (%d, %d)", px, py);
 #endif
-				if((py < LINES - 1 && py > 0) && (px < COLS - 1 && px > 0))
-					new_pixels[pxy(py, px)] = 1;
+				if((py < c->rows - 1 && py > 0) &&
+				   (px < c->cols - 1 && px > 0)) {
+					new_pixels[pxy(c, py, px)] = 1;
+					if(new_ids)
+						new_ids[pxy(c, py, px)] = c->ids[pxy(c, i, j)];
+				}
 				mat_free(np);
 			}
 		}
 	}
 	mat_free(point);
 	mat_free(pivot);
-	for(int i = 0; i < LINES; i++) {
-		for(int j = 0; j < COLS; j++) {
-			pixels[pxy(i, j)] = new_pixels[pxy(i, j)];
+	memcpy(c->pixels, new_pixels, (siz)c->rows * c->cols);
+	free(new_pixels);
+	ids_replace(c, new_ids);
+	c->occupancy.valid = 0;
+}
+
+// Rows of the framebuffer processed by a single parallel job
+#define TRANSFORM_CHUNK_ROWS 8
+// Fractional bits of the coefficients of the fixed point path, Q16.16
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+typedef struct {
+	Canvas *c;
+	double  m[3][3];
+	i64     q[2][3]; // The first two rows of m in fixed point
+	double fx, fy;
+	u8     use_pivot;
+	u8     any_lit;
+	u8     shared; // Whether the chunks are processed by several threads
+	u64 *  bits;   // Occupancy of the transformed framebuffer
+	u32 *  ids;    // ID buffer of the transformed framebuffer, if any
+} TransformJob;
+
+// Marks the new position of the cell from, and moves its ID along. Which
+// of the IDs moved to the same cell from different threads is kept is
+// unspecified.
+static inline void mark_bit(TransformJob *t, siz bit, siz from) {
+	if(t->shared)
+		__atomic_fetch_or(&t->bits[bit >> 6], 1ull << (bit & 63),
+		                  __ATOMIC_RELAXED);
+	else
+		t->bits[bit >> 6] |= 1ull << (bit & 63);
+	if(t->ids)
+		__atomic_store_n(&t->ids[bit], t->c->ids[from], __ATOMIC_RELAXED);
+}
+
+// The cell the matrix moves the cell at row i and column j to. The
+// arithmetic follows the matrix library step by step, so that the results
+// are bit for bit identical to the serial path.
+static inline void transform_cell(const TransformJob *t, int i, int j,
+                                  int *px, int *py) {
+	double v[3] = {j * 1.0, i * 1.0, 1.0};
+	if(t->use_pivot) {
+		v[0] = v[0] - t->fx;
+		v[1] = v[1] - t->fy;
+		v[2] = v[2] - 0.0;
+	}
+	double r[2];
+	for(int k = 0; k < 2; k++) {
+		double sum = 0;
+		for(int l = 0; l < 3; l++) sum += t->m[k][l] * v[l];
+		r[k] = sum;
+	}
+	if(t->use_pivot) {
+		r[0] = r[0] + t->fx;
+		r[1] = r[1] + t->fy;
+	}
+	*px = (int)(floor(r[0]));
+	*py = (int)(floor(r[1]));
+}
+
+// Transforms the lit pixels of a chunk of rows, and marks their new
+// positions in the shared bitset
+static void transform_chunk(int chunk, int worker, void *arg) {
+	(void)worker;
+	TransformJob *t    = (TransformJob *)arg;
+	Canvas *      c    = t->c;
+	int           from = chunk * TRANSFORM_CHUNK_ROWS;
+	int           to   = from + TRANSFORM_CHUNK_ROWS;
+	if(to > c->rows)
+		to = c->rows;
+	for(int i = from; i < to; i++) {
+		for(int j = 0; j < c->cols; j++) {
+			if(!c->pixels[pxy(c, i, j)])
+				continue;
+			__atomic_store_n(&t->any_lit, 1, __ATOMIC_RELAXED);
+			int px, py;
+			transform_cell(t, i, j, &px, &py);
+			if((py < c->rows - 1 && py > 0) && (px < c->cols - 1 && px > 0))
+				mark_bit(t, pxy(c, py, px), pxy(c, i, j));
+		}
+	}
+}
+
+// The position the fixed point matrix moves the cell at row i and column j
+// to, before it is floored back to a cell
+#define fixed_x(t, fx, fy, i, j)                                            \
+	((t)->q[0][0] * ((j) - (fx)) + (t)->q[0][1] * ((i) - (fy)) + (t)->q[0][2])
+#define fixed_y(t, fx, fy, i, j)                                            \
+	((t)->q[1][0] * ((j) - (fx)) + (t)->q[1][1] * ((i) - (fy)) + (t)->q[1][2])
+
+// Transforms the lit pixels of a chunk of rows using integer arithmetic on
+// the fixed point matrix. Along a row, the transformed position advances by
+// the first column of the matrix for every cell, so it is stepped with two
+// additions, and the arithmetic shift floors it back to a cell. The
+// coefficients of an integer translation are whole numbers, so it is exact.
+static void transform_chunk_fixed(int chunk, int worker, void *arg) {
+	(void)worker;
+	TransformJob *t    = (TransformJob *)arg;
+	Canvas *      c    = t->c;
+	int           from = chunk * TRANSFORM_CHUNK_ROWS;
+	int           to   = from + TRANSFORM_CHUNK_ROWS;
+	if(to > c->rows)
+		to = c->rows;
+	i64 fx = t->use_pivot ? (i64)t->fx : 0, fy = t->use_pivot ? (i64)t->fy : 0;
+	i64 dx = t->q[0][0], dy = t->q[1][0];
+	for(int i = from; i < to; i++) {
+		const u8 *row = &c->pixels[pxy(c, i, 0)];
+		// The position of the first cell of the row
+		i64 x = fixed_x(t, fx, fy, i, 0), y = fixed_y(t, fx, fy, i, 0);
+		for(int j = 0; j < c->cols; j++, x += dx, y += dy) {
+			if(!row[j])
+				continue;
+			__atomic_store_n(&t->any_lit, 1, __ATOMIC_RELAXED);
+			i64 px = (x >> FIXED_SHIFT) + fx, py = (y >> FIXED_SHIFT) + fy;
+			if((py < c->rows - 1 && py > 0) && (px < c->cols - 1 && px > 0))
+				mark_bit(t, pxy(c, py, px), pxy(c, i, j));
+		}
+	}
+}
+
+// Expands the bitset back to the framebuffer
+static void transform_unpack(int chunk, int worker, void *arg) {
+	(void)worker;
+	TransformJob *t    = (TransformJob *)arg;
+	Canvas *      c    = t->c;
+	siz           from = (siz)chunk * TRANSFORM_CHUNK_ROWS * c->cols;
+	siz           to   = from + (siz)TRANSFORM_CHUNK_ROWS * c->cols;
+	if(to > (siz)c->rows * c->cols)
+		to = (siz)c->rows * c->cols;
+	for(siz i = from; i < to; i++)
+		c->pixels[i] = (t->bits[i >> 6] >> (i & 63)) & 1;
+}
+
+// Runs the chunks on the pool, or one after another if there is none
+static void run_chunks(ThreadPool *pool, int count,
+                       void (*fn)(int index, int worker, void *arg),
+                       void *arg) {
+	if(pool)
+		pool_run(pool, count, fn, arg);
+	else
+		for(int i = 0; i < count; i++) fn(i, 0, arg);
+}
+
+// Scales the pixels about the pivot by gathering, see set_transform_gather.
+// Without a rotation or a translation in the matrix, the new column of a
+// cell only depends on its old column, and the new row on its old row, so
+// either is looked up from a table. Both are non decreasing, as the factors
+// are positive, so the old cells of a row moved onto the same new cell are
+// adjacent, and only the first lit one of them has to be moved.
+typedef struct {
+	Canvas *c;
+	u8 *    pixels;        // The new framebuffer
+	u32 *   ids;           // ID buffer of the new framebuffer, if any
+	Pyramid occupancy;     // Of the new framebuffer
+	int *   map_x, *map_y; // New column of every old column, row of every row
+	int *   skip;  // First old column moved past the new column of each
+	int *   first; // First old row moved to each new row or below it
+} GatherJob;
+
+// Gathers a chunk of new rows, from the old rows moved onto them
+static void transform_gather_chunk(int chunk, int worker, void *arg) {
+	(void)worker;
+	GatherJob *g    = (GatherJob *)arg;
+	Canvas *   c    = g->c;
+	int        from = chunk * TRANSFORM_CHUNK_ROWS;
+	int        to   = from + TRANSFORM_CHUNK_ROWS;
+	if(to > c->rows)
+		to = c->rows;
+	for(int i = g->first[from]; i < g->first[to]; i++) {
+		int py = g->map_y[i];
+		if(py >= c->rows - 1 || py <= 0)
+			continue;
+		for(int j = next_lit(c, i, 0); j < c->cols;
+		    j = next_lit(c, i, g->skip[j])) {
+			int px = g->map_x[j];
+			if(px >= c->cols - 1 || px <= 0)
+				continue;
+			g->pixels[pxy(c, py, px)] = 1;
+			if(g->ids)
+				g->ids[pxy(c, py, px)] = c->ids[pxy(c, i, j)];
+			pyramid_mark(&g->occupancy, py, px);
+		}
+	}
+}
+
+// The tables are filled with the arithmetic of the path which is replaced,
+// the terms of the other coordinate being exactly zero
+static void transform_gather(Canvas *c, const TransformJob *t,
+                             ThreadPool *pool, u8 fixed) {
+	GatherJob g;
+	g.c      = c;
+	g.pixels = (u8 *)calloc((siz)c->rows * c->cols, sizeof(u8));
+	g.ids    = ids_new(c);
+	g.map_x  = (int *)malloc(sizeof(int) * c->cols);
+	g.skip   = (int *)malloc(sizeof(int) * c->cols);
+	g.map_y  = (int *)malloc(sizeof(int) * c->rows);
+	g.first  = (int *)malloc(sizeof(int) * (c->rows + 1));
+	pyramid_init(&g.occupancy, c->rows, c->cols);
+	i64 fx = (i64)t->fx, fy = (i64)t->fy;
+	int unused;
+	for(int j = 0; j < c->cols; j++) {
+		if(fixed)
+			g.map_x[j] = (fixed_x(t, fx, fy, fy, j) >> FIXED_SHIFT) + fx;
+		else
+			transform_cell(t, fy, j, &g.map_x[j], &unused);
+	}
+	for(int i = 0; i < c->rows; i++) {
+		if(fixed)
+			g.map_y[i] = (fixed_y(t, fx, fy, i, fx) >> FIXED_SHIFT) + fy;
+		else
+			transform_cell(t, i, fx, &unused, &g.map_y[i]);
+	}
+	for(int j = c->cols - 1; j >= 0; j--) {
+		int same  = j + 1 < c->cols && g.map_x[j + 1] == g.map_x[j];
+		g.skip[j] = same ? g.skip[j + 1] : j + 1;
+	}
+	for(int r = 0, i = 0; r <= c->rows; r++) {
+		while(i < c->rows && g.map_y[i] < r) i++;
+		g.first[r] = i;
+	}
+	int chunks = (c->rows + TRANSFORM_CHUNK_ROWS - 1) / TRANSFORM_CHUNK_ROWS;
+	run_chunks(pool, chunks, transform_gather_chunk, &g);
+	memcpy(c->pixels, g.pixels, (siz)c->rows * c->cols);
+	ids_replace(c, g.ids);
+	pyramid_free(&c->occupancy);
+	c->occupancy         = g.occupancy;
+	c->occupancy.version = c->pixel_count;
+	free(g.pixels);
+	free(g.map_x);
+	free(g.skip);
+	free(g.map_y);
+	free(g.first);
+}
+
+// Whether the matrix only scales about the origin, by positive factors
+static int mat_is_scale(Matrix m) {
+	return mat_get(m, 0, 1) == 0 && mat_get(m, 1, 0) == 0 &&
+	       mat_get(m, 0, 2) == 0 && mat_get(m, 1, 2) == 0 &&
+	       mat_get(m, 0, 0) > 0 && mat_get(m, 1, 1) > 0;
+}
+
+// Transforms the lit pixels on all the threads of the pool, or on the
+// calling thread if there is none. The framebuffer is partitioned by rows,
+// and the new occupancy is merged in a bitset using atomic OR, so no locks
+// are involved.
+static void transform_mat_bits(Canvas *c, Matrix m, u8 use_pivot,
+                               ThreadPool *pool, u8 fixed, u8 scale) {
+	TransformJob t;
+	t.c = c;
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++) t.m[i][j] = mat_get(m, i, j);
+	for(int i = 0; i < 2; i++)
+		for(int j = 0; j < 3; j++) t.q[i][j] = llround(t.m[i][j] * FIXED_ONE);
+	t.fx        = c->pivot_x * 1.0;
+	t.fy        = c->pivot_y * 1.0;
+	t.use_pivot = use_pivot;
+	t.any_lit   = 0;
+	t.shared    = pool != NULL;
+	if(scale) {
+		occupancy_update(c);
+		transform_gather(c, &t, pool, fixed);
+		return;
+	}
+	t.bits = (u64 *)calloc(((siz)c->rows * c->cols + 63) / 64, sizeof(u64));
+	t.ids  = ids_new(c);
+	int chunks = (c->rows + TRANSFORM_CHUNK_ROWS - 1) / TRANSFORM_CHUNK_ROWS;
+	run_chunks(pool, chunks, fixed ? transform_chunk_fixed : transform_chunk,
+	           &t);
+	run_chunks(pool, chunks, transform_unpack, &t);
+	free(t.bits);
+	ids_replace(c, t.ids);
+	c->occupancy.valid = 0;
+	// The serial path transforms the pivot, which has no homogeneous
+	// component, for each lit pixel. The conversion to int truncates.
+	if(!use_pivot && t.any_lit && fixed) {
+		i64 fx = c->pivot_x, fy = c->pivot_y;
+		c->pivot_x = (t.q[0][0] * fx + t.q[0][1] * fy) / FIXED_ONE;
+		c->pivot_y = (t.q[1][0] * fx + t.q[1][1] * fy) / FIXED_ONE;
+	} else if(!use_pivot && t.any_lit) {
+		double x = 0, y = 0;
+		for(int l = 0; l < 2; l++) {
+			x += t.m[0][l] * (l ? t.fy : t.fx);
+			y += t.m[1][l] * (l ? t.fy : t.fx);
 		}
+		c->pivot_x = x + t.m[0][2] * 0.0;
+		c->pivot_y = y + t.m[1][2] * 0.0;
 	}
-	redraw();
+}
+
+static void transform_mat(Canvas *c, Matrix m, u8 use_pivot,
+                          ThreadPool *pool) {
+	prof_count(PROF_TRANSFORM);
+	prof_start(PROF_TIME_TRANSFORM);
+#ifdef NO_DRAW
+	pdbg("Transformation matrix : ");
+	mat_print(m);
+#endif
+	u8 scale = gather && use_pivot && mat_is_scale(m);
+	if(pool || fixed_point || scale)
+		transform_mat_bits(c, m, use_pivot, pool, fixed_point, scale);
+	else
+		transform_mat_serial(c, m, use_pivot);
+	canvas_redraw(c);
+	prof_stop(PROF_TIME_TRANSFORM);
+}
+
+void set_transform_threads(int threads) {
+	if(transform_pool)
+		pool_free(transform_pool);
+	transform_pool = threads == 1 ? NULL : pool_new(threads);
+}
+
+ThreadPool *get_transform_pool() {
+	return transform_pool;
+}
+
+void set_glyph_mode(GlyphMode mode) {
+	glyph_mode = mode;
+}
+
+void set_transform_fixed(int fixed) {
+	fixed_point = fixed;
+}
+
+void set_transform_gather(int g) {
+	gather = g;
 }
 
 static void make_mat_trans(Matrix mat, double tx, double ty) {
@@ -209,30 +845,77 @@ static void make_mat_scale(Matrix mat, double sx, double sy) {
 	mat_fill(mat, sx, 0.0, 0.0, 0.0, sy, 0.0, 0.0, 0.0, 1.0);
 }
 
-#ifdef ENABLE_ROTATION
 static void make_mat_rot(Matrix mat, double deg) {
 	deg = (M_PI / 180) * deg;
 	mat_fill(mat, cos(deg), -sin(deg), 0.0, sin(deg), cos(deg), 0.0, 0.0, 0.0,
 	         1.0);
 }
-#endif
+
+void canvas_transform(Canvas *c, TransformOp op, ThreadPool *pool) {
+	Matrix tm = mat_new(3, 3);
+	switch(op) {
+		case TRANSFORM_LEFT:
+			make_mat_trans(tm, -1, 0);
+			transform_mat(c, tm, 0, pool);
+			break;
+		case TRANSFORM_RIGHT:
+			make_mat_trans(tm, 1, 0);
+			transform_mat(c, tm, 0, pool);
+			break;
+		case TRANSFORM_UP:
+			make_mat_trans(tm, 0, -1);
+			transform_mat(c, tm, 0, pool);
+			break;
+		case TRANSFORM_DOWN:
+			make_mat_trans(tm, 0, 1);
+			transform_mat(c, tm, 0, pool);
+			break;
+		case TRANSFORM_ZOOM_IN:
+			make_mat_scale(tm, 1.5, 1.5);
+			transform_mat(c, tm, 1, pool);
+			break;
+		case TRANSFORM_ZOOM_OUT:
+			make_mat_scale(tm, .67, .67);
+			transform_mat(c, tm, 1, pool);
+			break;
+		case TRANSFORM_ROTATE_ACW:
+			make_mat_rot(tm, 1.0);
+			transform_mat(c, tm, 1, pool);
+			break;
+		case TRANSFORM_ROTATE_CW:
+			make_mat_rot(tm, -1.0);
+			transform_mat(c, tm, 1, pool);
+			break;
+	}
+	mat_free(tm);
+}
+
+void apply_transform(TransformOp op) {
+	canvas_transform(&screen, op, transform_pool);
+}
 
 void show_msg(const char *msg) {
+	if(!screen.terminal)
+		return;
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	term_put(term, 0, 0, msg);
+#else
 	mvaddstr(0, 0, msg);
+#endif
 #else
 	pinfo("%s", msg);
 #endif
 }
 
-static u8 keypad_init_done = 0;
-
 static void keypad_init() {
-	if(keypad_init_done)
+	if(screen.keypad_init_done)
 		return;
 #ifndef NO_DRAW
+#ifndef NON_CURSES
 	keypad(stdscr, TRUE);
 	noecho();
+#endif
 #else
 	struct termios t;
 	tcgetattr(0, &t);
@@ -240,7 +923,7 @@ static void keypad_init() {
 	tcsetattr(0, TCSANOW, &t);
 	pdbg("Intialized keypad and set noecho");
 #endif
-	keypad_init_done = 1;
+	screen.keypad_init_done = 1;
 }
 
 static void keypad_restore() {
@@ -250,17 +933,32 @@ static void keypad_restore() {
 	t.c_lflag &= ECHO | ICANON;
 	tcsetattr(0, TCSANOW, &t);
 	pdbg("Keypad state restored!");
-#else
+#elif !defined(NON_CURSES)
 	keypad(stdscr, FALSE);
 	echo();
 #endif
-	keypad_init_done = 0;
+	screen.keypad_init_done = 0;
 }
 
+#if defined(NON_CURSES) && !defined(NO_DRAW)
+// Like the getch of ncurses, sends the pending changes before waiting
+static int term_getch() {
+	term_flush(term);
+	int c = term_read_key();
+	// The input is gone, so there is nothing left to wait for
+	return c < 0 ? 'q' : c;
+}
+#endif
+
 int wait_for_input() {
+	// There is nobody to wait for
+	if(!screen.terminal)
+		return 0;
 	keypad_init();
 #ifdef NO_DRAW
 	return getchar();
+#elif defined(NON_CURSES)
+	return term_getch();
 #else
 	return getch();
 #endif
@@ -268,7 +966,13 @@ int wait_for_input() {
 
 void transform() {
 	keypad_init();
-#ifndef NO_DRAW
+#if !defined(NO_DRAW) && defined(NON_CURSES)
+#define KB_UP TERM_KEY_UP
+#define KB_DOWN TERM_KEY_DOWN
+#define KB_RIGHT TERM_KEY_RIGHT
+#define KB_LEFT TERM_KEY_LEFT
+#define getch term_getch
+#elif !defined(NO_DRAW)
 #define KB_UP KEY_UP
 #define KB_DOWN KEY_DOWN
 #define KB_RIGHT KEY_RIGHT
@@ -283,10 +987,9 @@ void transform() {
 #define getch getchar
 	u8 esceen = 0;
 #endif
-	int    c;
-	Matrix tm = mat_new(3, 3);
+	int c;
 	while((c = getch()) != 'q' && c != 'Q') {
-		if(!do_transform) {
+		if(!screen.do_transform) {
 #ifdef NO_DRAW
 			pdbg("Transformation disabled!");
 #endif
@@ -306,74 +1009,91 @@ void transform() {
 #ifdef NO_DRAW
 #ifdef ENABLE_ROTATION
 				if(!esceen) { // 'A' and left has same key codes
-					make_mat_rot(tm, 1.0);
-					transform_mat(tm, 1);
+					apply_transform(TRANSFORM_ROTATE_ACW);
 					show_msg("rotate 1deg anticlockwise");
 					break;
 				}
 #endif
 #endif
-				make_mat_trans(tm, -1, 0);
-				transform_mat(tm, 0);
+				apply_transform(TRANSFORM_LEFT);
 				show_msg("move left");
 #ifdef NO_DRAW
 				esceen = 0;
 #endif
 				break;
 			case KB_RIGHT:
-				make_mat_trans(tm, 1, 0);
-				transform_mat(tm, 0);
+				apply_transform(TRANSFORM_RIGHT);
 				show_msg("move right");
 				break;
 			case KB_UP:
-				make_mat_trans(tm, 0, -1);
-				transform_mat(tm, 0);
+				apply_transform(TRANSFORM_UP);
 				show_msg("move up");
 				break;
 			case KB_DOWN:
-				make_mat_trans(tm, 0, 1);
-				transform_mat(tm, 0);
+				apply_transform(TRANSFORM_DOWN);
 				show_msg("move down");
 				break;
 			case 'z':
 			case 'Z':
-				make_mat_scale(tm, 1.5, 1.5);
-				transform_mat(tm, 1);
+				apply_transform(TRANSFORM_ZOOM_IN);
 				show_msg("zoom in");
 				break;
 			case 'x':
 			case 'X':
-				make_mat_scale(tm, .67, .67);
-				transform_mat(tm, 1);
+				apply_transform(TRANSFORM_ZOOM_OUT);
 				show_msg("zoom out");
 				break;
+			case 'p':
+			case 'P':
+				if(profile_enabled) {
+					char buf[1024];
+					profile_format(buf, sizeof(buf));
+					show_msg(buf);
+				} else
+					show_msg("profiling is disabled");
+				break;
 #ifdef ENABLE_ROTATION
 			case 'a':
 #ifndef NO_DRAW
 			case 'A':
 #endif
-				make_mat_rot(tm, 1.0);
-				transform_mat(tm, 1);
+				apply_transform(TRANSFORM_ROTATE_ACW);
 				show_msg("rotate 1deg anticlockwise");
 				break;
 			case 's':
 			case 'S':
-				make_mat_rot(tm, -1.0);
-				transform_mat(tm, 1);
+				apply_transform(TRANSFORM_ROTATE_CW);
 				show_msg("rotate 1deg clockwise");
 				break;
 #endif
 		}
 	}
 	keypad_restore();
-	mat_free(tm);
 }
 
 void terminate_driver() {
-	free(pixels);
+	free(screen.pixels);
+	free(screen.ids);
+	screen.pixels = NULL;
+	screen.ids    = NULL;
+	pyramid_free(&screen.occupancy);
+	if(transform_pool) {
+		pool_free(transform_pool);
+		transform_pool = NULL;
+	}
+	if(!screen.terminal) {
+		profile_dump();
+		return;
+	}
 #ifndef NO_DRAW
+#ifdef NON_CURSES
+	term_close(term);
+	term = NULL;
+#else
 	endwin();
+#endif
 #else
 	pdbg("Window terminated!\n");
 #endif
+	profile_dump();
 }
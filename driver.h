@@ -1,5 +1,96 @@
 #pragma once
 
+#include "common.h"
+#include "pyramid.h"
+#include "threadpool.h"
+
+// A framebuffer to draw on, with everything the driver needs to transform
+// it. Any number of canvases can coexist, and different canvases can be
+// drawn on from different threads at the same time. Only the canvas of
+// init_driver is displayed on the terminal.
+typedef struct Canvas {
+	int  rows, cols; // Size in terminal cells
+	u8 * pixels;     // One byte per cell, row major from the top left corner
+	int  pivot_x, pivot_y; // Pivot for transformations, in cells
+	u8   do_transform;
+	u8   terminal;         // Displayed on the terminal
+	u8   keypad_init_done; // Terminal canvas only
+	// Pixels plotted, including the ones outside of it, except for the rows
+	// of a stroke above or below it, see raster_stroke
+	u64 pixel_count;
+	// Rectangle of cells a view is restricted to, a negative number of rows
+	// if it is not a view
+	int            clip_row, clip_col, clip_rows, clip_cols;
+	struct Canvas *parent; // Canvas a view is plotting on
+	Pyramid        occupancy; // Of the framebuffer, shared with the views
+	// ID of the primitive which last lit every cell plus one, 0 for none,
+	// or NULL without an ID buffer, see canvas_enable_ids
+	u32 *ids;
+	u32  id; // Written to the ID buffer with every pixel, plus one
+} Canvas;
+
+// Returned by canvas_pick for a cell no primitive was drawn on
+#define CANVAS_NO_ID u32_MAX
+
+typedef enum {
+	TRANSFORM_LEFT = 1,
+	TRANSFORM_RIGHT,
+	TRANSFORM_UP,
+	TRANSFORM_DOWN,
+	TRANSFORM_ZOOM_IN,
+	TRANSFORM_ZOOM_OUT,
+	TRANSFORM_ROTATE_ACW, // 1 degree anticlockwise
+	TRANSFORM_ROTATE_CW   // 1 degree clockwise
+} TransformOp;
+
+// How the logical pixels of the terminal are drawn, see glyph.h
+typedef enum {
+	GLYPH_CELLS    = 0, // One logical pixel per two columns, the default
+	GLYPH_QUADRANT = 1, // 2x2 logical pixels per column
+	GLYPH_BRAILLE  = 2  // 2x4 logical pixels per column
+} GlyphMode;
+
+// Create a canvas of the given rows and columns, which is not displayed
+Canvas *canvas_new(int rows, int cols);
+// Release a canvas created with canvas_new
+void canvas_free(Canvas *c);
+// Get the canvas the driver functions below operate on, which is the one
+// created by init_driver or init_driver_headless
+Canvas *canvas_default();
+// Create a view of a rectangle of cells of the canvas. The pixels plotted on
+// the view outside of the rectangle are discarded, and the ones inside are
+// not displayed until the next canvas_redraw. Multiple threads can plot
+// concurrently on views of disjoint rectangles of the same canvas.
+Canvas canvas_view(Canvas *c, int row, int col, int rows, int cols);
+// Add the pixels counted by the view to its canvas
+void canvas_view_release(Canvas *view);
+void canvas_put_pixel(Canvas *c, int x, int y);
+// Unlight a pixel, and its cell of the ID buffer. The pixel is not counted.
+void canvas_erase_pixel(Canvas *c, int x, int y);
+void canvas_set_pixel(Canvas *c, int x, int y, const char *fill);
+void canvas_set_pivot(Canvas *c, int x, int y);
+void canvas_clear(Canvas *c);
+void canvas_redraw(Canvas *c);
+// Transform the drawn pixels, on all the threads of the pool if it is not
+// NULL
+void canvas_transform(Canvas *c, TransformOp op, ThreadPool *pool);
+// Keep an ID buffer alongside the framebuffer, or release it. Every pixel
+// plotted from then on records the ID set by canvas_set_id in its cell, so
+// that the primitive a cell was lit by is looked up directly instead of
+// testing every primitive against the point. The buffer is cleared with
+// the canvas and follows its transformations, and where several pixels
+// end up in the same cell, the ID of one of them is kept.
+void canvas_enable_ids(Canvas *c, int enable);
+// Set the ID of the pixels plotted next, usually the index of the primitive
+// being drawn. The tiled renderer and the spatial index set it to the index
+// of every primitive they draw.
+void canvas_set_id(Canvas *c, u32 id);
+// Get the ID of the last pixel plotted at the logical coordinates, or
+// CANVAS_NO_ID if there is none or the canvas has no ID buffer
+u32 canvas_pick(const Canvas *c, int x, int y);
+
+// The functions below operate on the default canvas
+
 // Draw a graph like row column showing the numeric x and y values
 void draw_graph();
 // Enable or disable transformations on the drawn points
@@ -10,17 +101,31 @@ int get_rows();
 int get_columns();
 // Initialize the driver. This should be the first call to the library.
 void init_driver();
+// Initialize the driver without a terminal, backed only by an in memory
+// framebuffer of the given rows and columns. Nothing is displayed, and
+// wait_for_input returns immediately.
+void init_driver_headless(int rows, int cols);
+// Number of pixels plotted since the driver was initialized, including the
+// ones that fell outside of the screen, except for the rows of a stroke above
+// or below it
+u64 get_pixel_count();
 // Illuminate a pixel in the given coordinate
 void put_pixel(int x, int y);
 // Clear the terminal
 void screen_clear();
+// Redraw the whole terminal from the framebuffer
+void screen_redraw();
+// Get the framebuffer, which has one byte per terminal cell, row major from
+// the top left corner. Lit cells are non zero.
+const u8 *get_framebuffer();
 // Set the pivot for transformations
 void set_pivot(int x, int y);
 // Illuminate a pixel in the given coordinate with the given text
 void set_pixel(int x, int y, const char *pixel);
 // Show a message in the top left corner of the terminal
 void show_msg(const char *msg);
-// Terminate the and close the window
+// Terminate the and close the window. The profiling counters are printed
+// afterwards, if profiling is enabled.
 void terminate_driver();
 // Enables a loop which responds to user input in the following ways :
 // q|Q -> Quit the loop
@@ -30,7 +135,33 @@ void terminate_driver();
 // Arrow Down -> Transform all the points to one pixel down
 // z|Z -> Zoom in to the drawn object
 // x|X -> Zoom out from the drawn object
+// p|P -> Show the profiling counters, if profiling is enabled
 // Any pixel that is gone outside the viewport is permanently lost.
 void transform();
+// Apply one of the transformations of transform() to the drawn pixels,
+// without any user interaction
+void apply_transform(TransformOp op);
+// Transform the drawn pixels on the given number of threads, or on all the
+// cores if threads <= 0. The default is 1, i.e. the serial path. The
+// threads are released when the driver is terminated.
+void set_transform_threads(int threads);
+// The threads set by set_transform_threads, NULL for the serial path
+ThreadPool *get_transform_pool();
+// Transform the pixels using Q16.16 fixed point integer arithmetic instead
+// of the matrix library. Translations by whole pixels give exactly the same
+// result, while scaling and rotation may differ by a pixel where a position
+// falls within the rounding error of the coefficients.
+void set_transform_fixed(int fixed);
+// Scale the pixels about the pivot, as the zooms do, by gathering every new
+// cell from the old cells mapped onto it instead of moving every old pixel.
+// The occupancy pyramid skips the empty blocks, and once a new cell is lit,
+// the rest of the old cells mapped onto it are skipped too, so zooming out
+// costs as much as the new drawing rather than the old one. The result is
+// the same either way, and it is enabled by default.
+void set_transform_gather(int gather);
+// Draw several logical pixels per character of the terminal, which gives
+// a canvas of as many more pixels. Must be called before init_driver. The
+// coordinates are not shown by draw_graph in these modes.
+void set_glyph_mode(GlyphMode mode);
 // Start a busy wait loop until the user presses a key.
 int wait_for_input();
@@ -1,3 +1,5 @@
 #pragma once
 
-void draw_ellipse_midpoint(int c, int d, int a, int b);
+#include "driver.h"
+
+void draw_ellipse_midpoint(Canvas *cv, int c, int d, int a, int b);
@@ -0,0 +1,151 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "export.h"
+
+// Width of the netpbm images, every logical pixel is two cells wide
+#define image_width(c) ((c)->cols / 2)
+// Whether the logical pixel at the row and column of the image is lit
+#define image_lit(row, x) ((row)[(x)*2] | (row)[(x)*2 + 1])
+
+ExportFormat export_format_of(const char *path) {
+	const char *ext = strrchr(path, '.');
+	if(ext == NULL)
+		return 0;
+	const char *names[] = {".pbm", ".pgm", ".ppm", ".raw"};
+	for(int i = 0; i < 4; i++) {
+		if(strcmp(ext, names[i]) == 0)
+			return (ExportFormat)(i + 1);
+	}
+	return 0;
+}
+
+siz export_data_size(const Canvas *c, ExportFormat fmt) {
+	siz w = image_width(c), h = c->rows;
+	switch(fmt) {
+		case EXPORT_PBM: return ((w + 7) / 8) * h;
+		case EXPORT_PGM: return w * h;
+		case EXPORT_PPM: return w * h * 3;
+		case EXPORT_RAW: return (siz)c->rows * c->cols;
+	}
+	return 0;
+}
+
+siz export_header(const Canvas *c, ExportFormat fmt, char *buf) {
+	switch(fmt) {
+		case EXPORT_PBM:
+			return sprintf(buf, "P4\n%d %d\n", image_width(c), c->rows);
+		case EXPORT_PGM:
+			return sprintf(buf, "P5\n%d %d\n255\n", image_width(c), c->rows);
+		case EXPORT_PPM:
+			return sprintf(buf, "P6\n%d %d\n255\n", image_width(c), c->rows);
+		case EXPORT_RAW: break;
+	}
+	return 0;
+}
+
+void export_encode(const Canvas *c, ExportFormat fmt, u8 *buf) {
+	int w = image_width(c);
+	if(fmt == EXPORT_RAW) {
+		memcpy(buf, c->pixels, (siz)c->rows * c->cols);
+		return;
+	}
+	for(int r = 0; r < c->rows; r++) {
+		const u8 *row = &c->pixels[(siz)r * c->cols];
+		switch(fmt) {
+			case EXPORT_PBM: {
+				// Eight pixels per byte, the leftmost in the highest bit. The
+				// cells are 0 or 1, so they can be shifted in directly.
+				int x = 0;
+				for(; x + 8 <= w; x += 8) {
+					const u8 *cell = &row[x * 2];
+					u8        byte = 0;
+					for(int b = 0; b < 16; b += 2)
+						byte = (byte << 1) | cell[b] | cell[b + 1];
+					*buf++ = byte;
+				}
+				if(x < w) {
+					u8 byte = 0;
+					for(int b = 0; b < 8; b++) {
+						u8 lit = x + b < w && image_lit(row, x + b);
+						byte   = (byte << 1) | lit;
+					}
+					*buf++ = byte;
+				}
+				break;
+			}
+			case EXPORT_PGM:
+				for(int x = 0; x < w; x++) *buf++ = image_lit(row, x) ? 0 : 255;
+				break;
+			case EXPORT_PPM:
+				for(int x = 0; x < w; x++) {
+					u8 v   = image_lit(row, x) ? 0 : 255;
+					buf[0] = buf[1] = buf[2] = v;
+					buf += 3;
+				}
+				break;
+			case EXPORT_RAW: break;
+		}
+	}
+}
+
+// Writes all of the vectors, continuing after partial writes
+static int writev_all(int fd, struct iovec *iov, int count) {
+	while(count > 0) {
+		ssize_t written = writev(fd, iov, count);
+		if(written < 0) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		while(count > 0 && (siz)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if(count > 0) {
+			iov->iov_base = (u8 *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return 0;
+}
+
+int export_write_encoded(int fd, const char *header, siz header_size,
+                         const u8 *data, siz data_size) {
+	struct iovec iov[2] = {{(void *)header, header_size},
+	                       {(void *)data, data_size}};
+	return header_size ? writev_all(fd, iov, 2) : writev_all(fd, &iov[1], 1);
+}
+
+int export_write(const Canvas *c, ExportFormat fmt, int fd) {
+	char header[64];
+	siz  header_size = export_header(c, fmt, header);
+	siz  data_size   = export_data_size(c, fmt);
+	// The cells are always 0 or 1, so the framebuffer is written as it is
+	if(fmt == EXPORT_RAW) {
+		struct iovec iov = {c->pixels, data_size};
+		return writev_all(fd, &iov, 1);
+	}
+	u8 *data = (u8 *)malloc(data_size);
+	export_encode(c, fmt, data);
+	struct iovec iov[2] = {{header, header_size}, {data, data_size}};
+	int          res    = writev_all(fd, iov, 2);
+	free(data);
+	return res;
+}
+
+int export_file(const Canvas *c, ExportFormat fmt, const char *path) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		return -1;
+	int res = export_write(c, fmt, fd);
+	if(close(fd) != 0)
+		res = -1;
+	return res;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+
+// Image files of canvases. In the netpbm formats, every logical pixel is a
+// pixel of the image, lit if any of its two cells is lit, and drawn as black
+// ink on a white background. The raw format is an exact dump of the
+// framebuffer, with one byte per cell, so that it can be compared between
+// runs.
+
+typedef enum {
+	EXPORT_PBM = 1, // Binary bitmap, P4
+	EXPORT_PGM = 2, // Binary graymap, P5
+	EXPORT_PPM = 3, // Binary pixmap, P6
+	EXPORT_RAW = 4  // The framebuffer, rows x columns bytes
+} ExportFormat;
+
+// Get the format from the extension of the path, 0 if it is unknown
+ExportFormat export_format_of(const char *path);
+// Size of the pixel data of the image, excluding the header
+siz export_data_size(const Canvas *c, ExportFormat fmt);
+// Write the header of the image into the buffer, which must hold at least
+// 64 bytes. Returns the length of the header, 0 for the raw format.
+siz export_header(const Canvas *c, ExportFormat fmt, char *buf);
+// Encode the pixel data of the image into the buffer, which must hold
+// export_data_size bytes
+void export_encode(const Canvas *c, ExportFormat fmt, u8 *buf);
+// Write the whole image to the file descriptor using a single writev call,
+// unless the descriptor accepts less at once. Returns 0 on success, and -1
+// if the image could not be written.
+int export_write(const Canvas *c, ExportFormat fmt, int fd);
+// Write an image, encoded by export_header and export_encode, to the file
+// descriptor using a single writev call where possible
+int export_write_encoded(int fd, const char *header, siz header_size,
+                         const u8 *data, siz data_size);
+// Write the image to the file at the path, replacing it if it exists
+int export_file(const Canvas *c, ExportFormat fmt, const char *path);
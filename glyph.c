@@ -0,0 +1,110 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "glyph.h"
+
+// For every row of pixels of a character, the dots of the four characters
+// covered by a byte of the packed image, one character per byte of the
+// result, the leftmost one in the lowest byte
+static u32 braille_rows[4][256];
+static u32 quadrant_rows[2][256];
+// The utf-8 encoding of every pattern of dots
+static char braille_utf8[256][GLYPH_MAX_BYTES];
+static char quadrant_utf8[16][GLYPH_MAX_BYTES];
+
+// The quadrant characters, indexed by upper left = 1, upper right = 2,
+// lower left = 4 and lower right = 8
+static const u16 quadrant_codes[16] = {
+    ' ',    0x2598, 0x259d, 0x2580, 0x2596, 0x258c, 0x259e, 0x259b,
+    0x2597, 0x259a, 0x2590, 0x259c, 0x2584, 0x2599, 0x259f, 0x2588};
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void utf8_of(u16 code, char *out) {
+	if(code < 0x80) {
+		out[0] = code;
+		out[1] = 0;
+		return;
+	}
+	out[0] = 0xe0 | (code >> 12);
+	out[1] = 0x80 | ((code >> 6) & 0x3f);
+	out[2] = 0x80 | (code & 0x3f);
+	out[3] = 0;
+}
+
+// Bit of the braille dot in the column and row of the character
+static int braille_dot(int col, int row) {
+	if(row == 3)
+		return col ? 0x80 : 0x40;
+	return 1 << (row + col * 3);
+}
+
+static void tables_init() {
+	for(int b = 0; b < 256; b++) {
+		for(int p = 0; p < 8; p++) {
+			if(!(b & (0x80 >> p)))
+				continue;
+			int shift = (p / 2) * 8;
+			for(int r = 0; r < 4; r++)
+				braille_rows[r][b] |= (u32)braille_dot(p % 2, r) << shift;
+			for(int r = 0; r < 2; r++)
+				quadrant_rows[r][b] |= (u32)(1 << (r * 2 + p % 2)) << shift;
+		}
+		utf8_of(b ? 0x2800 + b : ' ', braille_utf8[b]);
+	}
+	for(int q = 0; q < 16; q++) utf8_of(quadrant_codes[q], quadrant_utf8[q]);
+}
+
+siz glyph_encode_row(const u8 *bits, siz stride, int width, int height,
+                     int row, GlyphMode mode, char *out) {
+	pthread_once(&tables_once, tables_init);
+	int       h = glyph_height(mode);
+	const u8 *rows[4];
+	// The rows past the bottom of the image are blank
+	for(int r = 0; r < h; r++) {
+		int y   = row * h + r;
+		rows[r] = y < height ? bits + (siz)y * stride : NULL;
+	}
+	int   chars = (width + 1) / 2;
+	char *start = out;
+	for(siz k = 0; k < stride; k++) {
+		u32 v = 0;
+		for(int r = 0; r < h; r++) {
+			u8 b = rows[r] ? rows[r][k] : 0;
+			v |= mode == GLYPH_BRAILLE ? braille_rows[r][b]
+			                           : quadrant_rows[r][b];
+		}
+		for(int j = 0; j < 4 && (int)k * 4 + j < chars; j++, v >>= 8) {
+			const char *g = mode == GLYPH_BRAILLE ? braille_utf8[v & 0xff]
+			                                      : quadrant_utf8[v & 0xff];
+			// Either a space or a three byte character
+			if(g[1] == 0)
+				*out++ = g[0];
+			else {
+				memcpy(out, g, 3);
+				out += 3;
+			}
+		}
+	}
+	*out = 0;
+	return out - start;
+}
+
+const char *glyph_at(const Canvas *c, GlyphMode mode, int row, int col) {
+	pthread_once(&tables_once, tables_init);
+	int h = glyph_height(mode), dots = 0;
+	for(int r = 0; r < h; r++) {
+		int y = row * h + r;
+		if(y >= c->rows)
+			break;
+		const u8 *cells = &c->pixels[(siz)y * c->cols];
+		for(int dc = 0; dc < 2; dc++) {
+			// Every logical pixel is a pair of cells
+			int x = (col * 2 + dc) * 2;
+			if(x + 1 < c->cols && (cells[x] | cells[x + 1]))
+				dots |= mode == GLYPH_BRAILLE ? braille_dot(dc, r)
+				                              : 1 << (r * 2 + dc);
+		}
+	}
+	return mode == GLYPH_BRAILLE ? braille_utf8[dots] : quadrant_utf8[dots];
+}
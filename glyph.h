@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+
+// Terminal output with more than one logical pixel per character. The
+// framebuffer is packed one bit per logical pixel, as in a pbm image, and
+// every character is looked up from the bits of the pixels it covers :
+//   quadrant : 2x2 pixels, as the quadrant block characters U+2596-U+259F
+//   braille  : 2x4 pixels, as the braille patterns U+2800-U+28FF
+// A character without any lit pixel is written as a space. GlyphMode is
+// declared in driver.h.
+
+// Logical pixels covered by a character, across and down
+#define glyph_width(mode) ((mode) == GLYPH_CELLS ? 1 : 2)
+#define glyph_height(mode) \
+	((mode) == GLYPH_BRAILLE ? 4 : (mode) == GLYPH_QUADRANT ? 2 : 1)
+
+// Longest utf-8 encoding of a character, including the terminating nul
+#define GLYPH_MAX_BYTES 4
+
+// Encode a row of characters of the packed image into out as utf-8, and
+// return its length. The image has height rows of stride bytes, and width
+// logical pixels, the leftmost of them in the highest bit. out must hold
+// GLYPH_MAX_BYTES bytes for every character of the row.
+siz glyph_encode_row(const u8 *bits, siz stride, int width, int height,
+                     int row, GlyphMode mode, char *out);
+// The character at the given row and column of characters of the canvas,
+// read straight from its framebuffer
+const char *glyph_at(const Canvas *c, GlyphMode mode, int row, int col);
@@ -1,5 +1,7 @@
 #pragma once
 
-void draw_line_dda(int x1, int y1, int x2, int y2);
-void draw_line_bresenham(int x1, int y1, int x2, int y2);
-void draw_line_midpoint(int x1, int y1, int x2, int y2);
+#include "driver.h"
+
+void draw_line_dda(Canvas *cv, int x1, int y1, int x2, int y2);
+void draw_line_bresenham(Canvas *cv, int x1, int y1, int x2, int y2);
+void draw_line_midpoint(Canvas *cv, int x1, int y1, int x2, int y2);
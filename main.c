@@ -1,15 +1,45 @@
-#include <ncurses.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "animation.h"
 #include "bench.h"
 #include "cargparser.h"
-#include "circle_drawing.h"
 #include "clipping.h"
+#include "curve_drawing.h"
 #include "display.h"
 #include "driver.h"
-#include "ellipse_drawing.h"
-#include "line_drawing.h"
+#include "export.h"
+#include "primitive.h"
+#include "profile.h"
+#include "scene.h"
+#include "scene_binary.h"
+#include "server.h"
+#include "stroke.h"
+
+// Size of the drawing written to a file, in logical pixels
+#define OUTPUT_DEFAULT_WIDTH 256
+#define OUTPUT_DEFAULT_HEIGHT 256
+// Longest animation script, in steps
+#define ANIMATION_MAX_STEPS 1024
+
+// Image file the drawing is written to instead of the terminal, '-' for the
+// standard output
+static const char * output_path   = NULL;
+static ExportFormat output_format = 0;
+static int output_width = OUTPUT_DEFAULT_WIDTH,
+           output_height = OUTPUT_DEFAULT_HEIGHT;
+
+// Initializes the driver on the terminal, or on an in memory canvas if the
+// drawing is written to a file
+static void start_driver() {
+	if(output_path)
+		init_driver_headless(output_height, output_width * 2);
+	else
+		init_driver();
+}
 
 static void usage(const char *name) {
 	pinfo("Usage : %s <args>\n\n"
@@ -37,11 +67,85 @@ static void usage(const char *name) {
 	      "\t[-y|--end]       : Second endpoint of the line       <int,int>\n"
 	      "\t[-b|--bottom]    : Bottom left point of the window   <int,int>\n"
 	      "\t[-t|--top]       : Top right point of the window     <int,int>\n\n"
+	      "Arguments for curve drawing : \n"
+	      "\t[-o|--object]    : curve\n"
+	      "\t[-a|--algo]      : [quadratic|cubic|catmull]\n"
+	      "\t[-v|--points]    : Control points, 3 of a quadratic and 4 of a "
+	      "cubic\n"
+	      "\t                   bezier, up to 64 of a catmull-rom spline\n"
+	      "\t                                                  "
+	      "<int,int,...>\n\n"
+	      "Arguments for stroke drawing : \n"
+	      "\t[-o|--object]    : stroke\n"
+	      "\t[-v|--points]    : Points of the polyline, up to 64  "
+	      "<int,int,...>\n"
+	      "\t[-W|--width]     : Width of the stroke               <int> "
+	      "[optional, 1 by default]\n"
+	      "\t[-a|--algo]      : [miter|round|bevel] joins of the segments "
+	      "[optional,\n"
+	      "\t                   miter by default]\n"
+	      "\t[-e|--ends]      : [butt|round] caps of the ends     "
+	      "[optional, butt by default]\n\n"
+	      "Arguments for scene drawing : \n"
+	      "\t[-o|--object]    : scene\n"
+	      "\t[-f|--file]      : Scene to draw, one primitive per line <path>\n"
+	      "\t                   line <dda|bresenham|midpoint> <x1> <y1> <x2> "
+	      "<y2>\n"
+	      "\t                   circle <bresenham|midpoint> <x> <y> <radius> "
+	      "[symmetry]\n"
+	      "\t                   ellipse midpoint <x> <y> <major> <minor>\n"
+	      "\t                   or a binary scene written by --compile\n"
+	      "\t[-C|--compile]   : Convert the text scene to a binary one instead "
+	      "of\n"
+	      "\t                   drawing it                       <path> "
+	      "[optional]\n\n"
+	      "Common arguments : \n"
+	      "\t[-g|--showgraph] : Show the coordinates along the axes\n"
+	      "\t[-P|--profile]   : Count and time the driver and matrix "
+	      "operations,\n"
+	      "\t                   shown on 'p' and on exit\n"
+	      "\t[-j|--threads]   : Threads to transform the drawing on <int> "
+	      "[optional, 1 by default]\n"
+	      "\t[-X|--fixed]     : Transform the drawing in fixed point integer "
+	      "arithmetic\n"
+	      "\t[-G|--glyphs]    : [quadrant|braille] draw 2x2 or 2x4 pixels per "
+	      "character\n"
+	      "\t                   of the terminal [optional]\n"
+	      "\t[-O|--output]    : Write the drawing to a .pbm, .pgm, .ppm or "
+	      ".raw file\n"
+	      "\t                   instead of showing it, or '-' for a .ppm on "
+	      "the\n"
+	      "\t                   standard output               <path> "
+	      "[optional]\n"
+	      "\t[-S|--size]      : Width and height of the file   <int,int> "
+	      "[optional, 256,256 by default]\n"
+	      "\t[-A|--animate]   : Write a frame to the output after every step "
+	      "of the\n"
+	      "\t                   script, one after the other   <script> "
+	      "[optional]\n"
+	      "\t                   <left|right|up|down|zoom_in|zoom_out|"
+	      "rotate_acw|\n"
+	      "\t                   rotate_cw>[*count],...\n\n"
 	      "To specify a coordinate, write it in the following format : \n"
 	      "\t<abscissa>,<ordinate>\n"
 	      "Don't add any spaces in between the comma and the numbers.\n\n"
+	      "Arguments for the render server (ignores all other arguments "
+	      "but -j) : \n"
+	      "\t[-L|--listen]    : Serve drawing commands on the Unix socket "
+	      "<path>\n"
+	      "\t                   canvas <name> <width> <height>, draw <name> "
+	      "<primitive>,\n"
+	      "\t                   clear <name>, pivot <name> <x> <y>, transform "
+	      "<name> <script>,\n"
+	      "\t                   pixels <name>, export <name> <path>, "
+	      "send <name> <format>,\n"
+	      "\t                   free <name>, quit, shutdown\n\n"
 	      "Arguments for benchmarking (ignores all other arguments) : \n"
-	      "\t[-c|--bench]     : [create|fill|add|sub|draw|all]\n"
+	      "\t[-c|--bench]     : [create|fill|add|sub|mult|draw|line|circle|"
+	      "ellipse|clip|tiled|\n"
+	      "\t                   transform|batch|scene|export|animation|"
+	      "terminal|glyphs|server|sinks|curve|stroke|cull|pick|\n"
+	      "\t                   incremental|all]\n"
 	      "\tThe options perform the following benchmarks respectively :\n"
 	      "\t create          : 3x3 matrix creation\n"
 	      "\t fill            : 3x3 matrix fill\n"
@@ -49,7 +153,70 @@ static void usage(const char *name) {
 	      "\t sub             : 3x3 matrix subtraction\n"
 	      "\t mult            : 3x3 matrix multiplication\n"
 	      "\t draw            : put_pixel calls to the driver\n"
-	      "\t all             : all of the above\n",
+	      "\t line            : dda, bresenham and midpoint lines\n"
+	      "\t circle          : bresenham, 8 point bresenham and midpoint "
+	      "circles\n"
+	      "\t ellipse         : midpoint ellipses\n"
+	      "\t clip            : cohen sutherland and midpoint subdivision "
+	      "clipping\n"
+	      "\t tiled           : serial and tiled multi-threaded rendering of "
+	      "a scene\n"
+	      "\t transform       : serial and multi-threaded zoom of a scene\n"
+	      "\t batch           : serial and work stealing rendering of many "
+	      "thumbnails\n"
+	      "\t scene           : loading and rendering of text and binary "
+	      "scenes\n"
+	      "\t export          : writing of the image formats\n"
+	      "\t animation       : serial and pipelined writing of animation "
+	      "frames\n"
+	      "\t terminal        : repainted and diffed terminal output of a "
+	      "panning scene\n"
+	      "\t glyphs          : terminal output of a scene with one, four and "
+	      "eight\n"
+	      "\t                   pixels per character\n"
+	      "\t server          : drawing requests to a render server, and "
+	      "drawing\n"
+	      "\t                   processes\n"
+	      "\t sinks           : rasterization of a scene through put_pixel, "
+	      "and into\n"
+	      "\t                   the framebuffer, a bitset and a counter\n"
+	      "\t curve           : quadratic and cubic bezier curves, catmull-rom "
+	      "splines,\n"
+	      "\t                   and cubic curves drawn as lines\n"
+	      "\t stroke          : thick lines and polylines, and thick lines "
+	      "drawn as\n"
+	      "\t                   parallel lines\n"
+	      "\t cull            : drawing the visible part of a large map, "
+	      "with and without\n"
+	      "\t                   a spatial index\n"
+	      "\t pick            : finding the primitive drawn at a point, by "
+	      "their bounds\n"
+	      "\t                   and from an ID buffer\n"
+	      "\t incremental     : replacing a few primitives of a scene by "
+	      "drawing all of\n"
+	      "\t                   them, and with reference counts\n"
+	      "\t all             : all of the above\n"
+	      "\t[-i|--iterations]: Items processed per run          <int> "
+	      "[optional]\n"
+	      "\t[-w|--warmup]    : Untimed runs before measuring    <int> "
+	      "[optional, 1 by default]\n"
+	      "\t[-p|--repeat]    : Timed runs per benchmark         <int> "
+	      "[optional, 5 by default]\n"
+	      "\t[-F|--format]    : [text|json|csv] format of the results "
+	      "[optional, text by default]\n"
+	      "\t[-B|--baseline]  : csv results of an earlier run to compare with "
+	      "<path> [optional]\n"
+	      "\t[-T|--threshold] : Slowdown from the baseline to flag, in %%  "
+	      "<int> [optional, 5 by default]\n"
+	      "\t[-j|--threads]   : Threads to render on             <int> "
+	      "[optional, all cores by default]\n"
+	      "\t[-H|--counters]  : Report cycles, instructions, cache and branch "
+	      "misses\n"
+	      "\t                   per item and per pixel, using perf_event_open "
+	      "[optional]\n"
+	      "\tThe exit status is 1 if any benchmark regressed from the "
+	      "baseline, and 2 if\n"
+	      "\tthe baseline could not be read.\n",
 	      name);
 }
 
@@ -149,16 +316,13 @@ static void draw_line(ArgumentList list, char **argv) {
 	get_point('x', "starting point", &x, &y, list, argv[0]);
 	get_point('y', "ending point", &p, &q, list, argv[0]);
 
-	init_driver();
+	start_driver();
 	set_pivot((x + p) / 2, (y + q) / 2);
 	if(arg_is_present(list, 'g'))
 		draw_graph();
 
-	switch(algo) {
-		case 1: draw_line_dda(x, y, p, q); break;
-		case 2: draw_line_bresenham(x, y, p, q); break;
-		case 3: draw_line_midpoint(x, y, p, q); break;
-	}
+	Primitive prim = {PRIM_LINE, (u8)algo, 0, {x, y, p, q}};
+	primitive_draw(canvas_default(), &prim);
 }
 
 static void draw_circle(ArgumentList list, char **argv) {
@@ -173,29 +337,19 @@ static void draw_circle(ArgumentList list, char **argv) {
 	get_int('r', &r, "radius", list, argv[0]);
 	get_int_optional('s', &s, "symmetry", list, argv[0], 0);
 
-	if(s != 0) {
-		int j = 2;
-		while((j << 1) <= s) j <<= 1;
-		if(j != s || s < 4 || s > 256) {
-			perr("Symmetry must be a power of 2 (4 <= symmetry <= 256) (Given "
-			     ": %d)\n",
-			     s);
-			arg_free(list);
-			exit(2);
-		}
+	if(s != 0 && !primitive_symmetry_valid(s)) {
+		perr("Symmetry must be a power of 2 (4 <= symmetry <= 256) (Given : "
+		     "%d)\n",
+		     s);
+		arg_free(list);
+		exit(2);
 	}
 
-	init_driver();
+	start_driver();
 	set_pivot(x, y);
-	switch(algo) {
-		case 1:
-			if(s > 0) {
-				draw_circle_bresenham_n_point(x, y, r, s);
-			} else
-				draw_circle_bresenham(x, y, r);
-			break;
-		case 2: draw_circle_midpoint(x, y, r, s == 0 ? 4 : s); break;
-	}
+	Primitive prim = {PRIM_CIRCLE, algo == 1 ? ALGO_BRESENHAM : ALGO_MIDPOINT,
+	                  (u16)s, {x, y, r, 0}};
+	primitive_draw(canvas_default(), &prim);
 }
 
 static void draw_ellipse(ArgumentList list, char **argv) {
@@ -204,9 +358,10 @@ static void draw_ellipse(ArgumentList list, char **argv) {
 	get_int('m', &a, "major axis length", list, argv[0]);
 	get_int('n', &b, "minor axis length", list, argv[0]);
 
-	init_driver();
+	start_driver();
 	set_pivot(x, y);
-	draw_ellipse_midpoint(x, y, a, b);
+	Primitive prim = {PRIM_ELLIPSE, ALGO_MIDPOINT, 0, {x, y, a, b}};
+	primitive_draw(canvas_default(), &prim);
 }
 
 static void draw_clip(ArgumentList list, char **argv) {
@@ -226,23 +381,266 @@ static void draw_clip(ArgumentList list, char **argv) {
 	                          argv[0], 2, &algos[0]);
 
 	enable_transform(0);
-	init_driver();
+	start_driver();
 	switch(choice) {
-		case 1: clipping_cohen_sutherland(x, y, p, q, bx, by, tx, ty); break;
+		case 1:
+			clipping_cohen_sutherland(canvas_default(), x, y, p, q, bx, by, tx,
+			                          ty);
+			break;
 		case 2:
-			clipping_midpoint_subdivision(x, y, p, q, bx, by, tx, ty);
+			clipping_midpoint_subdivision(canvas_default(), x, y, p, q, bx, by,
+			                              tx, ty);
 			break;
 	}
 }
 
-static void perform_bench(ArgumentList list, char **argv) {
-	const char *benches[] = {"create", "fill", "add", "sub",
-	                         "mult",   "draw", "all"};
+// Longest list of points of a curve
+#define CURVE_MAX_POINTS 64
+
+// Parses a list of x, y pairs separated by commas. Returns the number of
+// points.
+static int get_points(char p, const char *name, int *slots, int max,
+                      ArgumentList list, char *argv0) {
+	if(!arg_is_present(list, p)) {
+		perr("Expected argument '-%c' (%s)!", p, name);
+		arg_free(list);
+		usage(argv0);
+		exit(1);
+	}
+	char *str   = arg_value(list, p);
+	int   count = 0;
+	for(char *tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		if(count == max * 2) {
+			perr("Expected at most %d points!", max);
+			arg_free(list);
+			exit(1);
+		}
+		slots[count++] = parse_int(tok, list, argv0);
+	}
+	if(count == 0 || count % 2 != 0) {
+		perr("Bad points : '%s'!", str);
+		perr("Correct format : x,y,x,y,...");
+		arg_free(list);
+		usage(argv0);
+		exit(1);
+	}
+	return count / 2;
+}
+
+static void draw_curve(ArgumentList list, char **argv) {
+	int points[CURVE_MAX_POINTS * 2];
+
+	const char *algos[] = {"quadratic", "cubic", "catmull"};
+
+	int algo  = expect_oneof('a', list, "Specify the algorithm to use",
+	                            argv[0], 3, &algos[0]);
+	int count = get_points('v', "control points", points, CURVE_MAX_POINTS,
+	                       list, argv[0]);
+	if(algo < 3 && count != algo + 2) {
+		perr("Expected %d control points of the curve, got %d!", algo + 2,
+		     count);
+		arg_free(list);
+		exit(1);
+	}
+
+	start_driver();
+	set_pivot(points[0], points[1]);
+	if(arg_is_present(list, 'g'))
+		draw_graph();
+	switch(algo) {
+		case 1: draw_bezier_quadratic(canvas_default(), points); break;
+		case 2: draw_bezier_cubic(canvas_default(), points); break;
+		case 3: draw_catmull_rom(canvas_default(), points, count); break;
+	}
+}
+
+static void draw_stroke(ArgumentList list, char **argv) {
+	int points[CURVE_MAX_POINTS * 2], width = 1;
+	int join = STROKE_JOIN_MITER, cap = STROKE_CAP_BUTT;
+
+	int count = get_points('v', "points of the polyline", points,
+	                       CURVE_MAX_POINTS, list, argv[0]);
+	get_int_optional('W', &width, "width", list, argv[0], 1);
+	if(width < 1) {
+		perr("The width of the stroke must be positive!");
+		arg_free(list);
+		exit(1);
+	}
+	if(arg_is_present(list, 'a')) {
+		const char *joins[] = {"miter", "round", "bevel"};
+		join = expect_oneof('a', list, "Specify the joins", argv[0], 3,
+		                    &joins[0]);
+	}
+	if(arg_is_present(list, 'e')) {
+		const char *caps[] = {"butt", "round"};
+		cap = expect_oneof('e', list, "Specify the caps", argv[0], 2, &caps[0]);
+	}
+
+	start_driver();
+	set_pivot(points[0], points[1]);
+	if(arg_is_present(list, 'g'))
+		draw_graph();
+	draw_polyline(canvas_default(), points, count, width, (StrokeJoin)join,
+	              (StrokeCap)cap);
+}
+
+typedef struct {
+	Primitive *prims;
+	siz        count, capacity;
+} PrimitiveList;
+
+static void collect_primitive(const Primitive *p, void *arg) {
+	PrimitiveList *l = (PrimitiveList *)arg;
+	if(l->count == l->capacity) {
+		l->capacity = l->capacity ? l->capacity * 2 : 1024;
+		l->prims =
+		    (Primitive *)realloc(l->prims, sizeof(Primitive) * l->capacity);
+	}
+	l->prims[l->count++] = *p;
+}
+
+// Converts the text scene to a binary one
+static int compile_scene(FILE *f, const char *path, const char *out) {
+	PrimitiveList l     = {NULL, 0, 0};
+	long          count = scene_read(f, collect_primitive, &l);
+	if(count < 0) {
+		perr("Malformed primitive at line %ld of the scene '%s'!", -count,
+		     path);
+		free(l.prims);
+		return 1;
+	}
+	FILE *o = fopen(out, "wb");
+	if(o == NULL || scene_binary_write(o, l.prims, l.count) != 0) {
+		perr("Unable to write the binary scene '%s'!", out);
+		if(o)
+			fclose(o);
+		free(l.prims);
+		return 1;
+	}
+	fclose(o);
+	pinfo("Wrote %" Psiz " primitives to '%s'", l.count, out);
+	free(l.prims);
+	return 0;
+}
+
+static void draw_scene(ArgumentList list, char **argv) {
+	if(!arg_is_present(list, 'f')) {
+		perr("Specify the scene to draw!");
+		arg_free(list);
+		usage(argv[0]);
+		exit(1);
+	}
+	const char *path = arg_value(list, 'f');
+	SceneMap    map;
+	int         mapped = scene_map(path, &map);
+	FILE *      f      = mapped == 0 ? fopen(path, "r") : NULL;
+	if(mapped < 0 || (mapped == 0 && f == NULL)) {
+		perr("Unable to read the scene '%s'!", path);
+		arg_free(list);
+		exit(1);
+	}
+	if(arg_is_present(list, 'C')) {
+		if(mapped) {
+			perr("The scene '%s' is already binary!", path);
+			arg_free(list);
+			exit(1);
+		}
+		int status = compile_scene(f, path, arg_value(list, 'C'));
+		fclose(f);
+		arg_free(list);
+		exit(status);
+	}
+
+	start_driver();
+	set_pivot(get_columns() / 4, get_rows() / 2);
+	if(arg_is_present(list, 'g'))
+		draw_graph();
+	if(mapped) {
+		scene_map_draw(&map, canvas_default());
+		scene_unmap(&map);
+		return;
+	}
+	long count = scene_draw(f, canvas_default());
+	fclose(f);
+	if(count < 0) {
+		terminate_driver();
+		perr("Malformed primitive at line %ld of the scene '%s'!", -count,
+		     path);
+		arg_free(list);
+		exit(1);
+	}
+}
+
+// Writes the drawing, or the frames of the animation, to the output
+static int write_output(const char *script, const char *argv0) {
+	AnimationStep steps[ANIMATION_MAX_STEPS];
+	int           count = 0;
+	if(script) {
+		count = animation_parse(script, steps, ANIMATION_MAX_STEPS);
+		if(count < 0) {
+			perr("Malformed animation script '%s'!", script);
+			usage(argv0);
+			return 1;
+		}
+	}
+	int to_stdout = strcmp(output_path, "-") == 0;
+	int fd        = to_stdout ? STDOUT_FILENO
+	                   : open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	int res       = fd < 0 ? -1 : 0;
+	if(res == 0 && script == NULL)
+		res = export_write(canvas_default(), output_format, fd);
+	else if(res == 0) {
+		u64  start  = profile_now();
+		long frames = animation_run(canvas_default(), steps, count,
+		                            output_format, fd, get_transform_pool(), 1);
+		double secs = (profile_now() - start) / 1e9;
+		res         = frames < 0 ? -1 : 0;
+		// The frames may be on the standard output, so the rate is reported
+		// on the standard error
+		if(frames > 0)
+			fprintf(stderr, "Wrote %ld frames in %.3f s, %.1f frames/s\n",
+			        frames, secs, frames / secs);
+	}
+	if(fd >= 0 && !to_stdout && close(fd) != 0)
+		res = -1;
+	if(res != 0)
+		perr("Unable to write '%s'!", output_path);
+	return res != 0;
+}
+
+static int perform_bench(ArgumentList list, char **argv) {
+	const char *benches[] = {"create",      "fill",        "add",
+	                         "sub",         "mult",        "draw",
+	                         "line",        "circle",      "ellipse",
+	                         "clip",        "tiled",       "transform",
+	                         "batch",       "scene",       "export",
+	                         "animation",   "terminal",    "glyphs",
+	                         "server",      "sinks",       "curve",
+	                         "stroke",      "cull",        "pick",
+	                         "incremental", "all"};
 
 	int choice = expect_oneof('c', list, "Specify the benchmark to perform",
-	                          argv[0], 7, &benches[0]);
+	                          argv[0], 26, &benches[0]);
+
+	BenchConfig config;
+	int         threshold = 0;
+	get_int_optional('i', &config.iterations, "iterations", list, argv[0], 0);
+	get_int_optional('w', &config.warmup, "warmup", list, argv[0], -1);
+	get_int_optional('p', &config.repetitions, "repeat", list, argv[0], 0);
+	get_int_optional('T', &threshold, "threshold", list, argv[0], 0);
+	get_int_optional('j', &config.threads, "threads", list, argv[0], 0);
+	config.threshold = threshold;
+	config.baseline  = arg_is_present(list, 'B') ? arg_value(list, 'B') : NULL;
+	config.counters  = arg_is_present(list, 'H');
+	config.format    = BENCH_FORMAT_TEXT;
+	if(arg_is_present(list, 'F')) {
+		const char *formats[] = {"text", "json", "csv"};
+		config.format         = (BenchFormat)expect_oneof(
+            'F', list, "Specify the format", argv[0], 3, &formats[0]);
+	}
 
-	bench((BenchType)choice);
+	int regressions = bench((BenchType)choice, &config);
+	return regressions < 0 ? 2 : regressions > 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -251,32 +649,101 @@ int main(int argc, char *argv[]) {
 		return 0;
 	}
 
-	ArgumentList list = arg_list_create(12);
+	ArgumentList list = arg_list_create(32);
 
 	arg_add(list, 'a', "algo", true);
+	arg_add(list, 'A', "animate", true);
+	arg_add(list, 'B', "baseline", true);
 	arg_add(list, 'b', "bottom", true);
 	arg_add(list, 'c', "bench", true);
+	arg_add(list, 'C', "compile", true);
+	arg_add(list, 'e', "ends", true);
+	arg_add(list, 'f', "file", true);
+	arg_add(list, 'F', "format", true);
 	arg_add(list, 'g', "showgraph", false);
+	arg_add(list, 'G', "glyphs", true);
+	arg_add(list, 'H', "counters", false);
+	arg_add(list, 'i', "iterations", true);
+	arg_add(list, 'j', "threads", true);
+	arg_add(list, 'L', "listen", true);
 	arg_add(list, 'm', "major", true);
 	arg_add(list, 'n', "minor", true);
 	arg_add(list, 'o', "object", true);
+	arg_add(list, 'O', "output", true);
+	arg_add(list, 'p', "repeat", true);
+	arg_add(list, 'P', "profile", false);
 	arg_add(list, 'r', "radius", true);
 	arg_add(list, 's', "symmetry", true);
+	arg_add(list, 'S', "size", true);
 	arg_add(list, 't', "top", true);
+	arg_add(list, 'v', "points", true);
+	arg_add(list, 'T', "threshold", true);
+	arg_add(list, 'w', "warmup", true);
+	arg_add(list, 'W', "width", true);
+	arg_add(list, 'X', "fixed", false);
 	arg_add(list, 'x', "start", true);
 	arg_add(list, 'y', "end", true);
 
 	arg_parse(argc, &argv[0], list);
 
 	if(arg_is_present(list, 'c')) {
-		perform_bench(list, &argv[0]);
+		int status = perform_bench(list, &argv[0]);
 		arg_free(list);
-		return 0;
+		return status;
+	}
+
+	if(arg_is_present(list, 'P'))
+		profile_enable(1);
+	int threads;
+	get_int_optional('j', &threads, "threads", list, argv[0], 1);
+	set_transform_threads(threads);
+	if(arg_is_present(list, 'X'))
+		set_transform_fixed(1);
+	if(arg_is_present(list, 'L')) {
+		const char *path = arg_value(list, 'L');
+		pinfo("Serving on '%s'", path);
+		int res = server_run(path);
+		if(res != 0)
+			perr("Unable to listen on '%s'!", path);
+		set_transform_threads(1);
+		arg_free(list);
+		return res != 0;
+	}
+	if(arg_is_present(list, 'G')) {
+		const char *modes[] = {"quadrant", "braille"};
+		set_glyph_mode((GlyphMode)expect_oneof(
+		    'G', list, "Specify the glyphs", argv[0], 2, &modes[0]));
+	}
+	if(arg_is_present(list, 'O')) {
+		output_path   = arg_value(list, 'O');
+		output_format = strcmp(output_path, "-") == 0
+		                    ? EXPORT_PPM
+		                    : export_format_of(output_path);
+		if(output_format == 0) {
+			perr("Unknown format of '%s', expected .pbm, .pgm, .ppm or .raw!",
+			     output_path);
+			arg_free(list);
+			exit(1);
+		}
+		if(arg_is_present(list, 'S'))
+			get_point('S', "size", &output_width, &output_height, list,
+			          argv[0]);
+		if(output_width < 1 || output_height < 1) {
+			perr("The size of the output must be positive!");
+			arg_free(list);
+			exit(1);
+		}
+	}
+	if(arg_is_present(list, 'A') && output_path == NULL) {
+		perr("Specify the output to write the animation to!");
+		arg_free(list);
+		exit(1);
 	}
 
-	const char *objects[] = {"line", "circle", "ellipse", "clip"};
+	const char *objects[] = {"line",  "circle", "ellipse", "clip",
+	                         "scene", "curve",  "stroke"};
 
-	int choice = expect_oneof('o', list, "Specify object to draw", argv[0], 4,
+	int choice = expect_oneof('o', list, "Specify object to draw", argv[0], 7,
 	                          &objects[0]);
 
 	switch(choice) {
@@ -284,6 +751,16 @@ int main(int argc, char *argv[]) {
 		case 2: draw_circle(list, &argv[0]); break;
 		case 3: draw_ellipse(list, &argv[0]); break;
 		case 4: draw_clip(list, &argv[0]); break;
+		case 5: draw_scene(list, &argv[0]); break;
+		case 6: draw_curve(list, &argv[0]); break;
+		case 7: draw_stroke(list, &argv[0]); break;
+	}
+	if(output_path) {
+		int status = write_output(
+		    arg_is_present(list, 'A') ? arg_value(list, 'A') : NULL, argv[0]);
+		terminate_driver();
+		arg_free(list);
+		return status;
 	}
 	transform();
 	terminate_driver();
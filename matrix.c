@@ -1,22 +1,67 @@
 #ifdef DEBUG
 #include "display.h"
 #endif
+#include "common.h"
 #include "matrix.h"
+#include "profile.h"
 
 #include <malloc.h>
 #include <memory.h>
 #include <stdarg.h>
 
+// The values follow the dimensions in the same block
 typedef struct Mat {
-	double *values;
-	int     m, n;
+	int    m, n;
+	double values[];
 } Mat;
 
+// Matrices of up to this many values are taken from the pools, the larger
+// ones are allocated directly
+#define MAT_POOL_MAX_VALUES 16
+// Size of the slabs the pools are refilled with
+#define MAT_POOL_SLAB_SIZE 16384
+
+// A released block, linked in the pool of its size class
+typedef struct FreeBlock {
+	struct FreeBlock *next;
+} FreeBlock;
+
+// One pool of released blocks per number of values, for every thread, so
+// that allocation and release are a pop and a push without any locking.
+// The blocks are never given back to the system, so the pools stay as large
+// as the most matrices that were alive at once.
+static __thread FreeBlock *pools[MAT_POOL_MAX_VALUES + 1];
+
+static inline siz block_size(int count) {
+	siz size = sizeof(Mat) + sizeof(double) * count;
+	return size < sizeof(FreeBlock) ? sizeof(FreeBlock) : size;
+}
+
+// Carves a new slab into blocks of the size class
+static void slab_refill(int count) {
+	siz   size   = block_size(count);
+	siz   blocks = MAT_POOL_SLAB_SIZE / size;
+	char *slab   = (char *)malloc(size * blocks);
+	for(siz i = 0; i < blocks; i++) {
+		FreeBlock *b = (FreeBlock *)(slab + i * size);
+		b->next      = pools[count];
+		pools[count] = b;
+	}
+}
+
 Mat *mat_new(int m, int n) {
-	Mat *mt    = (Mat *)malloc(sizeof(Mat));
-	mt->m      = m;
-	mt->n      = n;
-	mt->values = (double *)malloc(sizeof(double) * m * n);
+	prof_count(PROF_MAT_NEW);
+	int  count = m * n;
+	Mat *mt;
+	if(count <= MAT_POOL_MAX_VALUES) {
+		if(pools[count] == NULL)
+			slab_refill(count);
+		mt           = (Mat *)pools[count];
+		pools[count] = pools[count]->next;
+	} else
+		mt = (Mat *)malloc(block_size(count));
+	mt->m = m;
+	mt->n = n;
 	return mt;
 }
 
@@ -62,6 +107,7 @@ Mat *mat_mult(Mat *m1, Mat *m2) {
 #endif
 		return NULL;
 	}
+	prof_count(PROF_MAT_MULT);
 	Mat *res = mat_new(m1->m, m2->n);
 	// Row loop
 	for(int i = 0; i < res->m; i++) {
@@ -88,6 +134,7 @@ Mat *mat_add(Mat *m1, Mat *m2) {
 #endif
 		return NULL;
 	}
+	prof_count(PROF_MAT_ADD);
 	Mat *res = mat_new(m1->m, m1->n);
 	for(int i = 0; i < m1->m; i++) {
 		for(int j = 0; j < m1->n; j++) {
@@ -106,6 +153,7 @@ Mat *mat_sub(Mat *m1, Mat *m2) {
 #endif
 		return NULL;
 	}
+	prof_count(PROF_MAT_SUB);
 	Mat *res = mat_new(m1->m, m1->n);
 	for(int i = 0; i < m1->m; i++) {
 		for(int j = 0; j < m1->n; j++) {
@@ -116,6 +164,13 @@ Mat *mat_sub(Mat *m1, Mat *m2) {
 }
 
 void mat_free(Mat *m1) {
-	free(m1->values);
-	free(m1);
+	prof_count(PROF_MAT_FREE);
+	int count = m1->m * m1->n;
+	if(count > MAT_POOL_MAX_VALUES) {
+		free(m1);
+		return;
+	}
+	FreeBlock *b = (FreeBlock *)m1;
+	b->next      = pools[count];
+	pools[count] = b;
 }
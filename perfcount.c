@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "perfcount.h"
+
+static const char *counter_names[] = {"cycles", "instructions", "cache_misses",
+                                      "branch_misses"};
+
+const char *perf_counter_name(PerfCounter c) {
+	return counter_names[c];
+}
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int fds[PERF_COUNTER_COUNT] = {-1, -1, -1, -1};
+
+static const u64 counter_configs[] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+static int open_counter(u64 config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type   = PERF_TYPE_HARDWARE;
+	attr.size   = sizeof(attr);
+	attr.config = config;
+	attr.read_format =
+	    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.disabled = 1;
+	// User space only, which is allowed even with a restrictive
+	// perf_event_paranoid
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	// Also count the threads and processes created afterwards, which the
+	// pools and the schedulers do most of the work on. Reading, resetting
+	// and enabling the counter covers all of them.
+	attr.inherit = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int perf_open() {
+	int count = 0;
+	for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		fds[i] = open_counter(counter_configs[i]);
+		count += fds[i] >= 0;
+	}
+	return count;
+}
+
+void perf_start() {
+	for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if(fds[i] < 0)
+			continue;
+		ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void perf_stop(PerfSample *sample) {
+	for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if(fds[i] >= 0)
+			ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+	for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		// value, time enabled, time running
+		u64 buf[3];
+		sample->valid[i]  = 0;
+		sample->values[i] = 0;
+		if(fds[i] < 0 || read(fds[i], buf, sizeof(buf)) != sizeof(buf) ||
+		   buf[2] == 0)
+			continue;
+		// The kernel multiplexes the counters if there are not enough of
+		// them in hardware, so extrapolate to the whole enabled time
+		sample->values[i] = (double)buf[0] * buf[1] / buf[2];
+		sample->valid[i]  = 1;
+	}
+}
+
+void perf_close() {
+	for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if(fds[i] >= 0)
+			close(fds[i]);
+		fds[i] = -1;
+	}
+}
+
+#else
+
+int perf_open() {
+	return 0;
+}
+
+void perf_start() {
+}
+
+void perf_stop(PerfSample *sample) {
+	memset(sample, 0, sizeof(PerfSample));
+}
+
+void perf_close() {
+}
+
+#endif
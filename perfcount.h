@@ -0,0 +1,33 @@
+#pragma once
+
+#include "common.h"
+
+// Hardware performance counters of the calling thread, and of every thread
+// or process it creates after the counters are opened, read through the
+// Linux perf_event_open interface. On other platforms, or when the kernel
+// does not allow access to them, no counter can be opened.
+
+typedef enum {
+	PERF_CYCLES        = 0,
+	PERF_INSTRUCTIONS  = 1,
+	PERF_CACHE_MISSES  = 2,
+	PERF_BRANCH_MISSES = 3,
+	PERF_COUNTER_COUNT = 4
+} PerfCounter;
+
+typedef struct {
+	double values[PERF_COUNTER_COUNT]; // Scaled if the counter was multiplexed
+	u8     valid[PERF_COUNTER_COUNT];  // Whether the counter could be read
+} PerfSample;
+
+// Open the counters, before creating the threads to be counted. Returns the
+// number of counters which could be opened.
+int perf_open();
+// Reset and start all the opened counters
+void perf_start();
+// Stop the counters and read their values into the sample
+void perf_stop(PerfSample *sample);
+// Close all the opened counters
+void perf_close();
+// Name of the counter, usable as an identifier
+const char *perf_counter_name(PerfCounter counter);
@@ -0,0 +1,113 @@
+#include <math.h>
+
+#include "primitive.h"
+#include "raster.h"
+
+#define ABS(x) ((x) < 0 ? -(x) : (x))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+int primitive_symmetry_valid(int symmetry) {
+	return symmetry >= 4 && symmetry <= 256 && (symmetry & (symmetry - 1)) == 0;
+}
+
+void primitive_draw(Canvas *cv, const Primitive *p) {
+	raster_canvas(cv, primitive, p);
+}
+
+// The circle algorithms with a point symmetry step the decision variable
+// with the absolute coordinates of the point rather than its offset from the
+// centre, so how far they stray from the radius depends on the centre too.
+// Both functions below follow the loop of the rasterizer of the same name
+// step by step, without plotting, and return the largest distance from the
+// centre of the points it reflects. Every plotted point is a rotation of one
+// of them, rounded to the nearest pixel.
+static double circle_reach_midpoint(int a, int b, int r, int points) {
+	int    x = a, y = b + r, p = 1 - r;
+	double reach         = ABS(r);
+	double expectedSlope = tan((90 - (360 / points)) * (M_PI / 180));
+	do {
+		x++;
+		if(p < 0) {
+			p = p + 2 * x + 3;
+		} else {
+			y--;
+			p = p + 2 * (x - y) + 5;
+		}
+		reach = MAX(reach, hypot(x - a, y - b));
+	} while((double)(y - b) / (x - a) > expectedSlope);
+	return reach;
+}
+
+static double circle_reach_bresenham(int a, int b, int r, int points) {
+	double x = a, y = b + r, p = 3 - 2 * r;
+	double reach         = ABS(r);
+	double expectedSlope = tan((90 - (360 / points)) * (M_PI / 180));
+	do {
+		x++;
+		if(p < 0)
+			p = p + 4 * x + 6;
+		else {
+			y--;
+			p = p + 4 * (x - y) + 10;
+		}
+		reach = MAX(reach, hypot(x - a, y - b));
+	} while((y - b) / (x - a) > expectedSlope);
+	return reach;
+}
+
+void primitive_bounds(const Primitive *p, int *xmin, int *ymin, int *xmax,
+                      int *ymax) {
+	const int *a = p->args;
+	switch(p->type) {
+		case PRIM_LINE: {
+			int dx = ABS(a[2] - a[0]), dy = ABS(a[3] - a[1]);
+			*xmin = MIN(a[0], a[2]);
+			*xmax = MAX(a[0], a[2]);
+			*ymin = MIN(a[1], a[3]);
+			*ymax = MAX(a[1], a[3]);
+			switch(p->algo) {
+				// Both of them only walk upwards from the first endpoint,
+				// the midpoint one by up to 1.5 pixels per step
+				case ALGO_DDA:
+					*ymin = a[1];
+					*ymax = a[1] + dy;
+					break;
+				case ALGO_MIDPOINT:
+					*ymin = a[1];
+					*ymax = a[1] + dx + (dx + 1) / 2;
+					break;
+			}
+			break;
+		}
+		case PRIM_CIRCLE: {
+			// The eight point Bresenham algorithm stays within a pixel of
+			// the radius
+			int points = p->symmetry == 0 ? 4 : p->symmetry, r = ABS(a[2]);
+			if(p->algo == ALGO_MIDPOINT)
+				r = ceil(circle_reach_midpoint(a[0], a[1], a[2], points));
+			else if(p->symmetry > 0)
+				r = ceil(circle_reach_bresenham(a[0], a[1], a[2], points));
+			*xmin = a[0] - r;
+			*xmax = a[0] + r;
+			*ymin = a[1] - r;
+			*ymax = a[1] + r;
+			break;
+		}
+		case PRIM_ELLIPSE: {
+			// The second region may step past the major axis by up to the
+			// remaining height
+			int w = ABS(a[2]) + ABS(a[3]), h = ABS(a[3]);
+			*xmin = a[0] - w;
+			*xmax = a[0] + w;
+			*ymin = a[1] - h;
+			*ymax = a[1] + h;
+			break;
+		}
+	}
+	// Rounding of the intermediate points
+	*xmin -= 2;
+	*ymin -= 2;
+	*xmax += 2;
+	*ymax += 2;
+}
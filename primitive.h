@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+
+// A description of a single drawing call, so that the drawing can be
+// deferred, batched and distributed.
+
+typedef enum {
+	PRIM_LINE    = 1, // args : x1, y1, x2, y2
+	PRIM_CIRCLE  = 2, // args : x, y, radius
+	PRIM_ELLIPSE = 3  // args : x, y, major axis, minor axis
+} PrimitiveType;
+
+typedef enum {
+	ALGO_DDA       = 1,
+	ALGO_BRESENHAM = 2,
+	ALGO_MIDPOINT  = 3
+} PrimitiveAlgo;
+
+typedef struct {
+	u8  type;     // PrimitiveType
+	u8  algo;     // PrimitiveAlgo, ignored for the ellipses
+	u16 symmetry; // Point symmetry of the circles, 0 for the default
+	int args[4];
+} Primitive;
+
+// Whether the circle algorithms can draw with the point symmetry, a power
+// of 2 from 4 to 256. They never finish with some of the other ones.
+int primitive_symmetry_valid(int symmetry);
+// Draw the primitive on the canvas using the respective algorithm
+void primitive_draw(Canvas *cv, const Primitive *p);
+// Get the rectangle, in logical coordinates, which contains every pixel the
+// algorithm of the primitive plots. The bounds are conservative, as some of
+// the algorithms stray from the ideal shape.
+void primitive_bounds(const Primitive *p, int *xmin, int *ymin, int *xmax,
+                      int *ymax);
@@ -0,0 +1,47 @@
+#include <string.h>
+#include <time.h>
+
+#include "display.h"
+#include "profile.h"
+
+u8  profile_enabled                      = 0;
+u64 profile_counters[PROF_COUNTER_COUNT] = {0};
+u64 profile_timers[PROF_TIMER_COUNT]     = {0};
+
+static const char *counter_names[] = {
+    "put_pixel", "rejected",  "refresh",  "redraw",  "clear",  "transform",
+    "mat_new",   "mat_free",  "mat_mult", "mat_add", "mat_sub"};
+
+static const char *timer_names[] = {"redraw", "clear", "transform"};
+
+u64 profile_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+void profile_enable(int enable) {
+	memset(profile_counters, 0, sizeof(profile_counters));
+	memset(profile_timers, 0, sizeof(profile_timers));
+	profile_enabled = enable;
+}
+
+void profile_format(char *buf, siz size) {
+	siz len = 0;
+	for(int i = 0; i < PROF_COUNTER_COUNT && len < size; i++) {
+		len += snprintf(buf + len, size - len, "%-10s %12" Pu64 "\n",
+		                counter_names[i], profile_counters[i]);
+	}
+	for(int i = 0; i < PROF_TIMER_COUNT && len < size; i++) {
+		len += snprintf(buf + len, size - len, "%-10s %12.3f ms\n",
+		                timer_names[i], profile_timers[i] / 1e6);
+	}
+}
+
+void profile_dump() {
+	if(!profile_enabled)
+		return;
+	char buf[1024];
+	profile_format(buf, sizeof(buf));
+	pinfo("Profile :\n%s", buf);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "common.h"
+
+// Runtime profiling counters and timers of the driver and the matrix
+// library. They are always compiled in, but cost only a predictable branch
+// until profiling is enabled.
+
+typedef enum {
+	PROF_PUT_PIXEL = 0, // Pixels plotted
+	PROF_REJECTED,      // Pixels plotted outside of the screen
+	PROF_REFRESH,       // Screen refreshes
+	PROF_REDRAW,        // Full redraws of the screen
+	PROF_CLEAR,         // Screen clears
+	PROF_TRANSFORM,     // Transformations applied to the drawn pixels
+	PROF_MAT_NEW,       // Matrices created
+	PROF_MAT_FREE,      // Matrices released
+	PROF_MAT_MULT,      // Matrix multiplications
+	PROF_MAT_ADD,       // Matrix additions
+	PROF_MAT_SUB,       // Matrix subtractions
+	PROF_COUNTER_COUNT
+} ProfCounter;
+
+typedef enum {
+	PROF_TIME_REDRAW = 0, // Time spent in full redraws
+	PROF_TIME_CLEAR,      // Time spent clearing the screen
+	PROF_TIME_TRANSFORM,  // Time spent transforming the drawn pixels
+	PROF_TIMER_COUNT
+} ProfTimer;
+
+extern u8  profile_enabled;
+extern u64 profile_counters[PROF_COUNTER_COUNT];
+extern u64 profile_timers[PROF_TIMER_COUNT];
+
+// Monotonic time in nanoseconds
+u64 profile_now();
+
+#define prof_count(c)                                                \
+	do {                                                             \
+		if(profile_enabled)                                          \
+			__atomic_fetch_add(&profile_counters[c], 1,              \
+			                   __ATOMIC_RELAXED);                    \
+	} while(0)
+
+#define prof_add(c, n)                                               \
+	do {                                                             \
+		if(profile_enabled)                                          \
+			__atomic_fetch_add(&profile_counters[c], n,              \
+			                   __ATOMIC_RELAXED);                    \
+	} while(0)
+
+// Starts the timer 't' in the current scope, which must be stopped in the
+// same scope using prof_stop.
+#define prof_start(t) u64 prof_start_##t = profile_enabled ? profile_now() : 0
+
+#define prof_stop(t)                                                 \
+	do {                                                             \
+		if(profile_enabled)                                          \
+			__atomic_fetch_add(&profile_timers[t],                   \
+			                   profile_now() - prof_start_##t,       \
+			                   __ATOMIC_RELAXED);                    \
+	} while(0)
+
+// Enable or disable the profiling. Enabling resets all the values.
+void profile_enable(int enable);
+// Write the counters and timers as human readable text into the buffer
+void profile_format(char *buf, siz size);
+// Print the counters and timers to stdout
+void profile_dump();
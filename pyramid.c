@@ -0,0 +1,81 @@
+#include <memory.h>
+
+#include "pyramid.h"
+
+void pyramid_init(Pyramid *p, int rows, int cols) {
+	p->count   = 0;
+	p->version = 0;
+	p->valid   = 1;
+	rows       = (rows + (1 << PYRAMID_BASE) - 1) >> PYRAMID_BASE;
+	cols       = (cols + (1 << PYRAMID_BASE) - 1) >> PYRAMID_BASE;
+	while(p->count < PYRAMID_MAX_LEVELS) {
+		p->rows[p->count]   = rows;
+		p->cols[p->count]   = cols;
+		p->levels[p->count] = (u8 *)calloc((siz)rows * cols, sizeof(u8));
+		p->count++;
+		if(rows <= 1 && cols <= 1)
+			break;
+		rows = (rows + 1) / 2;
+		cols = (cols + 1) / 2;
+	}
+}
+
+void pyramid_free(Pyramid *p) {
+	for(int k = 0; k < p->count; k++) free(p->levels[k]);
+	p->count = 0;
+}
+
+void pyramid_clear(Pyramid *p) {
+	for(int k = 0; k < p->count; k++)
+		memset(p->levels[k], 0, (siz)p->rows[k] * p->cols[k]);
+}
+
+void pyramid_build(Pyramid *p, const u8 *pixels, int rows, int cols) {
+	pyramid_clear(p);
+	int whole = cols >> PYRAMID_BASE, size = 1 << PYRAMID_BASE;
+	for(int r = 0; r < rows; r++) {
+		const u8 *cells = &pixels[(siz)r * cols];
+		u8 *      block = &p->levels[0][(siz)(r >> PYRAMID_BASE) * p->cols[0]];
+		for(int b = 0; b < whole; b++) {
+			u64 word;
+			memcpy(&word, &cells[b * size], sizeof(word));
+			block[b] |= word != 0;
+		}
+		// The cells are 0 or 1, so they can be ORed in directly
+		for(int c = whole * size; c < cols; c++) block[whole] |= cells[c];
+	}
+	for(int k = 1; k < p->count; k++) {
+		for(int r = 0; r < p->rows[k - 1]; r++) {
+			const u8 *below = &p->levels[k - 1][(siz)r * p->cols[k - 1]];
+			u8 *      block = &p->levels[k][(siz)(r >> 1) * p->cols[k]];
+			for(int c = 0; c < p->cols[k - 1]; c++) block[c >> 1] |= below[c];
+		}
+	}
+}
+
+int pyramid_skip(const Pyramid *p, const u8 *pixels, int cols, int row,
+                 int col) {
+	const u8 *cells = &pixels[(siz)row * cols];
+	int       top   = PYRAMID_BASE + p->count - 1;
+	// log2 of the size of the blocks looked at, 0 for the cells
+	int k = PYRAMID_BASE;
+	while(col < cols) {
+		if(k == 0) {
+			if(cells[col])
+				return col;
+			col++;
+			if((col & ((1 << PYRAMID_BASE) - 1)) == 0)
+				k = PYRAMID_BASE;
+		} else if(*pyramid_block(p, k - PYRAMID_BASE, row, col)) {
+			// The block is lit, so its part from col is looked at in halves,
+			// and the cells of a block of the first level one by one
+			k = k == PYRAMID_BASE ? 0 : k - 1;
+			continue;
+		} else
+			col = ((col >> k) + 1) << k;
+		// If the next block starts a block of the level above, the larger
+		// block is looked at instead
+		while(k >= PYRAMID_BASE && k < top && ((col >> k) & 1) == 0) k++;
+	}
+	return cols;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "common.h"
+
+// An occupancy pyramid of a framebuffer, kept alongside it by the driver.
+// Level k has a byte per block of 2^(k + PYRAMID_BASE) by 2^(k +
+// PYRAMID_BASE) cells, which is non zero if any cell of the block is lit,
+// so every level is the OR of the 2x2 blocks of the one below, and the last
+// level is a single block covering the whole framebuffer. The scans of the
+// framebuffer walk down the pyramid, skipping all of an empty block at once.
+
+// log2 of the size of the blocks of the first level. The cells of a lit
+// block are looked at one by one, and a row of the cells of a block is read
+// as a single word when the pyramid is built.
+#define PYRAMID_BASE 3
+#define PYRAMID_MAX_LEVELS 32
+
+typedef struct {
+	int count; // Number of levels
+	int rows[PYRAMID_MAX_LEVELS], cols[PYRAMID_MAX_LEVELS];
+	u8 *levels[PYRAMID_MAX_LEVELS];
+	// Version of the framebuffer the levels describe, and whether they still
+	// do, kept by the owner of the framebuffer
+	u64 version;
+	u8  valid;
+} Pyramid;
+
+// The byte of the block of level k containing the cell at row, col
+#define pyramid_block(p, k, row, col)                                       \
+	(&(p)->levels[k][(siz)((row) >> ((k) + PYRAMID_BASE)) * (p)->cols[k] +  \
+	                 ((col) >> ((k) + PYRAMID_BASE))])
+
+// Allocate the empty pyramid of a framebuffer of the given rows and columns
+void pyramid_init(Pyramid *p, int rows, int cols);
+void pyramid_free(Pyramid *p);
+// Clear all the levels, as the framebuffer was
+void pyramid_clear(Pyramid *p);
+// Build all the levels again from the framebuffer of the given rows and
+// columns
+void pyramid_build(Pyramid *p, const u8 *pixels, int rows, int cols);
+// The first lit cell of the row at or after col, which starts a block of
+// the first level, walking down the pyramid. See pyramid_next_lit.
+int pyramid_skip(const Pyramid *p, const u8 *pixels, int cols, int row,
+                 int col);
+
+// Mark the cell at row, col as lit. The blocks are set from the bottom up,
+// and the marking stops at the first one which was already lit, as all of
+// the ones above it are then lit too. The bytes are accessed atomically, so
+// that different threads can mark the cells of different rows.
+static inline void pyramid_mark(Pyramid *p, int row, int col) {
+	for(int k = 0; k < p->count; k++) {
+		u8 *b = pyramid_block(p, k, row, col);
+		if(__atomic_load_n(b, __ATOMIC_RELAXED))
+			return;
+		__atomic_store_n(b, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// The first lit cell of the row at or after col, or cols if there is none.
+// The framebuffer has the given number of columns. The rest of the block of
+// the first level col is in is looked at directly.
+static inline int pyramid_next_lit(const Pyramid *p, const u8 *pixels,
+                                   int cols, int row, int col) {
+	const u8 *cells = &pixels[(siz)row * cols];
+	int       end   = ((col >> PYRAMID_BASE) + 1) << PYRAMID_BASE;
+	end             = end > cols ? cols : end;
+	for(; col < end; col++) {
+		if(cells[col])
+			return col;
+	}
+	return col < cols ? pyramid_skip(p, pixels, cols, row, col) : cols;
+}
@@ -0,0 +1,434 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "profile.h"
+#include "raster.h"
+
+#define ABS(x) ((x) < 0 ? -(x) : (x))
+#define ROUND(x) (int)((x) + 0.5)
+#define sqr(x) ((x) * (x))
+
+// The curves are stepped by adaptive forward differencing on exact integers.
+// The polynomial of each coordinate, (a t^3 + b t^2 + c t + d) / 2^den, is
+// scaled by 2^(3 * level + den), so that it takes integer values at every
+// multiple of 2^-level of t. Its forward differences are then integers for
+// any step of the form 2^-n with n <= level, and halving or doubling the
+// step is exact.
+#define CURVE_MAX_LEVEL 12
+
+typedef struct {
+	i64 f[2], d1[2], d2[2], d3[2]; // Value and differences of x and y
+	int shift;                     // Of the scale of the values
+	int step;                      // log2 of the step, in units of 2^-level
+	i64 u, end;                    // Parameter, in units of 2^-level
+} Curve;
+
+static inline int bits_of(u64 v) {
+	return v ? 64 - __builtin_clzll(v) : 0;
+}
+
+// Starts stepping the polynomial from t = 0, with coef[axis] = {a, b, c, d}
+static void curve_init(Curve *k, const i64 coef[2][4], int den) {
+	// Finest step, for which the curve moves at most a pixel along each
+	// axis, from the bound of the derivative |c| + 2|b| + 3|a|
+	u64 speed = 0, size = 0;
+	for(int i = 0; i < 2; i++) {
+		const i64 *e = coef[i];
+		u64 v = (ABS(e[2]) + 2 * ABS(e[1]) + 3 * ABS(e[0])) >> den;
+		u64 m = ABS(e[0]) + ABS(e[1]) + ABS(e[2]) + ABS(e[3]);
+		speed = v > speed ? v : speed;
+		size  = m > size ? m : size;
+	}
+	int level = bits_of(speed);
+	// The differences take up to 8 times the scaled size, within an i64
+	int room = (62 - den - 3 - bits_of(size)) / 3;
+	if(level > room)
+		level = room;
+	if(level > CURVE_MAX_LEVEL)
+		level = CURVE_MAX_LEVEL;
+	int l3   = 3 * level;
+	k->shift = l3 + den;
+	k->step  = level;
+	k->u     = 0;
+	k->end   = (i64)1 << level;
+	// The step is the whole curve, with the values a, b and c scaled by
+	// the cube of the step
+	for(int i = 0; i < 2; i++) {
+		i64 a = coef[i][0] * ((i64)1 << l3), b = coef[i][1] * ((i64)1 << l3);
+		i64 c = coef[i][2] * ((i64)1 << l3);
+		k->f[i]  = coef[i][3] * ((i64)1 << l3);
+		k->d1[i] = a + b + c;
+		k->d2[i] = 6 * a + 2 * b;
+		k->d3[i] = 6 * a;
+	}
+}
+
+static inline void curve_halve(Curve *k) {
+	for(int i = 0; i < 2; i++) {
+		k->d3[i] = k->d3[i] / 8;
+		k->d2[i] = k->d2[i] / 4 - k->d3[i];
+		k->d1[i] = (k->d1[i] - k->d2[i]) / 2;
+	}
+	k->step--;
+}
+
+static inline void curve_double(Curve *k) {
+	for(int i = 0; i < 2; i++) {
+		k->d1[i] = 2 * k->d1[i] + k->d2[i];
+		k->d2[i] = 4 * k->d2[i] + 4 * k->d3[i];
+		k->d3[i] = 8 * k->d3[i];
+	}
+	k->step++;
+}
+
+static inline void curve_advance(Curve *k) {
+	for(int i = 0; i < 2; i++) {
+		k->f[i] += k->d1[i];
+		k->d1[i] += k->d2[i];
+		k->d2[i] += k->d3[i];
+	}
+	k->u += (i64)1 << k->step;
+}
+
+// The pixel nearest to the scaled value
+static inline int curve_pixel(const Curve *k, i64 v) {
+	if(k->shift == 0)
+		return (int)v;
+	return (int)((v + ((i64)1 << (k->shift - 1))) >> k->shift);
+}
+
+// The control points are x, y pairs
+static void curve_bezier(Curve *k, const int *p, int degree) {
+	i64 coef[2][4];
+	for(int i = 0; i < 2; i++) {
+		i64 p0 = p[i], p1 = p[2 + i], p2 = p[4 + i];
+		if(degree == 2) {
+			coef[i][0] = 0;
+			coef[i][1] = p0 - 2 * p1 + p2;
+			coef[i][2] = 2 * (p1 - p0);
+		} else {
+			i64 p3     = p[6 + i];
+			coef[i][0] = -p0 + 3 * p1 - 3 * p2 + p3;
+			coef[i][1] = 3 * p0 - 6 * p1 + 3 * p2;
+			coef[i][2] = 3 * (p1 - p0);
+		}
+		coef[i][3] = p0;
+	}
+	curve_init(k, coef, 0);
+}
+
+// The segment of the spline from p1 to p2, each an x, y pair
+static void curve_catmull_rom(Curve *k, const int *p0, const int *p1,
+                              const int *p2, const int *p3) {
+	i64 coef[2][4];
+	for(int i = 0; i < 2; i++) {
+		coef[i][0] = -p0[i] + 3 * (i64)p1[i] - 3 * (i64)p2[i] + p3[i];
+		coef[i][1] = 2 * (i64)p0[i] - 5 * (i64)p1[i] + 4 * (i64)p2[i] - p3[i];
+		coef[i][2] = (i64)p2[i] - p0[i];
+		coef[i][3] = 2 * (i64)p1[i];
+	}
+	curve_init(k, coef, 1);
+}
+
+static inline void plot_count(RasterCount *s, int x, int y) {
+	(void)x;
+	(void)y;
+	s->pixel_count++;
+}
+
+static inline void plot_extent(RasterExtent *s, int x, int y) {
+	s->pixel_count++;
+	s->xmin = x < s->xmin ? x : s->xmin;
+	s->xmax = x > s->xmax ? x : s->xmax;
+	s->ymin = y < s->ymin ? y : s->ymin;
+	s->ymax = y > s->ymax ? y : s->ymax;
+}
+
+static inline void plot_bits(RasterBits *s, int x, int y) {
+	s->pixel_count++;
+	if((unsigned)x >= (unsigned)s->width || (unsigned)y >= (unsigned)s->height)
+		return;
+	siz bit = raster_bits_index(s, x, y);
+	s->bits[bit >> 6] |= 1ull << (bit & 63);
+}
+
+// The same as canvas_set_pixel for a canvas which is not on the terminal,
+// see the driver for the coordinates of the cells. The ID of the canvas is
+// recorded along with the pixel if 'ids' is set, which is a constant for
+// every sink, so the other one does not test for the ID buffer.
+static inline void plot_cell(Canvas *c, int x, int y, int ids) {
+	int row = c->rows - y - 1, col = x * 2 + 1;
+	if(c->clip_rows >= 0) {
+		// A view only counts the pixels inside of its rectangle
+		if(row < c->clip_row || row >= c->clip_row + c->clip_rows ||
+		   col < c->clip_col || col >= c->clip_col + c->clip_cols ||
+		   row > c->rows - 1 || col > c->cols - 1)
+			return;
+	} else if(col > c->cols - 1 || col < 0 || row < 0 || row > c->rows - 1) {
+		c->pixel_count++;
+		prof_count(PROF_PUT_PIXEL);
+		prof_count(PROF_REJECTED);
+		return;
+	}
+	c->pixel_count++;
+	prof_count(PROF_PUT_PIXEL);
+	c->pixels[(siz)row * c->cols + col] = 1;
+	if(ids)
+		c->ids[(siz)row * c->cols + col] = c->id;
+}
+
+static inline void plot_bytes(Canvas *c, int x, int y) {
+	plot_cell(c, x, y, 0);
+}
+
+static inline void plot_ids(Canvas *c, int x, int y) {
+	plot_cell(c, x, y, 1);
+}
+
+static inline void plot_terminal(Canvas *c, int x, int y) {
+	canvas_put_pixel(c, x, y);
+}
+
+static inline void span_count(RasterCount *s, int y, int x0, int x1) {
+	(void)y;
+	s->pixel_count += (i64)x1 - x0 + 1;
+}
+
+static inline void span_extent(RasterExtent *s, int y, int x0, int x1) {
+	plot_extent(s, x0, y);
+	plot_extent(s, x1, y);
+	s->pixel_count += (i64)x1 - x0 - 1;
+}
+
+static inline void span_bits(RasterBits *s, int y, int x0, int x1) {
+	s->pixel_count += (i64)x1 - x0 + 1;
+	if((unsigned)y >= (unsigned)s->height)
+		return;
+	x0 = x0 < 0 ? 0 : x0;
+	x1 = x1 >= s->width ? s->width - 1 : x1;
+	if(x0 > x1)
+		return;
+	// A row of the bitset is contiguous, so the span is filled a word at a
+	// time
+	siz from = raster_bits_index(s, x0, y), to = raster_bits_index(s, x1, y);
+	u64 first = ~0ull << (from & 63), last = ~0ull >> (63 - (to & 63));
+	if(from >> 6 == to >> 6) {
+		s->bits[from >> 6] |= first & last;
+		return;
+	}
+	s->bits[from >> 6] |= first;
+	for(siz w = (from >> 6) + 1; w < to >> 6; w++) s->bits[w] = ~0ull;
+	s->bits[to >> 6] |= last;
+}
+
+// The same as plot_cell for every pixel of the span, with the span clipped
+// to the canvas or the view once
+static inline void span_cells(Canvas *c, int y, int x0, int x1, int ids) {
+	int row = c->rows - y - 1, view = c->clip_rows >= 0;
+	int rmin = view ? c->clip_row : 0;
+	int rmax = view ? c->clip_row + c->clip_rows - 1 : c->rows - 1;
+	int cmin = view ? c->clip_col : 0;
+	int cmax = view ? c->clip_col + c->clip_cols - 1 : c->cols - 1;
+	rmax     = rmax > c->rows - 1 ? c->rows - 1 : rmax;
+	cmax     = cmax > c->cols - 1 ? c->cols - 1 : cmax;
+	// The cell of x is x * 2 + 1
+	int first = cmin / 2, last = cmax >= 1 ? (cmax - 1) / 2 : -1;
+	int lo = x0 < first ? first : x0, hi = x1 > last ? last : x1;
+	int inside = row < rmin || row > rmax || lo > hi ? 0 : hi - lo + 1;
+	if(!view) {
+		i64 plotted = (i64)x1 - x0 + 1;
+		c->pixel_count += plotted;
+		prof_add(PROF_PUT_PIXEL, plotted);
+		prof_add(PROF_REJECTED, plotted - inside);
+	} else {
+		c->pixel_count += inside;
+		prof_add(PROF_PUT_PIXEL, inside);
+	}
+	if(!inside)
+		return;
+	u8 *cells = &c->pixels[(siz)row * c->cols];
+	for(int x = lo; x <= hi; x++) cells[x * 2 + 1] = 1;
+	if(!ids)
+		return;
+	u32 *owners = &c->ids[(siz)row * c->cols];
+	for(int x = lo; x <= hi; x++) owners[x * 2 + 1] = c->id;
+}
+
+static inline void span_bytes(Canvas *c, int y, int x0, int x1) {
+	span_cells(c, y, x0, x1, 0);
+}
+
+static inline void span_ids(Canvas *c, int y, int x0, int x1) {
+	span_cells(c, y, x0, x1, 1);
+}
+
+// Clips the span to the columns of the canvas, and returns the number of
+// pixels cut off. A span may reach as far as i32_MAX, see stroke.c, so the
+// ones below step only through the pixels which can be on the canvas.
+static inline i64 span_columns(const Canvas *c, int *x0, int *x1) {
+	// The cell of x is x * 2 + 1
+	int last = c->cols >= 2 ? (c->cols - 2) / 2 : -1;
+	int lo = *x0 < 0 ? 0 : *x0, hi = *x1 > last ? last : *x1;
+	i64 off = (i64)*x1 - *x0 + 1 - (lo > hi ? 0 : (i64)hi - lo + 1);
+	*x0     = lo;
+	*x1     = hi;
+	return off;
+}
+
+// Counts the pixels of a span cut off by span_columns the same way as
+// canvas_put_pixel, for which a view does not count them
+static inline void count_outside(Canvas *c, i64 pixels) {
+	if(c->clip_rows >= 0)
+		return;
+	c->pixel_count += pixels;
+	prof_add(PROF_PUT_PIXEL, pixels);
+	prof_add(PROF_REJECTED, pixels);
+}
+
+static inline void span_terminal(Canvas *c, int y, int x0, int x1) {
+	count_outside(c, span_columns(c, &x0, &x1));
+	for(int x = x0; x <= x1; x++) canvas_put_pixel(c, x, y);
+}
+
+// The cell of the logical pixel on the canvas, or -1 if it is outside
+static inline i64 count_cell(const Canvas *c, int x, int y) {
+	int row = c->rows - y - 1, col = x * 2 + 1;
+	if(col > c->cols - 1 || col < 0 || row < 0 || row > c->rows - 1)
+		return -1;
+	return (i64)row * c->cols + col;
+}
+
+// The pixel is plotted on the canvas whether or not the cell was already
+// lit, so that it is counted, and the ID of the cell is updated
+static inline void plot_retain(RasterCounts *s, int x, int y) {
+	i64 cell = count_cell(s->canvas, x, y);
+	if(cell >= 0)
+		s->counts[cell]++;
+	if(s->canvas->terminal)
+		canvas_put_pixel(s->canvas, x, y);
+	else
+		plot_cell(s->canvas, x, y, s->canvas->ids != NULL);
+}
+
+static inline void plot_release(RasterCounts *s, int x, int y) {
+	i64 cell = count_cell(s->canvas, x, y);
+	if(cell < 0 || s->counts[cell] == 0)
+		return;
+	if(--s->counts[cell] == 0)
+		canvas_erase_pixel(s->canvas, x, y);
+	else if(s->canvas->ids && s->canvas->ids[cell] == s->id) {
+		s->canvas->ids[cell] = 0;
+		if(s->stale_count == s->stale_capacity) {
+			siz capacity = s->stale_capacity ? s->stale_capacity * 2 : 256;
+			s->stale     = (siz *)realloc(s->stale, sizeof(siz) * capacity);
+			s->stale_capacity = capacity;
+		}
+		s->stale[s->stale_count++] = (siz)cell;
+	}
+}
+
+static inline void plot_repair(RasterCounts *s, int x, int y) {
+	i64  cell = count_cell(s->canvas, x, y);
+	u32 *ids  = s->canvas->ids;
+	if(cell >= 0 && s->counts[cell] &&
+	   (ids[cell] == 0 || (ids[cell] & RASTER_REPAIRED)))
+		ids[cell] = s->canvas->id | RASTER_REPAIRED;
+}
+
+static inline void span_retain(RasterCounts *s, int y, int x0, int x1) {
+	count_outside(s->canvas, span_columns(s->canvas, &x0, &x1));
+	for(int x = x0; x <= x1; x++) plot_retain(s, x, y);
+}
+
+// The pixels outside of the canvas are neither released nor repaired
+static inline void span_release(RasterCounts *s, int y, int x0, int x1) {
+	span_columns(s->canvas, &x0, &x1);
+	for(int x = x0; x <= x1; x++) plot_release(s, x, y);
+}
+
+static inline void span_repair(RasterCounts *s, int y, int x0, int x1) {
+	span_columns(s->canvas, &x0, &x1);
+	for(int x = x0; x <= x1; x++) plot_repair(s, x, y);
+}
+
+// The rows of the canvas or of the rectangle of the view. The pixels of the
+// rest of the rows are not counted.
+static inline void rows_canvas(const Canvas *c, int *ymin, int *ymax) {
+	int rmin = 0, rmax = c->rows - 1;
+	if(c->clip_rows >= 0) {
+		rmin = c->clip_row;
+		rmax = c->clip_row + c->clip_rows - 1;
+		rmax = rmax > c->rows - 1 ? c->rows - 1 : rmax;
+	}
+	// The row of y is rows - y - 1
+	int lo = c->rows - rmax - 1, hi = c->rows - rmin - 1;
+	*ymin  = *ymin > lo ? *ymin : lo;
+	*ymax  = *ymax < hi ? *ymax : hi;
+}
+
+static inline void rows_counts(const RasterCounts *s, int *ymin, int *ymax) {
+	rows_canvas(s->canvas, ymin, ymax);
+}
+
+#define RASTER_SINK count
+#define RASTER_TYPE RasterCount
+#define RASTER_PLOT plot_count
+#define RASTER_SPAN span_count
+#define RASTER_ROWS(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK extent
+#define RASTER_TYPE RasterExtent
+#define RASTER_PLOT plot_extent
+#define RASTER_SPAN span_extent
+#define RASTER_ROWS(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK bits
+#define RASTER_TYPE RasterBits
+#define RASTER_PLOT plot_bits
+#define RASTER_SPAN span_bits
+#define RASTER_ROWS(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK bytes
+#define RASTER_TYPE Canvas
+#define RASTER_PLOT plot_bytes
+#define RASTER_SPAN span_bytes
+#define RASTER_ROWS(s, ymin, ymax) rows_canvas(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK ids
+#define RASTER_TYPE Canvas
+#define RASTER_PLOT plot_ids
+#define RASTER_SPAN span_ids
+#define RASTER_ROWS(s, ymin, ymax) rows_canvas(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK terminal
+#define RASTER_TYPE Canvas
+#define RASTER_PLOT plot_terminal
+#define RASTER_SPAN span_terminal
+#define RASTER_ROWS(s, ymin, ymax) rows_canvas(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK retain
+#define RASTER_TYPE RasterCounts
+#define RASTER_PLOT plot_retain
+#define RASTER_SPAN span_retain
+#define RASTER_ROWS(s, ymin, ymax) rows_counts(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK release
+#define RASTER_TYPE RasterCounts
+#define RASTER_PLOT plot_release
+#define RASTER_SPAN span_release
+#define RASTER_ROWS(s, ymin, ymax) rows_counts(s, ymin, ymax)
+#include "raster_template.h"
+
+#define RASTER_SINK repair
+#define RASTER_TYPE RasterCounts
+#define RASTER_PLOT plot_repair
+#define RASTER_SPAN span_repair
+#define RASTER_ROWS(s, ymin, ymax) rows_counts(s, ymin, ymax)
+#include "raster_template.h"
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+#include "stroke.h"
+
+// The line, circle, ellipse, curve and stroke algorithms, compiled once for
+// every kind of sink the pixels are plotted on, from raster_template.h. The
+// plotting of a pixel is inlined into the inner loop of each algorithm
+// instead of going through put_pixel, and every sink plots exactly the same
+// pixels. The one exception is a stroke drawn on a canvas: only the rows of
+// the canvas, or of the rectangle of a view, are scanned. The pixels of the
+// rest of the rows are not counted, so that a stroke far longer than the
+// canvas takes time only for the rows which are seen. The count, extent and
+// bits sinks count every row.
+//
+//   count    : only counts the pixels, RasterCount
+//   extent   : the rectangle of the pixels, RasterExtent
+//   bits     : a bitset of logical pixels, RasterBits
+//   bytes    : the framebuffer of a canvas or a view which is not displayed,
+//              with the same result as canvas_put_pixel
+//   ids      : the same as bytes, for a canvas with an ID buffer
+//   terminal : canvas_put_pixel, which also draws the pixels on the terminal
+//   retain   : the reference counts of the cells of a canvas, RasterCounts,
+//              lighting the cells which were not lit by any primitive
+//   release  : the reverse of retain, erasing the cells which are not lit
+//              by any primitive anymore
+//   repair   : gives the cells of the ID buffer of a RasterCounts which were
+//              emptied by release the ID of the canvas, marking them with
+//              RASTER_REPAIRED
+//
+// The draw_* functions and primitive_draw pick the bytes, the ids or the
+// terminal sink depending on the canvas.
+
+// Counts the pixels plotted by the primitives, without drawing them
+typedef struct {
+	u64 pixel_count;
+} RasterCount;
+
+// The rectangle containing the pixels plotted by the primitives, empty, with
+// the minimum above the maximum, until a pixel is plotted
+typedef struct {
+	int xmin, ymin, xmax, ymax;
+	u64 pixel_count;
+} RasterExtent;
+
+#define raster_extent_empty() {i32_MAX, i32_MAX, i32_MIN, i32_MIN, 0}
+
+// A bitset of logical pixels, one bit per pixel, row major from the top left
+// corner like the framebuffer of a canvas
+typedef struct {
+	u64 *bits; // raster_bits_words(width, height) words
+	int  width, height;
+	u64  pixel_count; // Pixels plotted, including the ones outside of it
+} RasterBits;
+
+// The number of pixels plotted on every cell of a canvas by the primitives
+// retained on it, see retained.h. A cell is lit while its count is non zero,
+// and as a primitive plots the same pixels whenever it is rasterized, the
+// release sink takes the pixels of a primitive back out exactly.
+typedef struct {
+	Canvas *canvas; // Not a view
+	u32 *   counts;
+	u32     id;    // Value of the ID buffer release empties, plus one
+	siz *   stale; // Cells emptied by release which are still lit
+	siz     stale_count, stale_capacity; // The list grows with realloc
+} RasterCounts;
+
+// Set on the cells of the ID buffer written by the repair sink, which may be
+// written again by a later primitive
+#define RASTER_REPAIRED 0x80000000u
+
+#define raster_bits_words(width, height) (((siz)(width) * (height) + 63) / 64)
+// Whether the logical pixel at x, y of the bitset is set
+#define raster_bits_get(b, x, y)                                            \
+	(((b)->bits[raster_bits_index(b, x, y) >> 6] >>                         \
+	  (raster_bits_index(b, x, y) & 63)) &                                  \
+	 1)
+#define raster_bits_index(b, x, y)                                          \
+	((siz)((b)->height - (y)-1) * (b)->width + (x))
+
+// Call the rasterizer 'fn' of the bytes, the ids or the terminal sink,
+// depending on whether the canvas is displayed and has an ID buffer, for
+// example
+//   raster_canvas(c, line_bresenham, x1, y1, x2, y2);
+#define raster_canvas(c, fn, ...)                                           \
+	((c)->terminal ? raster_##fn##_terminal(c, __VA_ARGS__)                 \
+	               : (c)->ids ? raster_##fn##_ids(c, __VA_ARGS__)           \
+	                          : raster_##fn##_bytes(c, __VA_ARGS__))
+
+#define RASTER_CAT_(a, b) a##_##b
+#define RASTER_CAT(a, b) RASTER_CAT_(a, b)
+
+#define RASTER_DECLARE(sink, type)                                          \
+	void raster_line_dda_##sink(type *s, int x1, int y1, int x2, int y2);   \
+	void raster_line_bresenham_##sink(type *s, int x1, int y1, int x2,      \
+	                                  int y2);                              \
+	void raster_line_midpoint_##sink(type *s, int x1, int y1, int x2,       \
+	                                 int y2);                               \
+	void raster_circle_bresenham_##sink(type *s, int x, int y, int r);      \
+	void raster_circle_bresenham_n_point_##sink(type *s, int x, int y,      \
+	                                            int r, int points);         \
+	void raster_circle_midpoint_##sink(type *s, int x, int y, int r,        \
+	                                   int points);                         \
+	void raster_ellipse_midpoint_##sink(type *s, int c, int d, int a,       \
+	                                    int b);                             \
+	void raster_bezier_quadratic_##sink(type *s, const int *points);       \
+	void raster_bezier_cubic_##sink(type *s, const int *points);           \
+	void raster_catmull_rom_##sink(type *s, const int *points, int count); \
+	void raster_stroke_##sink(type *s, const int *points, int count,        \
+	                          int width, StrokeJoin join, StrokeCap cap);   \
+	void raster_primitive_##sink(type *s, const Primitive *p);
+
+RASTER_DECLARE(count, RasterCount)
+RASTER_DECLARE(extent, RasterExtent)
+RASTER_DECLARE(bits, RasterBits)
+RASTER_DECLARE(bytes, Canvas)
+RASTER_DECLARE(ids, Canvas)
+RASTER_DECLARE(terminal, Canvas)
+RASTER_DECLARE(retain, RasterCounts)
+RASTER_DECLARE(release, RasterCounts)
+RASTER_DECLARE(repair, RasterCounts)
@@ -0,0 +1,389 @@
+// The rasterizers of raster.h, for a single sink. This file is included once
+// per sink, after defining :
+//   RASTER_SINK            : name of the sink, appended to every function
+//   RASTER_TYPE            : type of the sink the functions draw on
+//   RASTER_PLOT(s, x, y)   : plot the logical pixel at x, y on the sink s,
+//                            an inline function taking the coordinates as
+//                            int
+//   RASTER_SPAN(s, y, a, b): plot the pixels of the row y from x = a to b
+//   RASTER_ROWS(s, a, b)   : narrow the rows from *a to *b to the ones of
+//                            the sink a span can be seen on, or leave
+//                            them as they are if it counts every pixel
+// which are undefined at the end.
+
+#define RASTER_FN(name) RASTER_CAT(name, RASTER_SINK)
+
+void RASTER_FN(raster_line_dda)(RASTER_TYPE *cv, int x1, int y1, int x2,
+                                int y2) {
+	int dx = x2 - x1;
+	int dy = y2 - y1;
+
+	int adx = ABS(dx);
+	int ady = ABS(dy);
+
+	int steps;
+
+	if(adx > ady)
+		steps = adx;
+	else
+		steps = ady;
+
+	double xinc = (double)adx / steps;
+	double yinc = (double)ady / steps;
+
+	double x = x1, y = y1;
+
+	RASTER_PLOT(cv, x1, y1);
+
+#ifdef ENHANCED_DDA
+	for(; x < x2;) {
+#else
+	for(int i = 0; i < dx; i++) {
+#endif
+		x = x + xinc;
+		y = y + yinc;
+		RASTER_PLOT(cv, ROUND(x), ROUND(y));
+	}
+}
+
+void RASTER_FN(raster_line_bresenham)(RASTER_TYPE *cv, int x1, int y1,
+                                      int x2, int y2) {
+	int dy = ABS(y1 - y2);
+	int dx = ABS(x1 - x2);
+	int x  = x1;
+	int y  = y1;
+
+	RASTER_PLOT(cv, x, y);
+
+	int p = 2 * dy - dx;
+	for(int i = 0; i < dx; i++) {
+		if(x < x2)
+			x++;
+		else
+			x--;
+
+		if(p >= 0) {
+			if(y < y2)
+				y++;
+			else
+				y--;
+			p = p + 2 * (dy - dx);
+		} else
+			p = p + 2 * dy;
+
+		RASTER_PLOT(cv, x, y);
+	}
+}
+
+void RASTER_FN(raster_line_midpoint)(RASTER_TYPE *cv, int x1, int y1,
+                                     int x2, int y2) {
+	int    dy = ABS(y2 - y1);
+	int    dx = ABS(x2 - x1);
+	int    a  = dy;
+	int    b  = -dx;
+	double x  = x1;
+	double y  = y1;
+
+	RASTER_PLOT(cv, x, y);
+	double p = a + (double)(b / 2);
+
+	while(x < x2) {
+		if(p < 0) {
+			p = p + a + b;
+			y += 1.5;
+		} else {
+			p = p + a;
+			y += 0.5;
+		}
+		x++;
+		RASTER_PLOT(cv, x, y);
+	}
+}
+
+static inline void RASTER_FN(circle_8_points)(RASTER_TYPE *cv, int a, int b,
+                                              int xd, int yd) {
+	int x = xd - a;
+	int y = yd - b;
+
+	RASTER_PLOT(cv, a + x, b + y);
+	RASTER_PLOT(cv, a - x, b + y);
+	RASTER_PLOT(cv, a - x, b - y);
+	RASTER_PLOT(cv, a + x, b - y);
+
+	RASTER_PLOT(cv, a + y, b + x);
+	RASTER_PLOT(cv, a - y, b + x);
+	RASTER_PLOT(cv, a - y, b - x);
+	RASTER_PLOT(cv, a + y, b - x);
+}
+
+void RASTER_FN(raster_circle_bresenham)(RASTER_TYPE *cv, int a, int b,
+                                        int r) {
+	int x = a;
+	int y = b + r;
+	RASTER_FN(circle_8_points)(cv, a, b, x, y);
+	int p = 3 - 2 * r;
+	while((y - b) > (x - a)) {
+		x++;
+		if(p < 0)
+			p = p + 4 * x + 6;
+		else {
+			y--;
+			p = p + 4 * (x - y) + 10;
+		}
+		RASTER_FN(circle_8_points)(cv, a, b, x, y);
+	}
+}
+
+static void RASTER_FN(circle_n_points)(RASTER_TYPE *cv, int a, int b, int x,
+                                       int y, int points) {
+	// Find distance of x, y from the centre
+	double nx = x - a;
+	double ny = y - b;
+
+	RASTER_PLOT(cv, a + nx, b + ny);
+
+	double delta = 360 / points;
+
+	for(double theta = delta; theta < 360; theta += delta) {
+		double thetar = (-theta) * M_PI / 180;
+
+		// The axis with centre at (a, b) rotated by theta,
+		// hence new points :
+		double xd = nx * cos(thetar) + ny * sin(thetar);
+		double yd = -nx * sin(thetar) + ny * cos(thetar);
+
+		// Reflected points
+		double rx = -xd;
+		double ry = yd;
+
+		// Now transform back the reflected points
+		// to the actual axis with centre at (a, b)
+		// by -theta rotation
+		double finx = rx * cos(-thetar) + ry * sin(-thetar);
+		double finy = -rx * sin(-thetar) + ry * cos(-thetar);
+
+		// Finally, draw the final points
+		RASTER_PLOT(cv, a + round(finx), b + round(finy));
+
+		nx = finx;
+		ny = finy;
+	}
+}
+
+void RASTER_FN(raster_circle_bresenham_n_point)(RASTER_TYPE *cv, int a,
+                                                int b, int r, int points) {
+	double x = a;
+	double y = b + r;
+
+	RASTER_FN(circle_n_points)(cv, a, b, x, y, points);
+
+	double p = 3 - 2 * r;
+
+	double theta         = (90 - (360 / points)) * (M_PI / 180);
+	double expectedSlope = tan(theta);
+
+	do {
+		x++;
+		if(p < 0)
+			p = p + 4 * x + 6;
+		else {
+			y--;
+			p = p + 4 * (x - y) + 10;
+		}
+		RASTER_FN(circle_n_points)(cv, a, b, x, y, points);
+	} while((y - b) / (x - a) > expectedSlope);
+}
+
+void RASTER_FN(raster_circle_midpoint)(RASTER_TYPE *cv, int a, int b, int r,
+                                       int points) {
+	int x = a;
+	int y = b + r;
+
+	RASTER_FN(circle_n_points)(cv, a, b, x, y, points);
+
+	int p = 1 - r;
+
+	double theta         = (90 - (360 / points)) * (M_PI / 180);
+	double expectedSlope = tan(theta);
+
+	do {
+		x++;
+		if(p < 0) {
+			p = p + 2 * x + 3;
+		} else {
+			y--;
+			p = p + 2 * (x - y) + 5;
+		}
+		RASTER_FN(circle_n_points)(cv, a, b, x, y, points);
+
+	} while((double)(y - b) / (x - a) > expectedSlope);
+}
+
+// Plotting points in 4 point symmetry
+static inline void RASTER_FN(ellipse_points)(RASTER_TYPE *cv, int a, int b,
+                                             int x, int y) {
+	RASTER_PLOT(cv, a + x, b + y);
+	RASTER_PLOT(cv, a - x, b + y);
+	RASTER_PLOT(cv, a + x, b - y);
+	RASTER_PLOT(cv, a - x, b - y);
+}
+
+// c,d are the centre
+void RASTER_FN(raster_ellipse_midpoint)(RASTER_TYPE *cv, int c, int d,
+                                        int a, int b) {
+	double x = 0;
+	double y = b;
+	RASTER_FN(ellipse_points)(cv, c, d, x, y);
+	double p = sqr(b) + sqr(a) * ((double)a - 0.5) - sqr((double)a * b);
+	int    terminator = 0;
+	do {
+		x++;
+		if(p < 0)
+			p = p + sqr(b) * (2 * x + 3);
+		else {
+			y--;
+			p = p + sqr(b) * (2 * x + 3) + sqr(a) * (-2 * y + 2);
+		}
+		RASTER_FN(ellipse_points)(cv, c, d, x, y);
+
+		// Without the y check, the region runs away below the major axis
+		// for flat ellipses
+		terminator = y > 0 && sqr(b * (x + 1)) < sqr(a * (y - 0.5));
+	} while(terminator);
+
+	while(y > 0) {
+		y--;
+		if(p < 0)
+			p = p + sqr(a) * (-2 * y + 2);
+		else {
+			x++;
+			p = p + sqr(b) * (2 * x + 2) + sqr(a) * (-2 * y + 3);
+		}
+		RASTER_FN(ellipse_points)(cv, c, d, x, y);
+	}
+}
+
+// Steps the curve to its end, see raster.c. The step is halved while it
+// would move by more than a pixel along either axis, and doubled after it
+// moved by less than half a pixel along both, so every pixel along the curve
+// is plotted once, in about a step each. The start is only plotted if
+// 'first' is set.
+static void RASTER_FN(raster_curve)(RASTER_TYPE *cv, Curve curve, u8 first) {
+	// A local copy, which the pixels written by the sink cannot alias, so
+	// that it stays in the registers
+	Curve *k   = &curve;
+	i64    one = (i64)1 << k->shift, half = one >> 1;
+	int x = curve_pixel(k, k->f[0]), y = curve_pixel(k, k->f[1]);
+	if(first)
+		RASTER_PLOT(cv, x, y);
+	while(k->u < k->end) {
+		while((ABS(k->d1[0]) > one || ABS(k->d1[1]) > one) && k->step > 0)
+			curve_halve(k);
+		curve_advance(k);
+		int nx = curve_pixel(k, k->f[0]), ny = curve_pixel(k, k->f[1]);
+		if(nx != x || ny != y) {
+			// Only the longest of the curves may still jump at the finest
+			// step, which is bridged diagonally
+			while(ABS(nx - x) > 1 || ABS(ny - y) > 1) {
+				x += (nx > x) - (nx < x);
+				y += (ny > y) - (ny < y);
+				RASTER_PLOT(cv, x, y);
+			}
+			x = nx;
+			y = ny;
+			RASTER_PLOT(cv, x, y);
+		}
+		// Doubling keeps the parameter a multiple of the step, so that the
+		// end is reached exactly
+		if(ABS(k->d1[0]) < half && ABS(k->d1[1]) < half &&
+		   (k->u & (((i64)2 << k->step) - 1)) == 0)
+			curve_double(k);
+	}
+}
+
+void RASTER_FN(raster_bezier_quadratic)(RASTER_TYPE *cv, const int *points) {
+	Curve k;
+	curve_bezier(&k, points, 2);
+	RASTER_FN(raster_curve)(cv, k, 1);
+}
+
+void RASTER_FN(raster_bezier_cubic)(RASTER_TYPE *cv, const int *points) {
+	Curve k;
+	curve_bezier(&k, points, 3);
+	RASTER_FN(raster_curve)(cv, k, 1);
+}
+
+void RASTER_FN(raster_catmull_rom)(RASTER_TYPE *cv, const int *points,
+                                   int count) {
+	if(count == 1)
+		RASTER_PLOT(cv, points[0], points[1]);
+	for(int i = 0; i + 1 < count; i++) {
+		// The first and the last points are repeated, so that the spline
+		// reaches them
+		const int *p0 = &points[2 * (i > 0 ? i - 1 : 0)];
+		const int *p3 = &points[2 * (i + 2 < count ? i + 2 : count - 1)];
+		Curve      k;
+		curve_catmull_rom(&k, p0, &points[2 * i], &points[2 * i + 2], p3);
+		RASTER_FN(raster_curve)(cv, k, i == 0);
+	}
+}
+
+// The stroke is scanned a band of rows at a time, so that the memory it
+// takes does not follow its length
+void RASTER_FN(raster_stroke)(RASTER_TYPE *cv, const int *points, int count,
+                              int width, StrokeJoin join, StrokeCap cap) {
+	int ymin, ymax;
+	if(!stroke_rows(points, count, width, &ymin, &ymax))
+		return;
+	RASTER_ROWS(cv, &ymin, &ymax);
+	for(i64 y = ymin; y <= ymax; y += STROKE_BAND_ROWS) {
+		i64   last = y + STROKE_BAND_ROWS - 1 < ymax ? y + STROKE_BAND_ROWS - 1
+		                                             : ymax;
+		const Span *spans;
+		siz n = stroke_spans(points, count, width, join, cap, (int)y,
+		                     (int)last, &spans);
+		for(siz i = 0; i < n; i++)
+			RASTER_SPAN(cv, spans[i].y, spans[i].x0, spans[i].x1);
+	}
+}
+
+void RASTER_FN(raster_primitive)(RASTER_TYPE *cv, const Primitive *p) {
+	const int *a = p->args;
+	switch(p->type) {
+		case PRIM_LINE:
+			switch(p->algo) {
+				case ALGO_DDA:
+					RASTER_FN(raster_line_dda)(cv, a[0], a[1], a[2], a[3]);
+					break;
+				case ALGO_BRESENHAM:
+					RASTER_FN(raster_line_bresenham)
+					(cv, a[0], a[1], a[2], a[3]);
+					break;
+				case ALGO_MIDPOINT:
+					RASTER_FN(raster_line_midpoint)(cv, a[0], a[1], a[2], a[3]);
+					break;
+			}
+			break;
+		case PRIM_CIRCLE: {
+			int points = p->symmetry == 0 ? 4 : p->symmetry;
+			if(p->algo == ALGO_MIDPOINT)
+				RASTER_FN(raster_circle_midpoint)(cv, a[0], a[1], a[2], points);
+			else if(p->symmetry > 0)
+				RASTER_FN(raster_circle_bresenham_n_point)
+				(cv, a[0], a[1], a[2], points);
+			else
+				RASTER_FN(raster_circle_bresenham)(cv, a[0], a[1], a[2]);
+			break;
+		}
+		case PRIM_ELLIPSE:
+			RASTER_FN(raster_ellipse_midpoint)(cv, a[0], a[1], a[2], a[3]);
+			break;
+	}
+}
+
+#undef RASTER_FN
+#undef RASTER_SINK
+#undef RASTER_TYPE
+#undef RASTER_PLOT
+#undef RASTER_SPAN
+#undef RASTER_ROWS
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+
+#include "raster.h"
+#include "retained.h"
+
+Retained *retained_new(Canvas *c) {
+	Retained *r       = (Retained *)malloc(sizeof(Retained));
+	r->canvas         = c;
+	r->counts         = (u32 *)calloc((siz)c->rows * c->cols, sizeof(u32));
+	r->prims          = NULL;
+	r->order          = NULL;
+	r->bounds         = NULL;
+	r->seen           = NULL;
+	r->count          = 0;
+	r->capacity       = 0;
+	r->unused         = NULL;
+	r->unused_count   = 0;
+	r->clock          = 0;
+	r->repairs        = 0;
+	r->bin_cols       = (c->cols / 2 - 1) / RETAINED_BIN_SIZE + 1;
+	r->bin_rows       = (c->rows - 1) / RETAINED_BIN_SIZE + 1;
+	r->bins           = (RetainedBin *)calloc((siz)r->bin_cols * r->bin_rows,
+	                                          sizeof(RetainedBin));
+	r->large.handles  = NULL;
+	r->large.count    = 0;
+	r->large.capacity = 0;
+	r->stale          = NULL;
+	r->stale_capacity = 0;
+	canvas_clear(c);
+	return r;
+}
+
+void retained_free(Retained *r) {
+	for(siz b = 0; b < (siz)r->bin_cols * r->bin_rows; b++)
+		free(r->bins[b].handles);
+	free(r->bins);
+	free(r->large.handles);
+	free(r->counts);
+	free(r->prims);
+	free(r->order);
+	free(r->bounds);
+	free(r->seen);
+	free(r->unused);
+	free(r->stale);
+	free(r);
+}
+
+static void bin_add(RetainedBin *b, u32 handle) {
+	if(b->count == b->capacity) {
+		b->capacity = b->capacity ? b->capacity * 2 : 8;
+		b->handles  = (u32 *)realloc(b->handles, sizeof(u32) * b->capacity);
+	}
+	b->handles[b->count++] = handle;
+}
+
+static void bin_remove(RetainedBin *b, u32 handle) {
+	for(u32 k = 0; k < b->count; k++) {
+		if(b->handles[k] == handle) {
+			b->handles[k] = b->handles[--b->count];
+			return;
+		}
+	}
+}
+
+// Computes the range of bins overlapped by the bounds of the primitive.
+// Returns -1 if it is outside of the canvas, and 0 if it is a large one.
+static int retained_range(const Retained *r, u32 handle, int *c0, int *r0,
+                          int *c1, int *r1) {
+	const int *b     = &r->bounds[(siz)handle * 4];
+	int        width = r->canvas->cols / 2, height = r->canvas->rows;
+	if(b[0] > width - 1 || b[2] < 0 || b[1] > height - 1 || b[3] < 0)
+		return -1;
+	*c0 = (b[0] < 0 ? 0 : b[0]) >> RETAINED_BIN_SHIFT;
+	*r0 = (b[1] < 0 ? 0 : b[1]) >> RETAINED_BIN_SHIFT;
+	*c1 = (b[2] > width - 1 ? width - 1 : b[2]) >> RETAINED_BIN_SHIFT;
+	*r1 = (b[3] > height - 1 ? height - 1 : b[3]) >> RETAINED_BIN_SHIFT;
+	return (*c1 - *c0 + 1) * (*r1 - *r0 + 1) <= SPATIAL_MAX_SPAN;
+}
+
+static void retained_bin(Retained *r, u32 handle) {
+	int c0, r0, c1, r1;
+	int binned = retained_range(r, handle, &c0, &r0, &c1, &r1);
+	if(binned < 0)
+		return;
+	if(!binned) {
+		bin_add(&r->large, handle);
+		return;
+	}
+	for(int row = r0; row <= r1; row++)
+		for(int col = c0; col <= c1; col++)
+			bin_add(&r->bins[(siz)row * r->bin_cols + col], handle);
+}
+
+static void retained_unbin(Retained *r, u32 handle) {
+	int c0, r0, c1, r1;
+	int binned = retained_range(r, handle, &c0, &r0, &c1, &r1);
+	if(binned < 0)
+		return;
+	if(!binned) {
+		bin_remove(&r->large, handle);
+		return;
+	}
+	for(int row = r0; row <= r1; row++)
+		for(int col = c0; col <= c1; col++)
+			bin_remove(&r->bins[(siz)row * r->bin_cols + col], handle);
+}
+
+static RasterCounts retained_sink(Retained *r, u32 handle) {
+	RasterCounts s = {r->canvas, r->counts, handle + 1, r->stale, 0,
+	                  r->stale_capacity};
+	return s;
+}
+
+static void retained_draw(Retained *r, u32 handle) {
+	RasterCounts s = retained_sink(r, handle);
+	int *        b = &r->bounds[(siz)handle * 4];
+	primitive_bounds(&r->prims[handle], &b[0], &b[1], &b[2], &b[3]);
+	retained_bin(r, handle);
+	canvas_set_id(r->canvas, handle);
+	raster_primitive_retain(&s, &r->prims[handle]);
+	r->order[handle] = ++r->clock;
+}
+
+typedef struct {
+	u64 order;
+	u32 handle;
+} Drawn;
+
+static int compare_drawn(const void *a, const void *b) {
+	u64 x = ((const Drawn *)a)->order, y = ((const Drawn *)b)->order;
+	return (x > y) - (x < y);
+}
+
+// Adds the primitives of the bin whose bounds intersect the rectangle to
+// found, if they were not already
+static void repair_collect(Retained *r, const RetainedBin *bin,
+                           const int *rect, Drawn **found, u32 *n,
+                           u32 *capacity) {
+	for(u32 k = 0; k < bin->count; k++) {
+		u32        h = bin->handles[k];
+		const int *b = &r->bounds[(siz)h * 4];
+		if(r->seen[h] == r->repairs || b[0] > rect[2] || b[2] < rect[0] ||
+		   b[1] > rect[3] || b[3] < rect[1])
+			continue;
+		r->seen[h] = r->repairs;
+		if(*n == *capacity) {
+			*capacity = *capacity ? *capacity * 2 : 64;
+			*found    = (Drawn *)realloc(*found, sizeof(Drawn) * *capacity);
+		}
+		(*found)[*n].order      = r->order[h];
+		(*found)[(*n)++].handle = h;
+	}
+}
+
+// Gives the stale cells of the ID buffer, emptied by the removal of a
+// primitive, the ID of the last of the other primitives drawn on them. Only
+// the primitives binned with the stale cells are rasterized again.
+static void retained_repair(Retained *r, siz stale_count) {
+	Canvas *c = r->canvas;
+	// The rectangle of the stale cells in logical coordinates
+	int rect[4] = {i32_MAX, i32_MAX, i32_MIN, i32_MIN};
+	for(siz k = 0; k < stale_count; k++) {
+		int x   = (int)(r->stale[k] % c->cols) / 2;
+		int y   = c->rows - (int)(r->stale[k] / c->cols) - 1;
+		rect[0] = x < rect[0] ? x : rect[0];
+		rect[1] = y < rect[1] ? y : rect[1];
+		rect[2] = x > rect[2] ? x : rect[2];
+		rect[3] = y > rect[3] ? y : rect[3];
+	}
+	r->repairs++;
+	Drawn *found = NULL;
+	u32    n = 0, capacity = 0;
+	for(siz k = 0; k < stale_count; k++) {
+		int x   = (int)(r->stale[k] % c->cols) / 2;
+		int y   = c->rows - (int)(r->stale[k] / c->cols) - 1;
+		siz bin = (siz)(y >> RETAINED_BIN_SHIFT) * r->bin_cols +
+		          (x >> RETAINED_BIN_SHIFT);
+		if(r->bins[bin].seen == r->repairs)
+			continue;
+		r->bins[bin].seen = r->repairs;
+		repair_collect(r, &r->bins[bin], rect, &found, &n, &capacity);
+	}
+	repair_collect(r, &r->large, rect, &found, &n, &capacity);
+	qsort(found, n, sizeof(Drawn), compare_drawn);
+	for(u32 k = 0; k < n; k++) {
+		RasterCounts s = retained_sink(r, found[k].handle);
+		canvas_set_id(c, found[k].handle);
+		raster_primitive_repair(&s, &r->prims[found[k].handle]);
+	}
+	free(found);
+	// Only the stale cells were repaired
+	for(siz k = 0; k < stale_count; k++)
+		c->ids[r->stale[k]] &= ~RASTER_REPAIRED;
+}
+
+// Takes the pixels of the primitive back out of the canvas
+static void retained_erase(Retained *r, u32 handle) {
+	RasterCounts s = retained_sink(r, handle);
+	raster_primitive_release(&s, &r->prims[handle]);
+	r->stale          = s.stale;
+	r->stale_capacity = s.stale_capacity;
+	retained_unbin(r, handle);
+	r->order[handle] = 0;
+	if(s.stale_count)
+		retained_repair(r, s.stale_count);
+}
+
+u32 retained_add(Retained *r, const Primitive *p) {
+	u32 handle;
+	if(r->unused_count)
+		handle = r->unused[--r->unused_count];
+	else {
+		if(r->count == r->capacity) {
+			r->capacity = r->capacity ? r->capacity * 2 : 16;
+			r->prims =
+			    (Primitive *)realloc(r->prims, sizeof(Primitive) * r->capacity);
+			r->order  = (u64 *)realloc(r->order, sizeof(u64) * r->capacity);
+			r->bounds =
+			    (int *)realloc(r->bounds, sizeof(int) * 4 * r->capacity);
+			r->seen   = (u64 *)realloc(r->seen, sizeof(u64) * r->capacity);
+			r->unused = (u32 *)realloc(r->unused, sizeof(u32) * r->capacity);
+		}
+		handle = r->count++;
+	}
+	r->prims[handle] = *p;
+	r->seen[handle]  = 0;
+	retained_draw(r, handle);
+	return handle;
+}
+
+void retained_update(Retained *r, u32 handle, const Primitive *p) {
+	retained_erase(r, handle);
+	r->prims[handle] = *p;
+	retained_draw(r, handle);
+}
+
+void retained_remove(Retained *r, u32 handle) {
+	retained_erase(r, handle);
+	r->unused[r->unused_count++] = handle;
+}
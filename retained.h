@@ -0,0 +1,64 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+#include "spatial.h"
+
+// A set of primitives kept drawn on a canvas, which can be changed one at a
+// time without drawing the rest of them again. Every cell of the canvas
+// counts the pixels the primitives plotted on it, so that removing a
+// primitive rasterizes only that primitive once more, taking its pixels back
+// out, and erases the cells which are not lit by any other primitive. The
+// framebuffer is always the same as clearing the canvas and drawing the
+// primitives in the order they were last added or updated.
+//
+// If the canvas has an ID buffer, every primitive is drawn with its handle
+// as its ID, see canvas_set_id. The cells of a removed primitive which are
+// still lit get the ID of the last of the other primitives drawn on them.
+// Those primitives are found with a uniform grid over the canvas, in which
+// every primitive is binned into the squares of RETAINED_BIN_SIZE pixels
+// its bounds overlap, see primitive_bounds. A primitive overlapping more
+// than SPATIAL_MAX_SPAN of them is kept in a list of large primitives.
+
+// log2 of the size of the squares of the grid, in logical pixels
+#define RETAINED_BIN_SHIFT 6
+#define RETAINED_BIN_SIZE (1 << RETAINED_BIN_SHIFT)
+
+typedef struct {
+	u32 *handles;
+	u32  count, capacity;
+	u64  seen; // The last repair the bin was looked at by
+} RetainedBin;
+
+typedef struct {
+	Canvas *     canvas;
+	u32 *        counts; // Pixels plotted on every cell
+	Primitive *  prims;  // Indexed by handle
+	u64 *        order;  // When each primitive was last drawn, 0 if removed
+	int *        bounds; // xmin, ymin, xmax, ymax of every primitive
+	u64 *        seen;   // The last repair each primitive was looked at by
+	u32          count, capacity; // Handles in use or removed
+	u32 *        unused;          // Removed handles, to be reused
+	u32          unused_count;
+	u64          clock, repairs;
+	RetainedBin *bins; // bin_cols by bin_rows, from the bottom left
+	int          bin_cols, bin_rows;
+	RetainedBin  large;
+	siz *        stale; // Cells emptied by the last removal, see RasterCounts
+	siz          stale_capacity;
+} Retained;
+
+// Keep primitives on the canvas, which must not be a view. The canvas is
+// cleared, and must only be drawn on through the functions below until the
+// set is released.
+Retained *retained_new(Canvas *c);
+// Release the set, leaving the canvas as it is
+void retained_free(Retained *r);
+// Draw the primitive on top of the others, and return its handle
+u32 retained_add(Retained *r, const Primitive *p);
+// Replace the primitive of the handle, drawing the new one on top of the
+// others
+void retained_update(Retained *r, u32 handle, const Primitive *p);
+// Remove the primitive of the handle, which may then be reused
+void retained_remove(Retained *r, u32 handle);
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene.h"
+
+static const char *type_names[] = {NULL, "line", "circle", "ellipse"};
+static const char *algo_names[] = {NULL, "dda", "bresenham", "midpoint"};
+
+#define is_blank(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+// Matches the word at *s against the names, and moves *s past it.
+// Returns the index of the name, or 0 if none of them matches.
+static int parse_word(const char **s, const char **names, int count) {
+	const char *w = *s;
+	while(is_blank(*w)) w++;
+	const char *e = w;
+	while(*e && !is_blank(*e)) e++;
+	*s = e;
+	for(int i = 1; i < count; i++) {
+		if(strlen(names[i]) == (siz)(e - w) && strncmp(names[i], w, e - w) == 0)
+			return i;
+	}
+	return 0;
+}
+
+// Parses the integer at *s, and moves *s past it. Returns 0 if there is
+// none, or if it does not fit in an int.
+static int parse_int(const char **s, int *value) {
+	char *end;
+	long  v = strtol(*s, &end, 10);
+	if(end == *s || (*end && !is_blank(*end)) || v < i32_MIN || v > i32_MAX)
+		return 0;
+	*value = (int)v;
+	*s     = end;
+	return 1;
+}
+
+static int at_end(const char *s) {
+	while(is_blank(*s)) s++;
+	return *s == '\0';
+}
+
+int scene_parse_line(const char *line, Primitive *p) {
+	const char *s = line;
+	while(is_blank(*s)) s++;
+	if(*s == '\0' || *s == '#')
+		return 0;
+	p->type     = parse_word(&s, type_names, 4);
+	p->algo     = parse_word(&s, algo_names, 4);
+	p->symmetry = 0;
+	int argc    = 0;
+	switch(p->type) {
+		case PRIM_LINE: argc = 4; break;
+		case PRIM_CIRCLE:
+			if(p->algo == ALGO_DDA)
+				return -1;
+			argc = 3;
+			break;
+		case PRIM_ELLIPSE:
+			if(p->algo != ALGO_MIDPOINT)
+				return -1;
+			argc = 4;
+			break;
+		default: return -1;
+	}
+	if(p->algo == 0)
+		return -1;
+	p->args[3] = 0;
+	for(int i = 0; i < argc; i++) {
+		if(!parse_int(&s, &p->args[i]))
+			return -1;
+	}
+	if(p->type == PRIM_CIRCLE && !at_end(s)) {
+		int symmetry;
+		if(!parse_int(&s, &symmetry) || !primitive_symmetry_valid(symmetry))
+			return -1;
+		p->symmetry = symmetry;
+	}
+	return at_end(s) ? 1 : -1;
+}
+
+long scene_read(FILE *f, void (*sink)(const Primitive *p, void *arg),
+                void *arg) {
+	char      line[SCENE_MAX_LINE];
+	long      count = 0, lineno = 0;
+	Primitive p;
+	while(fgets(line, sizeof(line), f)) {
+		lineno++;
+		siz len = strlen(line);
+		// Too long to be a primitive
+		if(len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(f))
+			return -lineno;
+		switch(scene_parse_line(line, &p)) {
+			case 0: break;
+			case 1:
+				sink(&p, arg);
+				count++;
+				break;
+			default: return -lineno;
+		}
+	}
+	return count;
+}
+
+static void draw_sink(const Primitive *p, void *arg) {
+	Canvas *c = (Canvas *)arg;
+	primitive_draw(c, p);
+	c->id++;
+}
+
+long scene_draw(FILE *f, Canvas *c) {
+	canvas_set_id(c, 0);
+	return scene_read(f, draw_sink, c);
+}
+
+void scene_write(FILE *f, const Primitive *p) {
+	const int *a = p->args;
+	// The algorithm of the ellipses is ignored by primitive_draw
+	int algo = p->type == PRIM_ELLIPSE ? ALGO_MIDPOINT : p->algo;
+	fprintf(f, "%s %s %d %d %d", type_names[p->type], algo_names[algo], a[0],
+	        a[1], a[2]);
+	if(p->type == PRIM_CIRCLE) {
+		if(p->symmetry)
+			fprintf(f, " %d", p->symmetry);
+	} else
+		fprintf(f, " %d", a[3]);
+	fputc('\n', f);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+
+// A text format of scenes, with one primitive per line :
+//   line <dda|bresenham|midpoint> <x1> <y1> <x2> <y2>
+//   circle <bresenham|midpoint> <x> <y> <radius> [symmetry]
+//   ellipse midpoint <x> <y> <major axis> <minor axis>
+// The symmetry is a power of 2 from 4 to 256, see primitive_symmetry_valid.
+// The fields are separated by spaces or tabs. Empty lines and lines starting
+// with '#' are ignored.
+
+// Longest line of a scene, including the newline
+#define SCENE_MAX_LINE 256
+
+// Parse a single line of a scene. Returns 1 if a primitive was parsed, 0 if
+// the line is empty or a comment, and -1 if it is malformed.
+int scene_parse_line(const char *line, Primitive *p);
+// Read the scene from the stream one line at a time, calling
+// sink(primitive, arg) for every primitive as soon as it is parsed, so that
+// the memory used does not depend on the size of the scene. Returns the
+// number of primitives read, or the negated number of the first malformed
+// line, after which nothing is read.
+long scene_read(FILE *f, void (*sink)(const Primitive *p, void *arg),
+                void *arg);
+// Read the scene from the stream and draw it on the canvas as it is read.
+// The ID of every primitive, see canvas_set_id, is its position among the
+// primitives of the scene.
+long scene_draw(FILE *f, Canvas *c);
+// Write the primitive as a line of a scene
+void scene_write(FILE *f, const Primitive *p);
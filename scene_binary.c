@@ -0,0 +1,249 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scene_binary.h"
+
+#define HEADER_SIZE 16
+#define INDEX_ENTRY_SIZE 24
+
+// Size of the records of every primitive type
+static const u32 record_sizes[] = {0, 20, 16, 16};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define le16(x) __builtin_bswap16(x)
+#define le32(x) __builtin_bswap32(x)
+#define le64(x) __builtin_bswap64(x)
+#else
+#define le16(x) (x)
+#define le32(x) (x)
+#define le64(x) (x)
+#endif
+
+// The records are only 4 byte aligned, so they are read through memcpy,
+// which compiles down to plain loads
+static inline u16 load_u16(const u8 *p) {
+	u16 v;
+	memcpy(&v, p, sizeof(v));
+	return le16(v);
+}
+
+static inline u32 load_u32(const u8 *p) {
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return le32(v);
+}
+
+static inline u64 load_u64(const u8 *p) {
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+	return le64(v);
+}
+
+static inline void store_u16(u8 *p, u16 v) {
+	v = le16(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void store_u32(u8 *p, u32 v) {
+	v = le32(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void store_u64(u8 *p, u64 v) {
+	v = le64(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+#define align8(x) (((x) + 7) & ~(u64)7)
+
+static void encode(const Primitive *p, u8 *r) {
+	const int *a = p->args;
+	switch(p->type) {
+		case PRIM_LINE:
+			r[0] = p->algo;
+			r[1] = 0;
+			store_u16(r + 2, 0);
+			for(int i = 0; i < 4; i++) store_u32(r + 4 + i * 4, (u32)a[i]);
+			break;
+		case PRIM_CIRCLE:
+			r[0] = p->algo;
+			r[1] = 0;
+			store_u16(r + 2, p->symmetry);
+			for(int i = 0; i < 3; i++) store_u32(r + 4 + i * 4, (u32)a[i]);
+			break;
+		case PRIM_ELLIPSE:
+			for(int i = 0; i < 4; i++) store_u32(r + i * 4, (u32)a[i]);
+			break;
+	}
+}
+
+static void decode(int type, const u8 *r, Primitive *p) {
+	p->type = type;
+	switch(type) {
+		case PRIM_LINE:
+			p->algo     = r[0];
+			p->symmetry = 0;
+			for(int i = 0; i < 4; i++)
+				p->args[i] = (i32)load_u32(r + 4 + i * 4);
+			break;
+		case PRIM_CIRCLE:
+			p->algo     = r[0];
+			p->symmetry = load_u16(r + 2);
+			for(int i = 0; i < 3; i++)
+				p->args[i] = (i32)load_u32(r + 4 + i * 4);
+			p->args[3] = 0;
+			break;
+		case PRIM_ELLIPSE:
+			p->algo     = ALGO_MIDPOINT;
+			p->symmetry = 0;
+			for(int i = 0; i < 4; i++) p->args[i] = (i32)load_u32(r + i * 4);
+			break;
+	}
+}
+
+// Whether the record holds a primitive scene_parse_line would accept. The
+// ellipses have no algorithm in the record, and are always midpoint ones.
+static int valid(int type, const u8 *r) {
+	switch(type) {
+		case PRIM_LINE: return r[0] >= ALGO_DDA && r[0] <= ALGO_MIDPOINT;
+		case PRIM_CIRCLE:
+			return (r[0] == ALGO_BRESENHAM || r[0] == ALGO_MIDPOINT) &&
+			       (load_u16(r + 2) == 0 ||
+			        primitive_symmetry_valid(load_u16(r + 2)));
+		default: return 1;
+	}
+}
+
+int scene_binary_write(FILE *f, const Primitive *prims, siz count) {
+	u64 counts[PRIM_ELLIPSE + 1] = {0};
+	for(siz i = 0; i < count; i++) counts[prims[i].type]++;
+
+	u8  header[HEADER_SIZE + INDEX_ENTRY_SIZE * PRIM_ELLIPSE];
+	u64 offset = sizeof(header);
+	memcpy(header, SCENE_BINARY_MAGIC, 4);
+	store_u32(header + 4, SCENE_BINARY_VERSION);
+	store_u32(header + 8, PRIM_ELLIPSE);
+	store_u32(header + 12, 0);
+	for(int t = PRIM_LINE; t <= PRIM_ELLIPSE; t++) {
+		u8 *e = header + HEADER_SIZE + (t - 1) * INDEX_ENTRY_SIZE;
+		store_u32(e, t);
+		store_u32(e + 4, record_sizes[t]);
+		store_u64(e + 8, offset);
+		store_u64(e + 16, counts[t]);
+		offset = align8(offset + counts[t] * record_sizes[t]);
+	}
+	if(fwrite(header, sizeof(header), 1, f) != 1)
+		return -1;
+
+	static const u8 padding[8] = {0};
+	for(int t = PRIM_LINE; t <= PRIM_ELLIPSE; t++) {
+		u8 record[20];
+		for(siz i = 0; i < count; i++) {
+			if(prims[i].type != t)
+				continue;
+			encode(&prims[i], record);
+			if(fwrite(record, record_sizes[t], 1, f) != 1)
+				return -1;
+		}
+		u64 size = counts[t] * record_sizes[t];
+		if(align8(size) != size &&
+		   fwrite(padding, align8(size) - size, 1, f) != 1)
+			return -1;
+	}
+	return 0;
+}
+
+int scene_map_fd(int fd, SceneMap *map) {
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+		return -1;
+	if(st.st_size < HEADER_SIZE)
+		return 0;
+	map->size = st.st_size;
+	map->base = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(map->base == MAP_FAILED)
+		return -1;
+	const u8 *b = (const u8 *)map->base;
+	if(memcmp(b, SCENE_BINARY_MAGIC, 4) != 0) {
+		scene_unmap(map);
+		return 0;
+	}
+	// The records are read in order, so let the kernel read ahead
+	madvise(map->base, map->size, MADV_SEQUENTIAL);
+	memset(map->records, 0, sizeof(map->records));
+	memset(map->counts, 0, sizeof(map->counts));
+	map->sections = load_u32(b + 8);
+	if(load_u32(b + 4) != SCENE_BINARY_VERSION ||
+	   map->sections > PRIM_ELLIPSE ||
+	   HEADER_SIZE + (u64)map->sections * INDEX_ENTRY_SIZE > map->size)
+		goto malformed;
+	for(u32 s = 0; s < map->sections; s++) {
+		const u8 *e      = b + HEADER_SIZE + s * INDEX_ENTRY_SIZE;
+		u32       type   = load_u32(e);
+		u64       offset = load_u64(e + 8), count = load_u64(e + 16);
+		if(type < PRIM_LINE || type > PRIM_ELLIPSE ||
+		   load_u32(e + 4) != record_sizes[type] || map->counts[type] ||
+		   offset % 8 != 0 || offset > map->size ||
+		   count > (map->size - offset) / record_sizes[type])
+			goto malformed;
+		map->records[type] = b + offset;
+		map->counts[type]  = count;
+	}
+	// A bad algorithm or symmetry would not be caught when drawing, and
+	// some of the symmetries, such as 1 and 2, would never finish
+	for(int t = PRIM_LINE; t <= PRIM_ELLIPSE; t++)
+		for(u64 i = 0; i < map->counts[t]; i++)
+			if(!valid(t, map->records[t] + i * record_sizes[t]))
+				goto malformed;
+	return 1;
+malformed:
+	scene_unmap(map);
+	return -1;
+}
+
+int scene_map(const char *path, SceneMap *map) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return -1;
+	int res = scene_map_fd(fd, map);
+	close(fd);
+	return res;
+}
+
+u64 scene_map_count(const SceneMap *map) {
+	u64 count = 0;
+	for(int t = PRIM_LINE; t <= PRIM_ELLIPSE; t++) count += map->counts[t];
+	return count;
+}
+
+void scene_map_read(const SceneMap *map,
+                    void (*sink)(const Primitive *p, void *arg), void *arg) {
+	Primitive p;
+	for(int t = PRIM_LINE; t <= PRIM_ELLIPSE; t++) {
+		const u8 *r = map->records[t];
+		for(u64 i = 0; i < map->counts[t]; i++, r += record_sizes[t]) {
+			decode(t, r, &p);
+			sink(&p, arg);
+		}
+	}
+}
+
+static void draw_sink(const Primitive *p, void *arg) {
+	Canvas *c = (Canvas *)arg;
+	primitive_draw(c, p);
+	c->id++;
+}
+
+void scene_map_draw(const SceneMap *map, Canvas *c) {
+	canvas_set_id(c, 0);
+	scene_map_read(map, draw_sink, c);
+}
+
+void scene_unmap(SceneMap *map) {
+	munmap(map->base, map->size);
+	map->base = NULL;
+	map->size = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+
+// A packed binary format of scenes, which is memory mapped and drawn
+// directly from the mapping. All the values are little endian.
+//
+//   header   : magic "CUGS", u32 version, u32 section count, u32 reserved
+//   index    : for every section, u32 primitive type, u32 record size,
+//              u64 offset of the first record from the start of the file,
+//              u64 number of records
+//   sections : the fixed size records of every section, 8 byte aligned
+//
+// The records of each primitive type are :
+//   line    : u8 algo, u8 reserved, u16 reserved, i32 x1, y1, x2, y2
+//   circle  : u8 algo, u8 reserved, u16 symmetry, i32 x, y, radius
+//   ellipse : i32 x, y, major axis, minor axis
+//
+// The primitives are grouped by type, so they are not drawn in the order
+// they were written, but the resulting framebuffer is the same.
+
+#define SCENE_BINARY_MAGIC "CUGS"
+#define SCENE_BINARY_VERSION 1
+
+typedef struct {
+	void *   base; // The mapping of the whole file
+	siz      size;
+	u32      sections;
+	const u8 *records[PRIM_ELLIPSE + 1]; // First record of every type
+	u64       counts[PRIM_ELLIPSE + 1];  // Records of every type
+} SceneMap;
+
+// Write the primitives as a binary scene. Returns 0 on success, and -1 if
+// the stream could not be written.
+int scene_binary_write(FILE *f, const Primitive *prims, siz count);
+// Map the binary scene in the file. Returns 1 if it is mapped, 0 if the file
+// is not a binary scene, and -1 if it could not be read or is malformed,
+// which includes any record with an algorithm or a symmetry scene_parse_line
+// would reject.
+int scene_map(const char *path, SceneMap *map);
+// Map the binary scene in the open file, which may be closed afterwards
+int scene_map_fd(int fd, SceneMap *map);
+// Total number of primitives of the mapped scene
+u64 scene_map_count(const SceneMap *map);
+// Call sink(primitive, arg) for every primitive of the mapped scene. The
+// records are decoded one at a time straight from the mapping.
+void scene_map_read(const SceneMap *map,
+                    void (*sink)(const Primitive *p, void *arg), void *arg);
+// Draw the mapped scene on the canvas. The ID of every primitive, see
+// canvas_set_id, is its position in the order scene_map_read reads them.
+void scene_map_draw(const SceneMap *map, Canvas *c);
+// Unmap the scene
+void scene_unmap(SceneMap *map);
@@ -0,0 +1,198 @@
+#include <sched.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+#include "threadpool.h"
+
+// Free slots ensured in every deque before running, for the tasks spawned
+// by the running ones
+#define SCHED_SPAWN_SLOTS 1024
+
+typedef struct {
+	SchedTask fn;
+	void *    arg;
+} Task;
+
+// A Chase-Lev deque. Only the owner pushes and takes at the bottom, while
+// any worker can steal at the top. It is only resized while the scheduler
+// is not running. Every deque is on its own cache line, so that the owners
+// do not contend on each other's indices.
+typedef struct {
+	i64   top, bottom;
+	i64   capacity; // Power of 2
+	Task *tasks;
+} __attribute__((aligned(64))) Deque;
+
+struct Scheduler {
+	ThreadPool *pool;
+	Deque *     deques; // One for every worker
+	int         size;
+	int         deal;      // Deque of the next task spawned from outside
+	i64         remaining; // Tasks queued or running
+	u64         steals;
+};
+
+// Scheduler and deque of the worker running on the calling thread
+static __thread Scheduler *current        = NULL;
+static __thread int        current_worker = 0;
+
+static void task_load(Deque *d, i64 i, Task *t) {
+	Task *slot = &d->tasks[i & (d->capacity - 1)];
+	t->fn      = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+	t->arg     = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+}
+
+// Resizes the deque to hold at least the given number of tasks. Must not
+// be called while the scheduler is running.
+static void deque_reserve(Deque *d, i64 count) {
+	if(count <= d->capacity)
+		return;
+	i64 capacity = d->capacity ? d->capacity : 64;
+	while(capacity < count) capacity *= 2;
+	Task *tasks = (Task *)malloc(sizeof(Task) * capacity);
+	for(i64 i = d->top; i < d->bottom; i++)
+		task_load(d, i, &tasks[i & (capacity - 1)]);
+	free(d->tasks);
+	d->tasks    = tasks;
+	d->capacity = capacity;
+}
+
+// Pushes a task at the bottom. Returns 0 if the deque is full.
+static int deque_push(Deque *d, SchedTask fn, void *arg) {
+	i64 b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	i64 t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	if(b - t >= d->capacity)
+		return 0;
+	Task *slot = &d->tasks[b & (d->capacity - 1)];
+	__atomic_store_n(&slot->fn, fn, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->arg, arg, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+// Takes the newest task from the bottom. Returns 0 if the deque is empty,
+// or its last task was stolen in the meantime.
+static int deque_take(Deque *d, Task *task) {
+	i64 b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	i64 t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+	if(t > b) {
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	task_load(d, b, task);
+	if(t < b)
+		return 1;
+	// The last task, which a thief may be stealing as well
+	int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+	                                      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return won;
+}
+
+// Steals the oldest task from the top. Returns 0 if the deque is empty, or
+// another worker got the task first.
+static int deque_steal(Deque *d, Task *task) {
+	i64 t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	i64 b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+	if(t >= b)
+		return 0;
+	task_load(d, t, task);
+	return __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+	                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// Tries every other deque once, starting from a random one
+static int steal_any(Scheduler *s, int self, u32 *seed, Task *task) {
+	*seed     = *seed * 1103515245 + 12345;
+	int start = (*seed >> 16) % s->size;
+	for(int i = 0; i < s->size; i++) {
+		int victim = (start + i) % s->size;
+		if(victim != self && deque_steal(&s->deques[victim], task)) {
+			__atomic_fetch_add(&s->steals, 1, __ATOMIC_RELAXED);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void task_done(Scheduler *s) {
+	__atomic_fetch_sub(&s->remaining, 1, __ATOMIC_ACQ_REL);
+}
+
+// Runs the tasks of the deque 'index', and steals from the others once it
+// is empty, until no task is left anywhere
+static void sched_worker(int index, int worker, void *arg) {
+	(void)worker;
+	Scheduler *s    = (Scheduler *)arg;
+	Deque *    own  = &s->deques[index];
+	u32        seed = (u32)index * 2654435761u + 1;
+	current         = s;
+	current_worker  = index;
+	Task task;
+	while(__atomic_load_n(&s->remaining, __ATOMIC_ACQUIRE) > 0) {
+		if(deque_take(own, &task) || steal_any(s, index, &seed, &task)) {
+			task.fn(task.arg, index);
+			task_done(s);
+		} else
+			sched_yield();
+	}
+	current = NULL;
+}
+
+Scheduler *sched_new(int threads) {
+	Scheduler *s = (Scheduler *)calloc(1, sizeof(Scheduler));
+	s->pool      = pool_new(threads);
+	s->size      = pool_size(s->pool);
+	s->deques    = (Deque *)aligned_alloc(64, sizeof(Deque) * s->size);
+	for(int i = 0; i < s->size; i++) {
+		s->deques[i].top = s->deques[i].bottom = 0;
+		s->deques[i].capacity                  = 0;
+		s->deques[i].tasks                     = NULL;
+	}
+	return s;
+}
+
+int sched_size(Scheduler *s) {
+	return s->size;
+}
+
+void sched_spawn(Scheduler *s, SchedTask fn, void *arg) {
+	__atomic_fetch_add(&s->remaining, 1, __ATOMIC_ACQ_REL);
+	if(current == s) {
+		if(!deque_push(&s->deques[current_worker], fn, arg)) {
+			fn(arg, current_worker);
+			task_done(s);
+		}
+		return;
+	}
+	Deque *d = &s->deques[s->deal];
+	s->deal  = (s->deal + 1) % s->size;
+	deque_reserve(d, d->bottom - d->top + 1);
+	deque_push(d, fn, arg);
+}
+
+void sched_run(Scheduler *s) {
+	if(s->remaining == 0)
+		return;
+	for(int i = 0; i < s->size; i++) {
+		Deque *d = &s->deques[i];
+		deque_reserve(d, d->bottom - d->top + SCHED_SPAWN_SLOTS);
+	}
+	pool_run(s->pool, s->size, sched_worker, s);
+	s->deal = 0;
+}
+
+u64 sched_steals(Scheduler *s) {
+	return s->steals;
+}
+
+void sched_free(Scheduler *s) {
+	pool_free(s->pool);
+	for(int i = 0; i < s->size; i++) free(s->deques[i].tasks);
+	free(s->deques);
+	free(s);
+}
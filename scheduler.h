@@ -0,0 +1,33 @@
+#pragma once
+
+#include "common.h"
+
+// A work stealing scheduler of independent tasks. Every worker owns a deque
+// of tasks, which it runs from the bottom in LIFO order. A worker whose
+// deque is empty steals the oldest task from the top of the deque of
+// another worker, so uneven tasks are balanced without a shared queue.
+// The workers are the threads of a ThreadPool, and the thread calling
+// sched_run participates as the worker 0.
+
+typedef struct Scheduler Scheduler;
+
+typedef void (*SchedTask)(void *arg, int worker);
+
+// Create a scheduler of the given number of workers, including the caller.
+// If threads <= 0, the number of online processors is used.
+Scheduler *sched_new(int threads);
+// Number of workers of the scheduler, including the caller
+int sched_size(Scheduler *s);
+// Queue fn(arg, worker) to be run. Called from inside a running task, it is
+// pushed on the deque of the calling worker, or run right away if the deque
+// is full. Called from outside, the tasks are dealt to the deques in turns,
+// until the next sched_run.
+void sched_spawn(Scheduler *s, SchedTask fn, void *arg);
+// Run all the queued tasks, and the ones they spawn, on all the workers.
+// Returns once every one of them is done.
+void sched_run(Scheduler *s);
+// Number of tasks stolen from another worker since the scheduler was
+// created
+u64 sched_steals(Scheduler *s);
+// Stop the workers and release the scheduler
+void sched_free(Scheduler *s);
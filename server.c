@@ -0,0 +1,479 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "animation.h"
+#include "driver.h"
+#include "export.h"
+#include "primitive.h"
+#include "scene.h"
+#include "server.h"
+
+// Most steps of a transform command
+#define SERVER_MAX_STEPS 256
+// Most transformations of a transform command, over all of its steps, and
+// most cells they may move in total, though any canvas can be transformed
+// once
+#define SERVER_MAX_TRANSFORMS 4096
+#define SERVER_MAX_TRANSFORMED (1ll << 30)
+// Output of a client beyond which its commands are held back until the
+// client reads some of it
+#define SERVER_MAX_PENDING (1 << 16)
+// Largest output buffer a client keeps once all of it is sent
+#define SERVER_KEEP_OUTPUT (1 << 16)
+
+typedef struct {
+	char    name[SERVER_MAX_NAME + 1];
+	Canvas *canvas; // NULL if the slot is free
+} NamedCanvas;
+
+typedef struct {
+	int   fd;
+	char  buf[SERVER_MAX_LINE];
+	siz   size;
+	u8    overflow; // The line being read is too long, and is skipped
+	u8    ended;    // The client sent all of its commands
+	u8    closing;  // Nothing more is executed, and it is closed once sent
+	char *out;      // Output not yet accepted by the socket, from out_start
+	siz   out_start, out_size, out_capacity;
+} Client;
+
+typedef struct {
+	NamedCanvas canvases[SERVER_MAX_CANVASES];
+	Client      clients[SERVER_MAX_CLIENTS + 1]; // And one being turned away
+	int         client_count;
+	u8          running;
+} Server;
+
+// The commands which operate on an existing canvas
+static const char *canvas_commands[] = {
+    "draw", "clear", "pivot", "transform", "pixels", "export", "send", "free"};
+
+#define is_blank(c) ((c) == ' ' || (c) == '\t' || (c) == '\r')
+
+// Bytes of output the socket of the client has not accepted yet
+static siz client_pending(const Client *c) {
+	return c->out_size - c->out_start;
+}
+
+// Reserves size bytes at the end of the output of the client, and returns
+// them, or NULL if they could not be allocated, in which case the client is
+// closed once the rest of its output is sent
+static char *client_reserve(Client *c, siz size) {
+	if(c->out_start > 0) {
+		memmove(c->out, c->out + c->out_start, client_pending(c));
+		c->out_size -= c->out_start;
+		c->out_start = 0;
+	}
+	if(c->out_size + size > c->out_capacity) {
+		siz capacity = c->out_capacity ? c->out_capacity : 256;
+		while(capacity < c->out_size + size) capacity *= 2;
+		char *out = (char *)realloc(c->out, capacity);
+		if(out == NULL) {
+			c->closing = 1;
+			return NULL;
+		}
+		c->out          = out;
+		c->out_capacity = capacity;
+	}
+	c->out_size += size;
+	return c->out + c->out_size - size;
+}
+
+// Writes as much of the output of the client as the socket accepts without
+// blocking. Returns -1 if the connection is broken.
+static int client_flush(Client *c) {
+	while(client_pending(c) > 0) {
+		ssize_t written =
+		    write(c->fd, c->out + c->out_start, client_pending(c));
+		if(written < 0) {
+			if(errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+		}
+		c->out_start += written;
+	}
+	c->out_start = c->out_size = 0;
+	// The buffer of a large image is not kept once it is sent
+	if(c->out_capacity > SERVER_KEEP_OUTPUT) {
+		free(c->out);
+		c->out          = NULL;
+		c->out_capacity = 0;
+	}
+	return 0;
+}
+
+static void reply(Client *c, const char *fmt, ...) {
+	char    buf[256];
+	va_list args;
+	va_start(args, fmt);
+	int size = vsnprintf(buf, sizeof(buf) - 1, fmt, args);
+	va_end(args);
+	if(size > (int)sizeof(buf) - 2)
+		size = sizeof(buf) - 2;
+	buf[size++] = '\n';
+	char *out   = client_reserve(c, size);
+	if(out)
+		memcpy(out, buf, size);
+}
+
+// Splits the next word off *s, and returns it, or NULL if there is none
+static char *next_word(char **s) {
+	char *w = *s;
+	while(is_blank(*w)) w++;
+	if(*w == '\0')
+		return NULL;
+	char *e = w;
+	while(*e && !is_blank(*e)) e++;
+	if(*e)
+		*e++ = '\0';
+	*s = e;
+	return w;
+}
+
+static int next_int(char **s, int *value) {
+	char *w = next_word(s), *end;
+	if(w == NULL)
+		return 0;
+	long v = strtol(w, &end, 10);
+	if(*end || v < i32_MIN || v > i32_MAX)
+		return 0;
+	*value = (int)v;
+	return 1;
+}
+
+static NamedCanvas *find_canvas(Server *s, const char *name) {
+	for(int i = 0; i < SERVER_MAX_CANVASES; i++) {
+		if(s->canvases[i].canvas && strcmp(s->canvases[i].name, name) == 0)
+			return &s->canvases[i];
+	}
+	return NULL;
+}
+
+static void create_canvas(Server *s, Client *cl, const char *name,
+                          char *rest) {
+	int width, height;
+	if(!next_int(&rest, &width) || !next_int(&rest, &height) || width < 1 ||
+	   height < 1 || (u64)width * height > (1ull << 28)) {
+		reply(cl, "error invalid size");
+		return;
+	}
+	if(strlen(name) > SERVER_MAX_NAME) {
+		reply(cl, "error name too long");
+		return;
+	}
+	NamedCanvas *nc = find_canvas(s, name);
+	for(int i = 0; nc == NULL && i < SERVER_MAX_CANVASES; i++) {
+		if(s->canvases[i].canvas == NULL)
+			nc = &s->canvases[i];
+	}
+	if(nc == NULL) {
+		reply(cl, "error too many canvases");
+		return;
+	}
+	if(nc->canvas)
+		canvas_free(nc->canvas);
+	strcpy(nc->name, name);
+	nc->canvas = canvas_new(height, width * 2);
+	canvas_set_pivot(nc->canvas, width / 2, height / 2);
+	reply(cl, "ok");
+}
+
+static void send_image(Canvas *c, Client *cl, char *rest) {
+	const char *names[] = {"pbm", "pgm", "ppm", "raw"};
+	char *      w       = next_word(&rest);
+	for(int i = 0; w && i < 4; i++) {
+		if(strcmp(w, names[i]) == 0) {
+			ExportFormat fmt = (ExportFormat)(i + 1);
+			char         header[64];
+			siz          header_size = export_header(c, fmt, header);
+			siz          data_size   = export_data_size(c, fmt);
+			reply(cl, "ok %" Psiz, header_size + data_size);
+			char *out = client_reserve(cl, header_size + data_size);
+			if(out == NULL)
+				return;
+			memcpy(out, header, header_size);
+			export_encode(c, fmt, (u8 *)out + header_size);
+			return;
+		}
+	}
+	reply(cl, "error unknown format");
+}
+
+// Whether the arguments of the primitive stay within the size of the canvas
+// of it on every side, and its symmetry is valid, so that drawing it takes
+// time in proportion to the canvas rather than holding up the other clients
+static int within_reach(const Canvas *c, const Primitive *p) {
+	i64        width = c->cols / 2, height = c->rows;
+	i64        most = 2 * (width > height ? width : height);
+	const int *a    = p->args;
+	for(int i = 0; i < (p->type == PRIM_LINE ? 2 : 1); i++) {
+		if(a[2 * i] < -width || a[2 * i] >= 2 * width ||
+		   a[2 * i + 1] < -height || a[2 * i + 1] >= 2 * height)
+			return 0;
+	}
+	if(p->type == PRIM_CIRCLE)
+		return llabs(a[2]) <= most &&
+		       (p->symmetry == 0 || primitive_symmetry_valid(p->symmetry));
+	if(p->type == PRIM_ELLIPSE)
+		return llabs(a[2]) <= most && llabs(a[3]) <= most;
+	return 1;
+}
+
+// Executes a command of the client. Returns 1 if the connection is to be
+// closed.
+static int execute(Server *s, Client *cl, char *line) {
+	char *rest = line, *cmd = next_word(&rest);
+	// Empty lines are not commands
+	if(cmd == NULL)
+		return 0;
+	if(strcmp(cmd, "quit") == 0)
+		return 1;
+	if(strcmp(cmd, "shutdown") == 0) {
+		s->running = 0;
+		reply(cl, "ok");
+		return 1;
+	}
+	char *name = next_word(&rest);
+	if(name == NULL) {
+		reply(cl, "error missing canvas");
+		return 0;
+	}
+	if(strcmp(cmd, "canvas") == 0) {
+		create_canvas(s, cl, name, rest);
+		return 0;
+	}
+	int known = 0;
+	for(int i = 0; i < 8; i++) known |= strcmp(cmd, canvas_commands[i]) == 0;
+	if(!known) {
+		reply(cl, "error unknown command %s", cmd);
+		return 0;
+	}
+	NamedCanvas *nc = find_canvas(s, name);
+	if(nc == NULL) {
+		reply(cl, "error no canvas %s", name);
+		return 0;
+	}
+	Canvas *c = nc->canvas;
+	if(strcmp(cmd, "draw") == 0) {
+		Primitive p;
+		if(scene_parse_line(rest, &p) != 1) {
+			reply(cl, "error malformed primitive");
+			return 0;
+		}
+		if(!within_reach(c, &p)) {
+			reply(cl, "error primitive out of range");
+			return 0;
+		}
+		primitive_draw(c, &p);
+	} else if(strcmp(cmd, "clear") == 0)
+		canvas_clear(c);
+	else if(strcmp(cmd, "pivot") == 0) {
+		int x, y;
+		if(!next_int(&rest, &x) || !next_int(&rest, &y)) {
+			reply(cl, "error malformed pivot");
+			return 0;
+		}
+		canvas_set_pivot(c, x, y);
+	} else if(strcmp(cmd, "transform") == 0) {
+		AnimationStep steps[SERVER_MAX_STEPS];
+		int           count = animation_parse(rest, steps, SERVER_MAX_STEPS);
+		if(count < 0) {
+			reply(cl, "error malformed script");
+			return 0;
+		}
+		i64 most = SERVER_MAX_TRANSFORMED / ((i64)c->rows * c->cols);
+		if(most > SERVER_MAX_TRANSFORMS)
+			most = SERVER_MAX_TRANSFORMS;
+		if(most < 1)
+			most = 1;
+		if(animation_frames(steps, count) - 1 > most) {
+			reply(cl, "error too many transformations");
+			return 0;
+		}
+		for(int i = 0; i < count; i++) {
+			for(int j = 0; j < steps[i].count; j++)
+				canvas_transform(c, steps[i].op, get_transform_pool());
+		}
+	} else if(strcmp(cmd, "pixels") == 0) {
+		reply(cl, "ok %" Pu64, c->pixel_count);
+		return 0;
+	} else if(strcmp(cmd, "export") == 0) {
+		char *       path = next_word(&rest);
+		ExportFormat fmt  = path ? export_format_of(path) : 0;
+		if(fmt == 0) {
+			reply(cl, "error unknown format");
+			return 0;
+		}
+		if(export_file(c, fmt, path) != 0) {
+			reply(cl, "error unable to write %s", path);
+			return 0;
+		}
+	} else if(strcmp(cmd, "send") == 0) {
+		send_image(c, cl, rest);
+		return 0;
+	} else if(strcmp(cmd, "free") == 0) {
+		canvas_free(c);
+		nc->canvas = NULL;
+	}
+	reply(cl, "ok");
+	return 0;
+}
+
+// Reads what the client sent. Returns 1 if the connection is broken.
+static int client_read(Client *c) {
+	ssize_t n = read(c->fd, c->buf + c->size, sizeof(c->buf) - c->size);
+	if(n < 0)
+		return errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK;
+	// The commands sent before the end are still executed
+	if(n == 0)
+		c->ended = 1;
+	c->size += n;
+	return 0;
+}
+
+// Executes the complete lines the client sent while its output is at most
+// SERVER_MAX_PENDING, the rest of them once the client has read it. Returns
+// the number of lines executed.
+static int client_execute(Server *s, Client *c) {
+	char *line = c->buf, *end = NULL;
+	int   executed = 0;
+	while(s->running && !c->closing &&
+	      client_pending(c) <= SERVER_MAX_PENDING &&
+	      (end = memchr(line, '\n', c->buf + c->size - line))) {
+		*end = '\0';
+		if(c->overflow) {
+			c->overflow = 0;
+			reply(c, "error line too long");
+		} else if(execute(s, c, line))
+			c->closing = 1;
+		line = end + 1;
+		executed++;
+	}
+	c->size -= line - c->buf;
+	memmove(c->buf, line, c->size);
+	// The rest of the line is dropped until its end
+	if(end == NULL && c->size == sizeof(c->buf)) {
+		c->overflow = 1;
+		c->size     = 0;
+	}
+	return executed;
+}
+
+// Whether the server waits for the client to send more commands
+static int client_reading(const Client *c) {
+	return !c->ended && !c->closing &&
+	       client_pending(c) <= SERVER_MAX_PENDING && c->size < sizeof(c->buf);
+}
+
+// Reads from the client, executes its commands and sends their output, as
+// far as it can be done without blocking. Returns 1 if the connection is to
+// be closed.
+static int client_serve(Server *s, Client *c, short revents) {
+	if((revents & (POLLIN | POLLHUP | POLLERR)) && client_reading(c) &&
+	   client_read(c))
+		return 1;
+	// Sending the output may let more of the commands already read run
+	do {
+		if(client_flush(c) < 0)
+			return 1;
+	} while(client_execute(s, c) > 0);
+	if(c->ended && memchr(c->buf, '\n', c->size) == NULL)
+		c->closing = 1;
+	return c->closing && client_pending(c) == 0;
+}
+
+static void client_close(Server *s, int i) {
+	close(s->clients[i].fd);
+	free(s->clients[i].out);
+	s->clients[i] = s->clients[--s->client_count];
+}
+
+static void release(Server *s) {
+	// The last replies, such as the one to the shutdown, are sent if the
+	// sockets take them at once
+	for(int i = s->client_count - 1; i >= 0; i--) {
+		client_flush(&s->clients[i]);
+		client_close(s, i);
+	}
+	for(int i = 0; i < SERVER_MAX_CANVASES; i++) {
+		if(s->canvases[i].canvas)
+			canvas_free(s->canvases[i].canvas);
+	}
+	free(s);
+}
+
+int server_run(const char *path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+	int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(lfd < 0)
+		return -1;
+	unlink(path);
+	if(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	   listen(lfd, SOMAXCONN) != 0) {
+		close(lfd);
+		return -1;
+	}
+	// A client going away must not take the server down with it
+	signal(SIGPIPE, SIG_IGN);
+
+	Server *s  = (Server *)calloc(1, sizeof(Server));
+	s->running = 1;
+	struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+	while(s->running) {
+		fds[0].fd     = lfd;
+		fds[0].events = POLLIN;
+		for(int i = 0; i < s->client_count; i++) {
+			Client *c         = &s->clients[i];
+			fds[i + 1].fd     = c->fd;
+			fds[i + 1].events = (client_reading(c) ? POLLIN : 0) |
+			                    (client_pending(c) > 0 ? POLLOUT : 0);
+		}
+		if(poll(fds, s->client_count + 1, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		// Backwards, so that a closed client can be replaced by the last one
+		for(int i = s->client_count - 1; i >= 0 && s->running; i--) {
+			if(fds[i + 1].revents &&
+			   client_serve(s, &s->clients[i], fds[i + 1].revents))
+				client_close(s, i);
+		}
+		if(!(fds[0].revents & POLLIN) || !s->running)
+			continue;
+		int fd = accept(lfd, NULL, NULL);
+		if(fd < 0)
+			continue;
+		// Nothing of a client may block the server
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		Client *c = &s->clients[s->client_count];
+		memset(c, 0, sizeof(Client));
+		c->fd = fd;
+		if(s->client_count == SERVER_MAX_CLIENTS) {
+			reply(c, "error too many clients");
+			client_flush(c);
+			close(fd);
+			free(c->out);
+			continue;
+		}
+		s->client_count++;
+	}
+	release(s);
+	close(lfd);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "common.h"
+
+// A long running render server, which keeps its canvases in memory between
+// requests. Clients connect to a Unix domain socket and send commands, one
+// per line, and every command is answered with a single line, "ok" with an
+// optional result or "error <reason>", in the order they were sent :
+//   canvas <name> <width> <height> : create the canvas, or clear and resize
+//                                    it, in logical pixels
+//   draw <name> <primitive>        : draw a primitive, written as a line of
+//                                    a scene, see scene.h
+//   clear <name>                   : clear the canvas
+//   pivot <name> <x> <y>           : set the pivot of the transformations
+//   transform <name> <script>      : apply the steps of an animation script,
+//                                    see animation.h
+//   pixels <name>                  : answer the number of plotted pixels
+//   export <name> <path>           : write the canvas to an image file
+//   send <name> <pbm|pgm|ppm|raw>  : answer "ok <size>", followed by the
+//                                    bytes of the image
+//   free <name>                    : release the canvas
+//   quit                           : close the connection
+//   shutdown                       : stop the server
+// Canvas names are at most SERVER_MAX_NAME characters long. A primitive
+// with a point farther from the canvas than its width or height, or a radius
+// or an axis longer than twice them, is rejected, as is a transform command
+// moving too many cells in total, so that no command holds up the server for
+// long. The server never blocks on a client: the output of every client is
+// buffered, and its commands are held back while too much of it is unread.
+
+#define SERVER_MAX_NAME 31
+#define SERVER_MAX_CANVASES 256
+#define SERVER_MAX_CLIENTS 64
+// Longest command, including the newline
+#define SERVER_MAX_LINE 4096
+
+// Serve the clients on the socket at the path until a shutdown command,
+// transforming on the threads of set_transform_threads. An existing socket
+// at the path is replaced. Returns 0 after a shutdown, and -1 if the socket
+// could not be created.
+int server_run(const char *path);
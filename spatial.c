@@ -0,0 +1,195 @@
+#include <stdlib.h>
+
+#include "primitive.h"
+#include "spatial.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Primitives looked up at once by spatial_draw before it has to allocate
+#define SPATIAL_DRAW_BATCH 1024
+
+// The cell along an axis containing the logical coordinate v, clamped to
+// the grid
+static inline int spatial_cell(i64 v, int origin, int shift, int cells) {
+	i64 c = (v - origin) >> shift;
+	return c < 0 ? 0 : c >= cells ? cells - 1 : (int)c;
+}
+
+// Computes the range of cells overlapped by the bounds of the primitive i.
+// Returns 0 if it is a large one.
+static int spatial_range(const SpatialIndex *s, u32 i, int *c0, int *r0,
+                         int *c1, int *r1) {
+	const int *b = &s->bounds[(siz)i * 4];
+	*c0          = spatial_cell(b[0], s->x0, s->shift, s->cols);
+	*r0          = spatial_cell(b[1], s->y0, s->shift, s->rows);
+	*c1          = spatial_cell(b[2], s->x0, s->shift, s->cols);
+	*r1          = spatial_cell(b[3], s->y0, s->shift, s->rows);
+	return (i64)(*c1 - *c0 + 1) * (*r1 - *r0 + 1) <= SPATIAL_MAX_SPAN;
+}
+
+SpatialIndex *spatial_new(const Primitive *prims, siz count) {
+	SpatialIndex *s = (SpatialIndex *)malloc(sizeof(SpatialIndex));
+	s->prims        = prims;
+	s->count        = (u32)count;
+	s->bounds       = (int *)malloc(sizeof(int) * 4 * (count + 1));
+	int xmin = i32_MAX, ymin = i32_MAX, xmax = i32_MIN, ymax = i32_MIN;
+	for(u32 i = 0; i < s->count; i++) {
+		int *b = &s->bounds[(siz)i * 4];
+		primitive_bounds(&prims[i], &b[0], &b[1], &b[2], &b[3]);
+		xmin = MIN(xmin, b[0]);
+		ymin = MIN(ymin, b[1]);
+		xmax = MAX(xmax, b[2]);
+		ymax = MAX(ymax, b[3]);
+	}
+	if(count == 0)
+		xmin = ymin = xmax = ymax = 0;
+	// The smallest cells for which there are not many more of them than
+	// primitives
+	i64 width = (i64)xmax - xmin + 1, height = (i64)ymax - ymin + 1;
+	i64 most  = MIN(MAX((i64)count, 1), SPATIAL_MAX_CELLS);
+	int shift = 0;
+	while((((width - 1) >> shift) + 1) * (((height - 1) >> shift) + 1) > most)
+		shift++;
+	s->x0    = xmin;
+	s->y0    = ymin;
+	s->shift = shift;
+	s->cols  = (int)((width - 1) >> shift) + 1;
+	s->rows  = (int)((height - 1) >> shift) + 1;
+
+	// Bin the primitives with a counting sort, first counting the size of
+	// every bin, then filling them in
+	siz cells      = (siz)s->cols * s->rows;
+	s->offsets     = (siz *)calloc(cells + 1, sizeof(siz));
+	s->large_count = 0;
+	int c0, r0, c1, r1;
+	for(u32 i = 0; i < s->count; i++) {
+		if(!spatial_range(s, i, &c0, &r0, &c1, &r1)) {
+			s->large_count++;
+			continue;
+		}
+		for(int r = r0; r <= r1; r++)
+			for(int c = c0; c <= c1; c++)
+				s->offsets[(siz)r * s->cols + c + 1]++;
+	}
+	for(siz c = 0; c < cells; c++) s->offsets[c + 1] += s->offsets[c];
+	s->indices  = (u32 *)malloc(sizeof(u32) * (s->offsets[cells] + 1));
+	s->large    = (u32 *)malloc(sizeof(u32) * (s->large_count + 1));
+	siz *cursor = (siz *)malloc(sizeof(siz) * cells);
+	for(siz c = 0; c < cells; c++) cursor[c] = s->offsets[c];
+	u32 large = 0;
+	for(u32 i = 0; i < s->count; i++) {
+		if(!spatial_range(s, i, &c0, &r0, &c1, &r1)) {
+			s->large[large++] = i;
+			continue;
+		}
+		for(int r = r0; r <= r1; r++)
+			for(int c = c0; c <= c1; c++)
+				s->indices[cursor[(siz)r * s->cols + c]++] = i;
+	}
+	free(cursor);
+	return s;
+}
+
+void spatial_free(SpatialIndex *s) {
+	free(s->bounds);
+	free(s->offsets);
+	free(s->indices);
+	free(s->large);
+	free(s);
+}
+
+static int compare_u32(const void *a, const void *b) {
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return (x > y) - (x < y);
+}
+
+// Writes the primitives intersecting the rectangle to out, up to max of
+// them, in the order they are found, and returns how many there are
+static siz spatial_collect(const SpatialIndex *s, int xmin, int ymin,
+                           int xmax, int ymax, u32 *out, siz max) {
+	siz found = 0;
+	if(s->count == 0)
+		return 0;
+	int qc0 = spatial_cell(xmin, s->x0, s->shift, s->cols);
+	int qr0 = spatial_cell(ymin, s->y0, s->shift, s->rows);
+	int qc1 = spatial_cell(xmax, s->x0, s->shift, s->cols);
+	int qr1 = spatial_cell(ymax, s->y0, s->shift, s->rows);
+	for(int r = qr0; r <= qr1; r++) {
+		for(int c = qc0; c <= qc1; c++) {
+			siz cell = (siz)r * s->cols + c;
+			for(siz k = s->offsets[cell]; k < s->offsets[cell + 1]; k++) {
+				u32        i = s->indices[k];
+				const int *b = &s->bounds[(siz)i * 4];
+				if(b[0] > xmax || b[2] < xmin || b[1] > ymax || b[3] < ymin)
+					continue;
+				// A primitive is binned into every cell it overlaps, so it is
+				// only taken from the one containing the bottom left corner
+				// of its intersection with the rectangle
+				int x = MAX(xmin, b[0]), y = MAX(ymin, b[1]);
+				if(spatial_cell(x, s->x0, s->shift, s->cols) != c ||
+				   spatial_cell(y, s->y0, s->shift, s->rows) != r)
+					continue;
+				if(found < max)
+					out[found] = i;
+				found++;
+			}
+		}
+	}
+	for(u32 k = 0; k < s->large_count; k++) {
+		const int *b = &s->bounds[(siz)s->large[k] * 4];
+		if(b[0] > xmax || b[2] < xmin || b[1] > ymax || b[3] < ymin)
+			continue;
+		if(found < max)
+			out[found] = s->large[k];
+		found++;
+	}
+	return found;
+}
+
+siz spatial_query(const SpatialIndex *s, int xmin, int ymin, int xmax,
+                  int ymax, u32 *out, siz max) {
+	siz found = spatial_collect(s, xmin, ymin, xmax, ymax, out, max);
+	if(found <= max) {
+		qsort(out, found, sizeof(u32), compare_u32);
+		return found;
+	}
+	// The first ones in input order are not known until all of them are
+	u32 *all = (u32 *)malloc(sizeof(u32) * found);
+	spatial_collect(s, xmin, ymin, xmax, ymax, all, found);
+	qsort(all, found, sizeof(u32), compare_u32);
+	for(siz k = 0; k < max; k++) out[k] = all[k];
+	free(all);
+	return found;
+}
+
+void spatial_draw(const SpatialIndex *s, Canvas *cv) {
+	// The rectangle of the canvas or the view in logical coordinates, see
+	// the driver for the coordinates of the cells
+	int rmin = 0, rmax = cv->rows - 1, cmin = 0, cmax = cv->cols - 1;
+	if(cv->clip_rows >= 0) {
+		rmin = cv->clip_row;
+		rmax = MIN(cv->clip_row + cv->clip_rows - 1, rmax);
+		cmin = cv->clip_col;
+		cmax = MIN(cv->clip_col + cv->clip_cols - 1, cmax);
+	}
+	if(rmin > rmax || cmax < 1 || cmin > cmax)
+		return;
+	int xmin = cmin / 2, xmax = (cmax - 1) / 2;
+	int ymin = cv->rows - rmax - 1, ymax = cv->rows - rmin - 1;
+
+	u32  batch[SPATIAL_DRAW_BATCH];
+	u32 *found = batch;
+	siz  count = spatial_query(s, xmin, ymin, xmax, ymax, batch,
+	                           SPATIAL_DRAW_BATCH);
+	if(count > SPATIAL_DRAW_BATCH) {
+		found = (u32 *)malloc(sizeof(u32) * count);
+		spatial_query(s, xmin, ymin, xmax, ymax, found, count);
+	}
+	for(siz k = 0; k < count; k++) {
+		canvas_set_id(cv, found[k]);
+		primitive_draw(cv, &s->prims[found[k]]);
+	}
+	if(found != batch)
+		free(found);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+#include "primitive.h"
+
+// A uniform grid over the bounds of a set of primitives, see
+// primitive_bounds, so that the primitives intersecting a rectangle are
+// found without looking at the rest of them. Every primitive is binned into
+// the cells of the grid its bounds overlap. The cells are squares of a
+// power of two pixels, sized for about one primitive per cell, and a
+// primitive overlapping more than SPATIAL_MAX_SPAN of them is kept in a
+// list of large primitives instead, which is looked at by every query.
+
+// Most cells a primitive is binned into
+#define SPATIAL_MAX_SPAN 64
+// Most cells of the grid
+#define SPATIAL_MAX_CELLS (1 << 22)
+
+typedef struct {
+	const Primitive *prims;
+	u32              count;
+	int *            bounds; // xmin, ymin, xmax, ymax of every primitive
+	int              x0, y0; // Logical coordinates of the corner of the grid
+	int              shift;  // log2 of the size of a cell
+	int              cols, rows;
+	siz *            offsets; // Start of the bin of each cell in 'indices'
+	u32 *            indices; // Primitives binned per cell, in input order
+	u32 *            large;   // The large primitives, in input order
+	u32              large_count;
+} SpatialIndex;
+
+// Index the primitives, which must outlive the index. There can be at most
+// u32_MAX of them.
+SpatialIndex *spatial_new(const Primitive *prims, siz count);
+void          spatial_free(SpatialIndex *s);
+// Get the primitives whose bounds intersect the rectangle, in logical
+// coordinates, including its edges. Their indices are written to out in
+// input order, up to max of them, and the number of primitives found is
+// returned, which may be more than max.
+siz spatial_query(const SpatialIndex *s, int xmin, int ymin, int xmax,
+                  int ymax, u32 *out, siz max);
+// Draw the primitives intersecting the visible part of the canvas, or the
+// rectangle of a view, in input order. The framebuffer is the same as
+// drawing all of them, while the pixels of the rest of the primitives,
+// which would all fall outside, are neither plotted nor counted.
+void spatial_draw(const SpatialIndex *s, Canvas *cv);
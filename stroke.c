@@ -0,0 +1,359 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "raster.h"
+#include "stroke.h"
+
+// Slack of the intersections, so that the pixels on an edge shared by two
+// pieces are covered by both of them
+#define STROKE_EPSILON 1e-9
+
+typedef struct {
+	double x, y;
+} Vec;
+
+typedef struct {
+	Span *spans;
+	siz   count, capacity;
+	int   failed; // A span could not be stored
+} SpanList;
+
+// The spans of the rows of a stroke. Every row keeps a single run, which
+// absorbs all the spans overlapping or touching it, and only the spans
+// apart from it, where the stroke crosses the row more than once, are kept
+// aside to be merged at the end.
+typedef struct {
+	int *     lo, *hi; // The run of every row, empty if lo > hi
+	int       y0, rows;
+	SpanList *apart;
+} Rows;
+
+// An edge of a polygon, walked a row at a time
+typedef struct {
+	double x, slope, xmin, xmax;
+	int    from, to; // Rows it covers
+	int    flat;     // Horizontal, covering xmin to xmax
+} Edge;
+
+// The buffers of the strokes of every thread, which are kept from one
+// stroke to the next rather than allocated every time
+static __thread int *    scratch_runs            = NULL;
+static __thread siz      scratch_runs_capacity   = 0;
+static __thread Vec *    scratch_points          = NULL;
+static __thread siz      scratch_points_capacity = 0;
+static __thread SpanList scratch_spans           = {NULL, 0, 0, 0};
+static __thread Span *   scratch_sorted          = NULL;
+static __thread siz      scratch_sorted_capacity = 0;
+static __thread siz *    scratch_ends            = NULL;
+static __thread siz      scratch_ends_capacity   = 0;
+
+// Grows the buffer to hold at least count items of the size. Returns 0 if
+// it could not be, leaving it as it was.
+static int grow(void **buffer, siz *capacity, siz count, siz size) {
+	if(count <= *capacity)
+		return 1;
+	siz   grown = *capacity ? *capacity : 64;
+	while(grown < count) grown *= 2;
+	void *b = realloc(*buffer, grown * size);
+	if(b == NULL)
+		return 0;
+	*buffer   = b;
+	*capacity = grown;
+	return 1;
+}
+
+static void span_push(SpanList *l, int y, int x0, int x1) {
+	if(!grow((void **)&l->spans, &l->capacity, l->count + 1, sizeof(Span))) {
+		l->failed = 1;
+		return;
+	}
+	l->spans[l->count++] = (Span){y, x0, x1};
+}
+
+// Rounds towards the pixels inside of an edge, saturating to the range of
+// int, as a wide stroke may reach past it. The conversion truncates towards
+// zero, which is corrected rather than calling ceil and floor.
+static inline int edge_ceil(double v) {
+	v -= STROKE_EPSILON;
+	if(v <= i32_MIN || v >= i32_MAX)
+		return v <= i32_MIN ? i32_MIN : i32_MAX;
+	int i = (int)v;
+	return i + (i < v);
+}
+
+static inline int edge_floor(double v) {
+	v += STROKE_EPSILON;
+	if(v <= i32_MIN || v >= i32_MAX)
+		return v <= i32_MIN ? i32_MIN : i32_MAX;
+	int i = (int)v;
+	return i - (i > v);
+}
+
+static inline int saturate(i64 v) {
+	return v < i32_MIN ? i32_MIN : v > i32_MAX ? i32_MAX : (int)v;
+}
+
+static inline void span_add(Rows *r, int y, int x0, int x1) {
+	if(x0 > x1 || y < r->y0 || y >= r->y0 + r->rows)
+		return;
+	int *lo = &r->lo[y - r->y0], *hi = &r->hi[y - r->y0];
+	if(*lo > *hi) {
+		*lo = x0;
+		*hi = x1;
+	} else if(x0 <= (i64)*hi + 1 && x1 >= (i64)*lo - 1) {
+		*lo = x0 < *lo ? x0 : *lo;
+		*hi = x1 > *hi ? x1 : *hi;
+	} else
+		span_push(r->apart, y, x0, x1);
+}
+
+// Scans a convex polygon, row by row, between its leftmost and rightmost
+// intersection with the row. All the edges are walked down the rows
+// together, with an addition per edge and per row.
+static void scan_polygon(Rows *r, const Vec *v, int n) {
+	double ymin = v[0].y, ymax = v[0].y;
+	for(int i = 1; i < n; i++) {
+		ymin = v[i].y < ymin ? v[i].y : ymin;
+		ymax = v[i].y > ymax ? v[i].y : ymax;
+	}
+	int y0 = edge_ceil(ymin), y1 = edge_floor(ymax);
+	y0     = y0 < r->y0 ? r->y0 : y0;
+	y1     = y1 >= r->y0 + r->rows ? r->y0 + r->rows - 1 : y1;
+	if(y0 > y1)
+		return;
+	Edge edges[4];
+	for(int i = 0; i < n; i++) {
+		Vec   a = v[i], b = v[(i + 1) % n];
+		Edge *e = &edges[i];
+		e->xmin = a.x < b.x ? a.x : b.x;
+		e->xmax = a.x < b.x ? b.x : a.x;
+		e->from = edge_ceil(a.y < b.y ? a.y : b.y);
+		e->to   = edge_floor(a.y < b.y ? b.y : a.y);
+		e->from = e->from < y0 ? y0 : e->from;
+		e->to   = e->to > y1 ? y1 : e->to;
+		e->flat  = fabs(b.y - a.y) < STROKE_EPSILON;
+		e->slope = e->flat ? 0 : (b.x - a.x) / (b.y - a.y);
+		e->x     = a.x + (e->from - a.y) * e->slope;
+	}
+	for(int y = y0; y <= y1; y++) {
+		double left = INFINITY, right = -INFINITY;
+		for(int i = 0; i < n; i++) {
+			Edge *e = &edges[i];
+			if(y < e->from || y > e->to)
+				continue;
+			if(e->flat) {
+				left  = e->xmin < left ? e->xmin : left;
+				right = e->xmax > right ? e->xmax : right;
+				continue;
+			}
+			// The rows within the slack may be just past the edge
+			double c = e->x < e->xmin ? e->xmin
+			                          : e->x > e->xmax ? e->xmax : e->x;
+			left     = c < left ? c : left;
+			right    = c > right ? c : right;
+			e->x += e->slope;
+		}
+		if(left <= right)
+			span_add(r, y, edge_ceil(left), edge_floor(right));
+	}
+}
+
+// Scans the disc of the width around the pixel at x, y. The half width of
+// every row is the largest k with (2k)^2 + (2dy)^2 <= width^2, which only
+// moves by a little from one row to the next, so it is walked in integers
+// from the first row rather than taking a square root per row.
+static void scan_disc(Rows *r, int x, int y, int width) {
+	i64 w2 = (i64)width * width;
+	i64 y0 = (i64)y - width / 2, y1 = (i64)y + width / 2;
+	y0     = y0 < r->y0 ? r->y0 : y0;
+	y1     = y1 >= r->y0 + r->rows ? r->y0 + r->rows - 1 : y1;
+	if(y0 > y1)
+		return;
+	i64 k = (i64)(sqrt((double)(w2 - 4 * (y0 - y) * (y0 - y))) / 2);
+	for(i64 row = y0; row <= y1; row++) {
+		i64 d = w2 - 4 * (row - y) * (row - y);
+		while(4 * (k + 1) * (k + 1) <= d) k++;
+		while(k > 0 && 4 * k * k > d) k--;
+		span_add(r, (int)row, saturate(x - k), saturate(x + k));
+	}
+}
+
+// Scans the join at p of the segments along the unit vectors d0 and d1.
+// Only the outer side of the turn needs to be filled, the inner one is
+// covered by the segments themselves.
+static void scan_join(Rows *r, Vec p, Vec d0, Vec d1, int width,
+                      StrokeJoin join) {
+	double h = width / 2.0;
+	if(join == STROKE_JOIN_ROUND) {
+		scan_disc(r, (int)p.x, (int)p.y, width);
+		return;
+	}
+	double cross = d0.x * d1.y - d0.y * d1.x, dot = d0.x * d1.x + d0.y * d1.y;
+	// Straight on, or turning back, where the bevel is empty
+	if(fabs(cross) < STROKE_EPSILON)
+		return;
+	double s  = cross > 0 ? -h : h;
+	Vec    o0 = {-d0.y * s, d0.x * s}, o1 = {-d1.y * s, d1.x * s};
+	Vec    a = {p.x + o0.x, p.y + o0.y}, b = {p.x + o1.x, p.y + o1.y};
+	// The outer edges meet on the bisector of the normals, at h divided by
+	// the cosine of half of the angle between them
+	double c = sqrt((1 + dot) / 2);
+	if(join == STROKE_JOIN_MITER && c * STROKE_MITER_LIMIT > 1) {
+		Vec    m = {o0.x + o1.x, o0.y + o1.y};
+		double k = h / c / hypot(m.x, m.y);
+		Vec    q[4] = {p, a, {p.x + m.x * k, p.y + m.y * k}, b};
+		scan_polygon(r, q, 4);
+		return;
+	}
+	Vec q[3] = {p, a, b};
+	scan_polygon(r, q, 3);
+}
+
+// Collects the runs of the rows in order. If any span was kept apart, they
+// are placed by row along with the runs, with a counting sort, and the ones
+// of a row which overlap or touch are merged.
+static siz rows_collect(Rows *r, const Span **spans) {
+	SpanList *l = r->apart;
+	if(l->failed)
+		return 0;
+	if(l->count == 0) {
+		if(!grow((void **)&l->spans, &l->capacity, r->rows, sizeof(Span)))
+			return 0;
+		for(int i = 0; i < r->rows; i++) {
+			if(r->lo[i] <= r->hi[i])
+				l->spans[l->count++] = (Span){r->y0 + i, r->lo[i], r->hi[i]};
+		}
+		*spans = l->spans;
+		return l->count;
+	}
+	if(!grow((void **)&scratch_sorted, &scratch_sorted_capacity,
+	         l->count + r->rows, sizeof(Span)) ||
+	   !grow((void **)&scratch_ends, &scratch_ends_capacity, r->rows + 1,
+	         sizeof(siz)))
+		return 0;
+	// The spans of every row are counted, then placed after the ones of the
+	// previous rows, leaving ends[i] past the last span of the row i
+	siz * ends = scratch_ends;
+	Span *out  = scratch_sorted;
+	for(int i = 0; i <= r->rows; i++) ends[i] = 0;
+	for(siz k = 0; k < l->count; k++) ends[l->spans[k].y - r->y0 + 1]++;
+	for(int i = 0; i < r->rows; i++)
+		ends[i + 1] += ends[i] + (r->lo[i] <= r->hi[i]);
+	for(int i = 0; i < r->rows; i++) {
+		if(r->lo[i] <= r->hi[i])
+			out[ends[i]++] = (Span){r->y0 + i, r->lo[i], r->hi[i]};
+	}
+	for(siz k = 0; k < l->count; k++)
+		out[ends[l->spans[k].y - r->y0]++] = l->spans[k];
+	siz n = 0, begin = 0;
+	for(int i = 0; i < r->rows; i++) {
+		// A row has few spans, which are sorted by insertion
+		for(siz k = begin + 1; k < ends[i]; k++) {
+			Span s = out[k];
+			siz  j = k;
+			for(; j > begin && out[j - 1].x0 > s.x0; j--) out[j] = out[j - 1];
+			out[j] = s;
+		}
+		for(siz k = begin; k < ends[i]; k++) {
+			if(k > begin && out[k].x0 <= (i64)out[n - 1].x1 + 1) {
+				if(out[k].x1 > out[n - 1].x1)
+					out[n - 1].x1 = out[k].x1;
+			} else
+				out[n++] = out[k];
+		}
+		begin = ends[i];
+	}
+	*spans = out;
+	return n;
+}
+
+// No piece reaches further than a miter from the points
+static i64 stroke_reach(int width) {
+	return (i64)ceil(width / 2.0 * STROKE_MITER_LIMIT) + 1;
+}
+
+int stroke_rows(const int *points, int count, int width, int *ymin,
+                int *ymax) {
+	if(width < 1 || count < 1)
+		return 0;
+	i64 lo = points[1], hi = points[1];
+	for(int i = 1; i < count; i++) {
+		lo = points[2 * i + 1] < lo ? points[2 * i + 1] : lo;
+		hi = points[2 * i + 1] > hi ? points[2 * i + 1] : hi;
+	}
+	lo    = lo - stroke_reach(width);
+	hi    = hi + stroke_reach(width);
+	*ymin = lo < i32_MIN ? i32_MIN : (int)lo;
+	*ymax = hi > i32_MAX ? i32_MAX : (int)hi;
+	return 1;
+}
+
+siz stroke_spans(const int *points, int count, int width, StrokeJoin join,
+                 StrokeCap cap, int ymin, int ymax, const Span **spans) {
+	int from, to;
+	*spans = NULL;
+	if(!stroke_rows(points, count, width, &from, &to))
+		return 0;
+	from = from > ymin ? from : ymin;
+	to   = to < ymax ? to : ymax;
+	if(from > to || (i64)to - from >= i32_MAX)
+		return 0;
+	Rows r;
+	r.y0    = from;
+	r.rows  = to - from + 1;
+	r.apart = &scratch_spans;
+	if(!grow((void **)&scratch_runs, &scratch_runs_capacity,
+	         2 * (siz)r.rows, sizeof(int)) ||
+	   !grow((void **)&scratch_points, &scratch_points_capacity, count,
+	         sizeof(Vec)))
+		return 0;
+	r.lo            = scratch_runs;
+	r.hi            = r.lo + r.rows;
+	r.apart->count  = 0;
+	r.apart->failed = 0;
+	for(int i = 0; i < r.rows; i++) {
+		r.lo[i] = 1;
+		r.hi[i] = 0;
+	}
+	// The repeated points are dropped, as they have no direction
+	Vec *p = scratch_points;
+	int  n = 0;
+	for(int i = 0; i < count; i++) {
+		Vec v = {points[2 * i], points[2 * i + 1]};
+		if(n == 0 || v.x != p[n - 1].x || v.y != p[n - 1].y)
+			p[n++] = v;
+	}
+
+	double h    = width / 2.0;
+	Vec    prev = {0, 0};
+	for(int i = 0; i + 1 < n; i++) {
+		double dx = p[i + 1].x - p[i].x, dy = p[i + 1].y - p[i].y;
+		double len = hypot(dx, dy);
+		Vec    d = {dx / len, dy / len}, o = {-d.y * h, d.x * h};
+		Vec    q[4] = {{p[i].x + o.x, p[i].y + o.y},
+		               {p[i + 1].x + o.x, p[i + 1].y + o.y},
+		               {p[i + 1].x - o.x, p[i + 1].y - o.y},
+		               {p[i].x - o.x, p[i].y - o.y}};
+		scan_polygon(&r, q, 4);
+		if(i > 0)
+			scan_join(&r, p[i], prev, d, width, join);
+		prev = d;
+	}
+	if(cap == STROKE_CAP_ROUND) {
+		scan_disc(&r, (int)p[0].x, (int)p[0].y, width);
+		if(n > 1)
+			scan_disc(&r, (int)p[n - 1].x, (int)p[n - 1].y, width);
+	}
+	return rows_collect(&r, spans);
+}
+
+void draw_line_thick(Canvas *cv, int x1, int y1, int x2, int y2, int width,
+                     StrokeCap cap) {
+	int points[4] = {x1, y1, x2, y2};
+	raster_canvas(cv, stroke, points, 2, width, STROKE_JOIN_MITER, cap);
+}
+
+void draw_polyline(Canvas *cv, const int *points, int count, int width,
+                   StrokeJoin join, StrokeCap cap) {
+	raster_canvas(cv, stroke, points, count, width, join, cap);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common.h"
+#include "driver.h"
+
+// Lines and polylines of any width. The outline of the stroke is built from
+// convex pieces, a quadrilateral per segment and a polygon or a disc per
+// join and cap, which are scanned into horizontal spans of pixels. The spans
+// of all the pieces are merged, so every pixel is plotted once, and the cost
+// follows the area covered rather than the width times the length. A pixel
+// is covered if its centre is inside of the outline.
+
+typedef enum {
+	STROKE_JOIN_MITER = 1, // Bevelled beyond STROKE_MITER_LIMIT
+	STROKE_JOIN_ROUND = 2,
+	STROKE_JOIN_BEVEL = 3
+} StrokeJoin;
+
+typedef enum {
+	STROKE_CAP_BUTT  = 1, // Ends exactly at the endpoints
+	STROKE_CAP_ROUND = 2  // Half a disc of the width around the endpoints
+} StrokeCap;
+
+// Longest miter, as a multiple of half the width
+#define STROKE_MITER_LIMIT 4.0
+
+// A run of pixels of a row, from x0 to x1 inclusive
+typedef struct {
+	int y, x0, x1;
+} Span;
+
+// Rows scanned at once by the rasterizers, see raster_stroke
+#define STROKE_BAND_ROWS 1024
+
+// Get the rows the stroke of the polyline through the points may cover,
+// from *ymin to *ymax. Returns 0 if it covers none.
+int stroke_rows(const int *points, int count, int width, int *ymin,
+                int *ymax);
+// Get the spans of the rows from ymin to ymax of the stroke of the polyline
+// through the points, given as x, y pairs. The spans are sorted by y and
+// then by x, and do not overlap. The rows are scanned into tables sized to
+// the range, so a long stroke is better scanned a band of rows at a time.
+// Returns the number of spans, which are stored in *spans, in a buffer of
+// the calling thread which is valid until its next call. There are none if
+// the buffers could not be allocated.
+siz stroke_spans(const int *points, int count, int width, StrokeJoin join,
+                 StrokeCap cap, int ymin, int ymax, const Span **spans);
+
+// Draw a line of the given width
+void draw_line_thick(Canvas *cv, int x1, int y1, int x2, int y2, int width,
+                     StrokeCap cap);
+// Draw the polyline through the points, given as x, y pairs
+void draw_polyline(Canvas *cv, const int *points, int count, int width,
+                   StrokeJoin join, StrokeCap cap);
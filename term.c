@@ -0,0 +1,430 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "term.h"
+
+// Every cell holds the utf-8 bytes of a single code point, the first one in
+// the lowest byte, and 0 for a blank cell
+typedef u32 Cell;
+
+struct Term {
+	int   fd;
+	int   rows, cols;
+	Cell *front, *back;
+	u64 * front_hash, *back_hash; // Of every row, to detect vertical shifts
+	char *out; // The escape stream of a flush
+	siz   out_size, out_capacity;
+	char *spare; // The other candidate stream of a flush
+	siz   spare_size, spare_capacity;
+	int   cursor_row, cursor_col; // -1 if unknown
+	u8    invalid;
+	u8    tty; // Whether the terminal was taken over by term_open
+	struct termios saved;
+};
+
+#define cell_at(t, buf, r, c) ((t)->buf[(siz)(r) * (t)->cols + (c)])
+
+// Longest escape sequence to move the cursor, "\x1b[<row>;<col>H"
+#define MOVE_MAX 16
+// Farthest the contents are looked for after a pan, in cells
+#define SHIFT_MAX 8
+
+Term *term_new(int fd, int rows, int cols) {
+	Term *t           = (Term *)calloc(1, sizeof(Term));
+	t->fd             = fd;
+	t->rows           = rows;
+	t->cols           = cols;
+	t->front          = (Cell *)calloc((siz)rows * cols, sizeof(Cell));
+	t->back           = (Cell *)calloc((siz)rows * cols, sizeof(Cell));
+	t->front_hash     = (u64 *)malloc(sizeof(u64) * rows);
+	t->back_hash      = (u64 *)malloc(sizeof(u64) * rows);
+	t->out_capacity   = 4096;
+	t->out            = (char *)malloc(t->out_capacity);
+	t->spare_capacity = 4096;
+	t->spare          = (char *)malloc(t->spare_capacity);
+	t->invalid        = 1;
+	return t;
+}
+
+void term_free(Term *t) {
+	free(t->front);
+	free(t->back);
+	free(t->front_hash);
+	free(t->back_hash);
+	free(t->out);
+	free(t->spare);
+	free(t);
+}
+
+static void write_all(int fd, const char *buf, siz size) {
+	while(size > 0) {
+		ssize_t written = write(fd, buf, size);
+		if(written < 0) {
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+		buf += written;
+		size -= written;
+	}
+}
+
+Term *term_open() {
+	struct winsize ws;
+	int            rows = 24, cols = 80;
+	if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+		rows = ws.ws_row;
+		cols = ws.ws_col;
+	}
+	Term *t = term_new(STDOUT_FILENO, rows, cols);
+	if(tcgetattr(STDIN_FILENO, &t->saved) == 0) {
+		struct termios raw = t->saved;
+		raw.c_lflag &= ~(ECHO | ICANON);
+		raw.c_cc[VMIN]  = 1;
+		raw.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+		t->tty = 1;
+	}
+	// Switch to the alternate screen, and hide the cursor
+	const char *enter = "\x1b[?1049h\x1b[?25l";
+	write_all(t->fd, enter, strlen(enter));
+	return t;
+}
+
+void term_close(Term *t) {
+	const char *leave = "\x1b[?25h\x1b[?1049l";
+	write_all(t->fd, leave, strlen(leave));
+	if(t->tty)
+		tcsetattr(STDIN_FILENO, TCSANOW, &t->saved);
+	term_free(t);
+}
+
+int term_rows(const Term *t) {
+	return t->rows;
+}
+
+int term_cols(const Term *t) {
+	return t->cols;
+}
+
+void term_put(Term *t, int row, int col, const char *s) {
+	if(row < 0 || row >= t->rows)
+		return;
+	const u8 *p = (const u8 *)s;
+	while(*p && col < t->cols) {
+		// The continuation bytes of a code point are 10xxxxxx
+		Cell cell = *p++;
+		for(int shift = 8; shift < 32 && (*p & 0xc0) == 0x80; shift += 8)
+			cell |= (Cell)*p++ << shift;
+		// A space is the same as a blank cell, which may be erased
+		if(cell == ' ')
+			cell = 0;
+		if(col >= 0)
+			cell_at(t, back, row, col) = cell;
+		col++;
+	}
+}
+
+void term_clear(Term *t) {
+	memset(t->back, 0, sizeof(Cell) * t->rows * t->cols);
+}
+
+void term_invalidate(Term *t) {
+	t->invalid = 1;
+}
+
+static void out_reserve(Term *t, siz size) {
+	if(t->out_size + size <= t->out_capacity)
+		return;
+	while(t->out_size + size > t->out_capacity) t->out_capacity *= 2;
+	t->out = (char *)realloc(t->out, t->out_capacity);
+}
+
+static void out_str(Term *t, const char *s, siz size) {
+	out_reserve(t, size);
+	memcpy(t->out + t->out_size, s, size);
+	t->out_size += size;
+}
+
+static void out_cell(Term *t, Cell cell) {
+	out_reserve(t, 4);
+	if(cell == 0) {
+		t->out[t->out_size++] = ' ';
+		return;
+	}
+	for(; cell; cell >>= 8) t->out[t->out_size++] = cell & 0xff;
+}
+
+static siz cell_size(Cell cell) {
+	siz size = 1;
+	while(cell >>= 8) size++;
+	return size;
+}
+
+// Writes the shortest way to move the cursor along a row into the buffer,
+// which is either an escape sequence or the unchanged cells in between
+static siz move_along(const Term *t, int row, int from, int to, char *buf) {
+	if(from == to)
+		return 0;
+	int dist = from < to ? to - from : from - to;
+	siz size = dist == 1 ? (siz)sprintf(buf, "\x1b[%c", from < to ? 'C' : 'D')
+	                     : (siz)sprintf(buf, "\x1b[%d%c", dist,
+	                                    from < to ? 'C' : 'D');
+	if(from > to)
+		return size;
+	siz gap = 0;
+	for(int c = from; c < to && gap <= size; c++)
+		gap += cell_size(cell_at(t, back, row, c));
+	if(gap >= size)
+		return size;
+	for(int c = from; c < to; c++) {
+		Cell cell = cell_at(t, back, row, c);
+		if(cell == 0)
+			*buf++ = ' ';
+		for(; cell; cell >>= 8) *buf++ = cell & 0xff;
+	}
+	return gap;
+}
+
+// Writes the escape sequence to move the cursor between the rows
+static siz move_across(int from, int to, char *buf) {
+	if(from == to)
+		return 0;
+	int dist = from < to ? to - from : from - to;
+	if(dist == 1)
+		return sprintf(buf, "\x1b[%c", from < to ? 'B' : 'A');
+	return sprintf(buf, "\x1b[%d%c", dist, from < to ? 'B' : 'A');
+}
+
+// Moves the cursor to the cell using the shortest of an absolute move, a
+// relative one, and a relative one from the start of the line. The cells
+// before the target on its row are always unchanged, as they are flushed
+// in order, so they may be rewritten to move over them.
+static void move_to(Term *t, int row, int col) {
+	if(t->cursor_row == row && t->cursor_col == col)
+		return;
+	char best[MOVE_MAX * 2], next[MOVE_MAX * 2];
+	siz  best_size = sprintf(best, "\x1b[%d;%dH", row + 1, col + 1);
+	if(t->cursor_row >= 0) {
+		siz size = move_across(t->cursor_row, row, next);
+		size += move_along(t, row, t->cursor_col, col, next + size);
+		if(size < best_size) {
+			memcpy(best, next, size);
+			best_size = size;
+		}
+		next[0] = '\r';
+		size    = 1 + move_across(t->cursor_row, row, next + 1);
+		size += move_along(t, row, 0, col, next + size);
+		if(size < best_size) {
+			memcpy(best, next, size);
+			best_size = size;
+		}
+	}
+	out_str(t, best, best_size);
+	t->cursor_row = row;
+	t->cursor_col = col;
+}
+
+static u64 hash_row(const Cell *row, int cols) {
+	u64 h = 0xcbf29ce484222325ull;
+	for(int c = 0; c < cols; c++) h = (h ^ row[c]) * 0x100000001b3ull;
+	return h;
+}
+
+// If the contents moved up or down as a whole, moves the rows on the
+// terminal by inserting or deleting lines at the top, which leaves only the
+// uncovered rows to be sent
+static void shift_rows(Term *t) {
+	int rows = t->rows, same = 0;
+	for(int r = 0; r < rows; r++) {
+		t->front_hash[r] = hash_row(&cell_at(t, front, r, 0), t->cols);
+		t->back_hash[r]  = hash_row(&cell_at(t, back, r, 0), t->cols);
+		same += t->front_hash[r] == t->back_hash[r];
+	}
+	int best = same, shift = 0;
+	for(int k = 1; k <= SHIFT_MAX && k < rows; k++) {
+		int down = 0, up = 0;
+		for(int r = k; r < rows; r++) {
+			down += t->back_hash[r] == t->front_hash[r - k];
+			up += t->back_hash[r - k] == t->front_hash[r];
+		}
+		if(down > best) {
+			best  = down;
+			shift = k;
+		}
+		if(up > best) {
+			best  = up;
+			shift = -k;
+		}
+	}
+	// A row or two may match by chance
+	if(best - same < 3)
+		return;
+	int  k = shift > 0 ? shift : -shift;
+	char seq[MOVE_MAX * 2];
+	siz  size = sprintf(seq, "\x1b[H\x1b[%d%c", k, shift > 0 ? 'L' : 'M');
+	out_str(t, seq, size);
+	siz row = t->cols, moved = (siz)(rows - k) * row;
+	if(shift > 0) {
+		memmove(&t->front[k * row], t->front, sizeof(Cell) * moved);
+		memset(t->front, 0, sizeof(Cell) * k * row);
+	} else {
+		memmove(t->front, &t->front[k * row], sizeof(Cell) * moved);
+		memset(&t->front[moved], 0, sizeof(Cell) * k * row);
+	}
+	t->cursor_row = t->cursor_col = 0;
+}
+
+// Cells of the row which would differ after its contents are moved right
+// by k cells, or left for a negative k, giving up after limit
+static int shift_cost(const Cell *front, const Cell *back, int cols, int k,
+                      int limit) {
+	int cost = 0;
+	for(int c = 0; c < cols && cost < limit; c++) {
+		int from = c - k;
+		cost += back[c] != (from >= 0 && from < cols ? front[from] : 0);
+	}
+	return cost;
+}
+
+// If the contents of the row moved left or right, moves them on the
+// terminal by inserting or deleting characters at its start
+static void shift_cols(Term *t, int r) {
+	Cell *front = &cell_at(t, front, r, 0), *back = &cell_at(t, back, r, 0);
+	int   cols = t->cols, same = shift_cost(front, back, cols, 0, cols + 1);
+	int   best = same, shift = 0;
+	for(int k = 1; k <= SHIFT_MAX && k < cols; k++) {
+		for(int dir = 1; dir >= -1; dir -= 2) {
+			int cost = shift_cost(front, back, cols, k * dir, best);
+			if(cost < best) {
+				best  = cost;
+				shift = k * dir;
+			}
+		}
+	}
+	// The escape sequences cost more than a couple of cells
+	if(same - best < 3)
+		return;
+	int  k = shift > 0 ? shift : -shift;
+	char seq[MOVE_MAX];
+	move_to(t, r, 0);
+	out_str(t, seq, sprintf(seq, "\x1b[%d%c", k, shift > 0 ? '@' : 'P'));
+	if(shift > 0) {
+		memmove(&front[k], front, sizeof(Cell) * (cols - k));
+		memset(front, 0, sizeof(Cell) * k);
+	} else {
+		memmove(front, &front[k], sizeof(Cell) * (cols - k));
+		memset(&front[cols - k], 0, sizeof(Cell) * k);
+	}
+}
+
+// Appends the changes from the front buffer to the back buffer to the
+// stream, after which both are the same
+static void emit_changes(Term *t, u8 shifts) {
+	if(shifts)
+		shift_rows(t);
+	for(int r = 0; r < t->rows; r++) {
+		Cell *front = &cell_at(t, front, r, 0), *back = &cell_at(t, back, r, 0);
+		if(memcmp(front, back, sizeof(Cell) * t->cols) == 0)
+			continue;
+		if(shifts)
+			shift_cols(t, r);
+		// Everything after the last lit cell of the row can be erased at once
+		int end = t->cols;
+		while(end > 0 && back[end - 1] == 0) end--;
+		for(int c = 0; c < t->cols; c++) {
+			if(front[c] == back[c])
+				continue;
+			if(c >= end) {
+				// Erase to the end of the line, which keeps the cursor. The
+				// cells from the cursor on are blank if it is past the end.
+				if(t->cursor_row != r || t->cursor_col < end ||
+				   t->cursor_col > c)
+					move_to(t, r, c);
+				out_str(t, "\x1b[K", 3);
+				memset(&front[c], 0, sizeof(Cell) * (t->cols - c));
+				break;
+			}
+			move_to(t, r, c);
+			out_cell(t, back[c]);
+			front[c] = back[c];
+			// The cursor is left in a pending wrap state at the last column
+			if(++t->cursor_col == t->cols)
+				t->cursor_row = -1;
+		}
+	}
+}
+
+static void swap_streams(Term *t) {
+	char *out         = t->out;
+	siz   size        = t->out_size, capacity = t->out_capacity;
+	t->out            = t->spare;
+	t->out_size       = t->spare_size;
+	t->out_capacity   = t->spare_capacity;
+	t->spare          = out;
+	t->spare_size     = size;
+	t->spare_capacity = capacity;
+}
+
+siz term_flush(Term *t) {
+	t->out_size  = 0;
+	int diff_row = 0, diff_col = 0;
+	u8  diffed   = !t->invalid;
+	if(diffed) {
+		emit_changes(t, 1);
+		if(t->out_size == 0)
+			return 0;
+		// When most of the cells moved, as on a zoom, erasing the display
+		// and drawing them again is shorter, so both are tried
+		swap_streams(t);
+		t->out_size = 0;
+		diff_row    = t->cursor_row;
+		diff_col    = t->cursor_col;
+	}
+	// Home the cursor and erase the display
+	out_str(t, "\x1b[H\x1b[2J", 7);
+	memset(t->front, 0, sizeof(Cell) * t->rows * t->cols);
+	t->cursor_row = t->cursor_col = 0;
+	t->invalid                    = 0;
+	emit_changes(t, 0);
+	if(diffed && t->spare_size <= t->out_size) {
+		swap_streams(t);
+		t->cursor_row = diff_row;
+		t->cursor_col = diff_col;
+	}
+	write_all(t->fd, t->out, t->out_size);
+	return t->out_size;
+}
+
+int term_read_key() {
+	u8      c;
+	ssize_t n;
+	while((n = read(STDIN_FILENO, &c, 1)) != 1) {
+		if(n == 0 || errno != EINTR)
+			return -1;
+	}
+	if(c != 0x1b)
+		return c;
+	// An arrow key arrives as ESC [ <A-D> all at once, anything else is
+	// returned as it is
+	struct pollfd p = {STDIN_FILENO, POLLIN, 0};
+	u8            seq[2];
+	if(poll(&p, 1, 50) != 1 || read(STDIN_FILENO, &seq[0], 1) != 1 ||
+	   seq[0] != '[')
+		return c;
+	if(poll(&p, 1, 50) != 1 || read(STDIN_FILENO, &seq[1], 1) != 1)
+		return c;
+	switch(seq[1]) {
+		case 'A': return TERM_KEY_UP;
+		case 'B': return TERM_KEY_DOWN;
+		case 'C': return TERM_KEY_RIGHT;
+		case 'D': return TERM_KEY_LEFT;
+	}
+	return c;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.h"
+
+// A terminal backend which talks ANSI escape sequences directly, without
+// ncurses. Everything is drawn on a back buffer of cells. A flush compares
+// it with the front buffer, i.e. what the terminal is known to show, and
+// sends only the cells which changed, as a single coalesced stream of
+// escape sequences written with one write() call.
+
+typedef struct Term Term;
+
+// Keys returned by term_read_key besides the plain characters
+#define TERM_KEY_UP 0x101
+#define TERM_KEY_DOWN 0x102
+#define TERM_KEY_RIGHT 0x103
+#define TERM_KEY_LEFT 0x104
+
+// Create a terminal of the given size which writes to the file descriptor.
+// The terminal itself is left alone, which is useful to measure the output.
+Term *term_new(int fd, int rows, int cols);
+// Release the buffers of the terminal
+void term_free(Term *t);
+// Take over the controlling terminal on the standard output, using all of
+// it. The input is switched to unbuffered mode without echo.
+Term *term_open();
+// Restore the controlling terminal and release it
+void term_close(Term *t);
+int  term_rows(const Term *t);
+int  term_cols(const Term *t);
+// Draw the utf-8 string on the back buffer starting at the cell, one code
+// point per cell. Whatever does not fit in the row is dropped.
+void term_put(Term *t, int row, int col, const char *s);
+// Blank the whole back buffer
+void term_clear(Term *t);
+// Forget what the terminal shows, so that the next flush repaints it all
+void term_invalidate(Term *t);
+// Send the changes of the back buffer to the terminal. Returns the number of
+// bytes written.
+siz term_flush(Term *t);
+// Read a key from the standard input, blocking until there is one. Returns
+// -1 if the input is closed.
+int term_read_key();
@@ -0,0 +1,114 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "threadpool.h"
+
+typedef struct {
+	ThreadPool *pool;
+	int         id;
+} Worker;
+
+struct ThreadPool {
+	pthread_t *     threads;
+	Worker *        workers;
+	int             size;
+	pthread_mutex_t lock;
+	pthread_cond_t  start, done;
+	u64             generation; // Incremented for every job
+	int             pending;    // Workers yet to finish the current job
+	u8              stop;
+	// The current job
+	void (*fn)(int index, int worker, void *arg);
+	void *arg;
+	int   count;
+	int   next; // Next index to be claimed, atomically incremented
+};
+
+static void run_job(ThreadPool *pool, int id) {
+	int i;
+	while((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+	      pool->count)
+		pool->fn(i, id, pool->arg);
+}
+
+static void *worker_main(void *arg) {
+	Worker *    w    = (Worker *)arg;
+	ThreadPool *pool = w->pool;
+	u64         seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	while(1) {
+		while(pool->generation == seen && !pool->stop)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if(pool->stop)
+			break;
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+		run_job(pool, w->id);
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+ThreadPool *pool_new(int threads) {
+	if(threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(threads <= 0)
+		threads = 1;
+	ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+	pool->size       = threads;
+	pool->threads    = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+	pool->workers    = (Worker *)malloc(sizeof(Worker) * threads);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	// The caller is the worker 0
+	for(int i = 1; i < threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].id   = i;
+		pthread_create(&pool->threads[i], NULL, worker_main,
+		               &pool->workers[i]);
+	}
+	return pool;
+}
+
+int pool_size(ThreadPool *pool) {
+	return pool->size;
+}
+
+void pool_run(ThreadPool *pool, int count,
+              void (*fn)(int index, int worker, void *arg), void *arg) {
+	pthread_mutex_lock(&pool->lock);
+	pool->fn      = fn;
+	pool->arg     = arg;
+	pool->count   = count;
+	pool->next    = 0;
+	pool->pending = pool->size - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	run_job(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending > 0) pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_free(ThreadPool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for(int i = 1; i < pool->size; i++) pthread_join(pool->threads[i], NULL);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->threads);
+	free(pool->workers);
+	free(pool);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// A fixed set of worker threads which execute indexed jobs in parallel.
+// The calling thread of pool_run participates as the worker 0.
+
+typedef struct ThreadPool ThreadPool;
+
+// Create a pool of the given number of threads, including the caller.
+// If threads <= 0, the number of online processors is used.
+ThreadPool *pool_new(int threads);
+// Number of threads in the pool, including the caller
+int pool_size(ThreadPool *pool);
+// Call fn(index, worker, arg) for every index in [0, count) distributed over
+// the threads of the pool, and return once all of them are done. 'worker'
+// is in [0, pool_size) and unique among the concurrently running calls.
+void pool_run(ThreadPool *pool, int count,
+              void (*fn)(int index, int worker, void *arg), void *arg);
+// Stop and release the threads of the pool
+void pool_free(ThreadPool *pool);
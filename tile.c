@@ -0,0 +1,80 @@
+#include <stdlib.h>
+
+#include "driver.h"
+#include "tile.h"
+
+typedef struct {
+	Canvas *         canvas;
+	const Primitive *prims;
+	int *            offsets; // Start of the bin of each tile in 'indices'
+	int *            indices; // Primitives binned per tile, in input order
+	int              tile_rows, cols;
+} TileJob;
+
+// Computes the range of tiles overlapped by the bounds of the primitive.
+// Returns 0 if it is completely outside of the screen.
+static int tile_range(const Primitive *p, int rows, int cols, int tile_rows,
+                      int tiles, int *t0, int *t1) {
+	int xmin, ymin, xmax, ymax;
+	primitive_bounds(p, &xmin, &ymin, &xmax, &ymax);
+	// Logical coordinates to terminal cells, see the driver
+	int cmin = (xmin * 2) + 1, cmax = (xmax * 2) + 1;
+	int rmin = rows - ymax - 1, rmax = rows - ymin - 1;
+	if(cmax < 0 || rmax < 0 || cmin >= cols || rmin >= rows)
+		return 0;
+	*t0 = rmin < 0 ? 0 : rmin / tile_rows;
+	*t1 = rmax >= rows ? tiles - 1 : rmax / tile_rows;
+	return 1;
+}
+
+static void render_tile(int tile, int worker, void *arg) {
+	(void)worker;
+	TileJob *job = (TileJob *)arg;
+	Canvas view =
+	    canvas_view(job->canvas, tile * job->tile_rows, 0, job->tile_rows,
+	                job->cols);
+	for(int i = job->offsets[tile]; i < job->offsets[tile + 1]; i++) {
+		canvas_set_id(&view, job->indices[i]);
+		primitive_draw(&view, &job->prims[job->indices[i]]);
+	}
+	canvas_view_release(&view);
+}
+
+void render_tiled(Canvas *cv, const Primitive *prims, siz count,
+                  ThreadPool *pool) {
+	int rows = cv->rows, cols = cv->cols;
+	int tiles = pool_size(pool) == 1 ? 1 : pool_size(pool) * TILE_PER_THREAD;
+	if(tiles > rows / TILE_MIN_ROWS)
+		tiles = rows / TILE_MIN_ROWS;
+	if(tiles < 1)
+		tiles = 1;
+	int tile_rows = (rows + tiles - 1) / tiles;
+	tiles         = (rows + tile_rows - 1) / tile_rows;
+	int t0, t1;
+
+	// Bin the primitives with a counting sort, first counting the size of
+	// every bin, then filling them in
+	int *offsets = (int *)calloc(tiles + 1, sizeof(int));
+	for(siz i = 0; i < count; i++) {
+		if(!tile_range(&prims[i], rows, cols, tile_rows, tiles, &t0, &t1))
+			continue;
+		for(int t = t0; t <= t1; t++) offsets[t + 1]++;
+	}
+	for(int t = 0; t < tiles; t++) offsets[t + 1] += offsets[t];
+	int *indices = (int *)malloc(sizeof(int) * (offsets[tiles] + 1));
+	int *cursor  = (int *)malloc(sizeof(int) * tiles);
+	for(int t = 0; t < tiles; t++) cursor[t] = offsets[t];
+	for(siz i = 0; i < count; i++) {
+		if(!tile_range(&prims[i], rows, cols, tile_rows, tiles, &t0, &t1))
+			continue;
+		for(int t = t0; t <= t1; t++) indices[cursor[t]++] = (int)i;
+	}
+	free(cursor);
+
+	TileJob job = {cv, prims, offsets, indices, tile_rows, cols};
+	pool_run(pool, tiles, render_tile, &job);
+
+	free(offsets);
+	free(indices);
+	canvas_redraw(cv);
+}
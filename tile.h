@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+#include "primitive.h"
+#include "threadpool.h"
+
+// Minimum height of a tile in terminal cells
+#define TILE_MIN_ROWS 16
+// Tiles created per thread of the pool, so that the threads which finish
+// early can pick up the rest of the work
+#define TILE_PER_THREAD 2
+
+// Draw the primitives on the canvas using all the threads of the pool. The
+// canvas is split into tiles, every primitive is binned into the tiles its
+// bounds overlap, and the tiles are rasterized in parallel, each on a view
+// of itself. The framebuffer ends up identical to drawing the primitives one
+// after another, and the canvas is redrawn once at the end.
+// A primitive is rasterized once for every tile it overlaps, so the tiles
+// are bands spanning the whole width of the screen, and there are only as
+// many of them as needed to keep the threads busy.
+void render_tiled(Canvas *cv, const Primitive *prims, siz count,
+                  ThreadPool *pool);